@@ -0,0 +1,58 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tbd/arena.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+namespace tbd {
+namespace {
+constexpr size_t kMinBlock = 4 << 10;
+constexpr size_t kMaxBlock = 1 << 20;
+}  // namespace
+
+Arena::~Arena() {
+  for (Cleanup* c = cleanup_; c != nullptr; c = c->next) c->fn(c->obj);
+}
+
+void* Arena::AllocateSlow(size_t size, size_t align) {
+  // Grow the blocks with the arena, but never so much that a small document
+  // wastes more than it uses.
+  size_t next = std::min(std::max(kMinBlock, allocated_), kMaxBlock);
+  next = std::max(next, size + align);
+
+  blocks_.emplace_back(new char[next]);
+  block_ = blocks_.back().get();
+  size_ = next;
+  used_ = 0;
+  allocated_ += next;
+  return Allocate(size, align);
+}
+
+}  // namespace tbd
@@ -0,0 +1,95 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TBD_ARENA_H_
+#define TBD_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tbd {
+
+// A bump allocator. Objects allocated from it live until the arena is
+// destroyed, at which point their destructors are run (in reverse order of
+// construction) and the memory is released a block at a time.
+class Arena {
+ public:
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  ~Arena();
+
+  // Construct a T in the arena.
+  template <class T, class... A>
+  T* New(A&&... a) {
+    T* ret = new (Allocate(sizeof(T), alignof(T))) T(std::forward<A>(a)...);
+    if (!std::is_trivially_destructible<T>::value) {
+      cleanup_ = new (Allocate(sizeof(Cleanup), alignof(Cleanup)))
+          Cleanup{&Destroy<T>, ret, cleanup_};
+    }
+    return ret;
+  }
+
+  // Get uninitialized memory.
+  void* Allocate(size_t size, size_t align) {
+    size_t at = (used_ + align - 1) & ~(align - 1);
+    if (at + size > size_) return AllocateSlow(size, align);
+    used_ = at + size;
+    return block_ + at;
+  }
+
+  // The total size of the blocks allocated so far.
+  size_t SpaceAllocated() const { return allocated_; }
+
+ private:
+  struct Cleanup {
+    void (*fn)(void*);
+    void* obj;
+    Cleanup* next;
+  };
+
+  template <class T>
+  static void Destroy(void* t) {
+    static_cast<T*>(t)->~T();
+  }
+
+  void* AllocateSlow(size_t size, size_t align);
+
+  char* block_ = nullptr;
+  size_t used_ = 0, size_ = 0;
+  size_t allocated_ = 0;
+  Cleanup* cleanup_ = nullptr;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+};
+
+}  // namespace tbd
+
+#endif  // TBD_ARENA_H_
@@ -0,0 +1,81 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tbd/arena.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace tbd {
+namespace {
+
+struct Counted {
+  Counted(std::vector<int>* log, int i) : log(log), i(i) {}
+  ~Counted() { log->push_back(i); }
+
+  std::vector<int>* log;
+  int i;
+};
+
+TEST(Arena, Construct) {
+  Arena arena;
+  auto* i = arena.New<int>(5);
+  auto* s = arena.New<std::string>(100, 'x');
+  auto* d = arena.New<double>(2.5);
+
+  EXPECT_EQ(*i, 5);
+  EXPECT_EQ(*s, std::string(100, 'x'));
+  EXPECT_EQ(*d, 2.5);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(d) % alignof(double), 0);
+}
+
+TEST(Arena, Destroy) {
+  std::vector<int> log;
+  {
+    Arena arena;
+    for (int i = 0; i < 3; i++) arena.New<Counted>(&log, i);
+    EXPECT_TRUE(log.empty());
+  }
+  EXPECT_EQ(log, (std::vector<int>{2, 1, 0}));
+}
+
+TEST(Arena, Large) {
+  Arena arena;
+  std::vector<int64_t*> all;
+  for (int i = 0; i < 100000; i++) all.push_back(arena.New<int64_t>(i));
+  auto* big = static_cast<char*>(arena.Allocate(1 << 21, 8));
+  big[(1 << 21) - 1] = 1;
+
+  for (int i = 0; i < 100000; i++) ASSERT_EQ(*all[i], i);
+  EXPECT_GE(arena.SpaceAllocated(), 100000 * sizeof(int64_t) + (1 << 21));
+}
+
+}  // namespace
+}  // namespace tbd
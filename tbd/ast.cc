@@ -27,29 +27,69 @@
 
 #include "tbd/ast.h"
 
+#include <deque>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/log/check.h"
+#include "absl/strings/string_view.h"
 #include "tbd/dimensions.h"
 
 namespace tbd {
 
+namespace {
+struct FileTable {
+  FileTable() { names.emplace_back("??"); }
+
+  std::mutex mu;
+  std::deque<std::string> names;  // Doesn't move the strings as it grows.
+  std::map<absl::string_view, int> ids;
+};
+
+FileTable& Files() {
+  static FileTable* const table = new FileTable;
+  return *table;
+}
+}  // namespace
+
+int InternFileName(const std::string& name) {
+  // Locations are built one token at a time, nearly always for the same file.
+  thread_local const std::string* last_name = nullptr;
+  thread_local int last_id = 0;
+  if (last_name != nullptr && *last_name == name) return last_id;
+
+  auto& t = Files();
+  std::lock_guard<std::mutex> lock(t.mu);
+  auto it = t.ids.find(name);
+  if (it == t.ids.end()) {
+    t.names.emplace_back(name);
+    it = t.ids.emplace(t.names.back(), t.names.size() - 1).first;
+  }
+  last_name = &t.names[it->second];
+  last_id = it->second;
+  return it->second;
+}
+
+const std::string& FileName(int id) {
+  auto& t = Files();
+  std::lock_guard<std::mutex> lock(t.mu);
+  return t.names[id];
+}
+
 bool operator==(const Loc& l, const Loc& r) {
-  auto lt =
-      std::tie(l.filename, l.line_begin, l.line_end, l.col_begin, l.col_end);
-  auto rt =
-      std::tie(r.filename, r.line_begin, r.line_end, r.col_begin, r.col_end);
+  auto lt = std::tie(l.file, l.line_begin, l.line_end, l.col_begin, l.col_end);
+  auto rt = std::tie(r.file, r.line_begin, r.line_end, r.col_begin, r.col_end);
   return lt == rt;
 }
 
 bool operator<(const Loc& l, const Loc& r) {
-  auto lt =
-      std::tie(l.filename, l.line_begin, l.line_end, l.col_begin, l.col_end);
-  auto rt =
-      std::tie(r.filename, r.line_begin, r.line_end, r.col_begin, r.col_end);
+  auto lt = std::tie(l.file, l.line_begin, l.line_end, l.col_begin, l.col_end);
+  auto rt = std::tie(r.file, r.line_begin, r.line_end, r.col_begin, r.col_end);
   return lt < rt;
 }
 
@@ -57,7 +97,7 @@ Loc Join(std::vector<Loc> loc) {
   CHECK(!loc.empty());
   Loc ret = *loc.begin();
   for (const auto& l : loc) {
-    CHECK(ret.filename == l.filename) << ret.filename << "!=" << l.filename;
+    CHECK(ret.file == l.file) << ret.filename() << "!=" << l.filename();
 
     if (l.line_begin < ret.line_begin) {
       ret.line_begin = l.line_begin;
@@ -79,7 +119,7 @@ Loc Join(std::vector<Loc> loc) {
 bool StableNodeCompare::operator()(NodeI const* l, NodeI const* r) const {
   auto& loc_l = l->location();
   auto& loc_r = r->location();
-  return loc_l == loc_r ? (l < r) : (loc_l < loc_r);
+  return loc_l == loc_r ? (l->id() < r->id()) : (loc_l < loc_r);
 }
 
 void UnitExp::Mul(std::unique_ptr<UnitExp::UnitT> o) {
@@ -91,98 +131,56 @@ void UnitExp::Div(std::unique_ptr<UnitExp::UnitT> o) {
   Mul(std::move(o));
 }
 
-UnitDef::UnitDef(Loc loc, std::unique_ptr<std::string> name,
-                 std::unique_ptr<LiteralValue> lit,
-                 std::unique_ptr<UnitExp> unit)
+UnitDef::UnitDef(Loc loc, std::string name, const LiteralValue* lit,
+                 const UnitExp* unit)
     : NodeI(Join(loc, lit->location(), unit->location())),
-      name_(std::move(*name)),
+      name_(std::move(name)),
       value_(lit->value()),
-      unit_(std::move(unit)) {}
-
-Equality::Equality(Loc loc, std::unique_ptr<ExpressionNode> l,
-                   std::unique_ptr<ExpressionNode> r)
-    : ExpressionNode(Join(loc, l->location(), r->location())),
-      l_(std::move(l)),
-      r_(std::move(r)) {}
+      unit_(unit) {}
 
-NamedValue::NamedValue(Loc loc, std::unique_ptr<std::string> s)
-    : ExpressionNode(loc), name_(std::move(*s)) {}
+Equality::Equality(Loc loc, ExpressionNode* l, ExpressionNode* r)
+    : ExpressionNode(Join(loc, l->location(), r->location())), l_(l), r_(r) {}
 
 NamedValue::NamedValue(Loc loc, std::string s)
     : ExpressionNode(loc), name_(std::move(s)) {}
 
-PowerExp::PowerExp(Loc loc, std::unique_ptr<ExpressionNode> b, int e)
-    : ExpressionNode(Join(loc, b->location())), b_(std::move(b)), e_(e) {}
+PowerExp::PowerExp(Loc loc, ExpressionNode* b, int e)
+    : ExpressionNode(Join(loc, b->location())), b_(b), e_(e) {}
 
-BinaryExpression::BinaryExpression(std::unique_ptr<ExpressionNode> l,
-                                   std::unique_ptr<ExpressionNode> r)
-    : ExpressionNode(Join(l->location(), r->location())),
-      l_(std::move(l)),
-      r_(std::move(r)) {}
+BinaryExpression::BinaryExpression(ExpressionNode* l, ExpressionNode* r)
+    : ExpressionNode(Join(l->location(), r->location())), l_(l), r_(r) {}
 
-NegativeExp::NegativeExp(Loc loc, std::unique_ptr<ExpressionNode> e)
-    : ExpressionNode(Join(loc, e->location())), e_(std::move(e)) {}
+NegativeExp::NegativeExp(Loc loc, ExpressionNode* e)
+    : ExpressionNode(Join(loc, e->location())), e_(e) {}
 
-Define::Define(Loc loc, std::unique_ptr<std::string> name,
-               std::unique_ptr<LiteralValue> val, std::unique_ptr<UnitExp> unit)
+Define::Define(Loc loc, std::string name, const LiteralValue* val,
+               const UnitExp* unit)
     : ExpressionNode(loc),
-      name_(std::move(*name)),
-      val_(std::move(val)),
-      unit_(std::move(unit)) {}
+      name_(std::move(name)),
+      value_(val->value()),
+      unit_(unit) {}
+
+namespace {
+const UnitExp* NoUnit() {
+  static const UnitExp* const kNone = new UnitExp(Loc{});
+  return kNone;
+}
+}  // namespace
 
 Define::Define(Loc loc, std::string name, double val)
-    : Define(loc, absl::make_unique<std::string>(std::move(name)),
-             absl::make_unique<LiteralValue>(loc, val),
-             absl::make_unique<UnitExp>(loc)) {}
+    : ExpressionNode(loc),
+      name_(std::move(name)),
+      value_(val),
+      unit_(NoUnit()) {}
 
-Specification::Specification(Loc loc, std::unique_ptr<std::string> name,
-                             std::unique_ptr<UnitExp> unit)
+Specification::Specification(Loc loc, std::string name, const UnitExp* unit)
     : NodeI(Join(loc, unit->location())),
-      name_(std::move(*name)),
-      unit_(std::move(unit)) {}
+      name_(std::move(name)),
+      unit_(unit) {}
 
-////////
-
-void Document::AddEquality(std::unique_ptr<Equality> e) {
-  equality_.emplace_back(std::move(e));
-}
-void Document::AddDefinition(std::unique_ptr<Define> d) {
-  defines_.emplace_back(std::move(d));
-}
-void Document::AddSpecification(std::unique_ptr<Specification> s) {
-  specs_.emplace_back(std::move(s));
-}
-void Document::AddUnitDefinition(std::unique_ptr<UnitDef> u) {
-  unit_def_.emplace_back(std::move(u));
-}
-
-std::vector<Equality*> Document::equality() const {
-  std::vector<Equality*> ret;
-  ret.reserve(equality_.size());
-  for (const auto& e : equality_) ret.push_back(e.get());
-  return ret;
-}
-
-std::vector<Define*> Document::defines() const {
-  std::vector<Define*> ret;
-  ret.reserve(defines_.size());
-  for (const auto& d : defines_) ret.push_back(d.get());
-  return ret;
-}
-
-std::vector<Specification*> Document::specs() const {
-  std::vector<Specification*> ret;
-  ret.reserve(specs_.size());
-  for (const auto& s : specs_) ret.push_back(s.get());
-  return ret;
-}
-
-std::vector<UnitDef*> Document::unit_definition() const {
-  std::vector<UnitDef*> ret;
-  ret.reserve(unit_def_.size());
-  for (const auto& d : unit_def_) ret.push_back(d.get());
-  return ret;
-}
+Hint::Hint(Loc loc, std::string name, const LiteralValue* val,
+           const UnitExp* unit)
+    : NodeI(loc), name_(std::move(name)), value_(val->value()), unit_(unit) {}
 
 /////////////////////////////////////////////////////////////////////////
 
@@ -199,6 +197,31 @@ bool DifExp::Visit(VisitNodes* v) const { return (*v)(*this); }
 bool NegativeExp::Visit(VisitNodes* v) const { return (*v)(*this); }
 bool Define::Visit(VisitNodes* v) const { return (*v)(*this); }
 bool Specification::Visit(VisitNodes* v) const { return (*v)(*this); }
+bool Hint::Visit(VisitNodes* v) const { return (*v)(*this); }
 bool Document::Visit(VisitNodes* v) const { return (*v)(*this); }
 
+namespace {
+template <class T>
+void MoveAppend(std::vector<T>* from, std::vector<T>* to) {
+  to->insert(to->end(), std::make_move_iterator(from->begin()),
+             std::make_move_iterator(from->end()));
+  from->clear();
+}
+}  // namespace
+
+void Document::Merge(std::unique_ptr<Document> other) {
+  for (auto* n : other->nodes_) {
+    n->id_ = nodes_.size();
+    nodes_.push_back(n);
+  }
+  other->nodes_.clear();
+  MoveAppend(&other->equality_, &equality_);
+  MoveAppend(&other->defines_, &defines_);
+  MoveAppend(&other->specs_, &specs_);
+  MoveAppend(&other->hints_, &hints_);
+  MoveAppend(&other->unit_def_, &unit_def_);
+  MoveAppend(&other->merged_, &merged_);
+  merged_.push_back(std::move(other));
+}
+
 }  // namespace tbd
@@ -38,14 +38,21 @@
 #include "absl/base/attributes.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "tbd/arena.h"
 #include "tbd/dimensions.h"
 
 namespace tbd {
+// Source file names are interned in a process wide table so that locations
+// only need to carry a small id. Id 0 is "??" (unknown).
+int InternFileName(const std::string& name);
+const std::string& FileName(int id);
+
 // Generaric location type.
 struct Loc {
   template <class L>
   Loc(L l)
-      : filename(*l.begin.filename),
+      : file(InternFileName(*l.begin.filename)),
         line_begin(l.begin.line),
         line_end(l.end.line),
         col_begin(l.begin.column),
@@ -54,17 +61,20 @@ struct Loc {
 
   friend ::std::ostream& operator<<(::std::ostream& os, const Loc& l) {
     if (l.line_begin == l.line_end) {
-      return os << l.filename << ":" << l.line_begin << ":[" << l.col_begin
+      return os << l.filename() << ":" << l.line_begin << ":[" << l.col_begin
                 << "," << l.col_end << "]";
     } else {
-      return os << l.filename << ":" << l.line_begin << ":" << l.col_begin
+      return os << l.filename() << ":" << l.line_begin << ":" << l.col_begin
                 << " to " << l.line_end << ":" << l.col_end;
     }
   }
 
-  std::string line() const { return absl::StrCat(filename, ":", line_begin); }
+  const std::string& filename() const { return FileName(file); }
+  std::string line() const {
+    return absl::StrCat(filename(), ":", line_begin);
+  }
 
-  std::string filename = "??";
+  int file = 0;
   int line_begin = 0, line_end = 0;
   int col_begin = 0, col_end = 0;
 };
@@ -88,9 +98,14 @@ class NodeI {
   explicit NodeI(Loc loc) : loc_(std::move(loc)) {}
   virtual ~NodeI() = default;
 
+  // A small integer unique to this node within its Document, for indexing
+  // side tables. They are handed out densely by Document::New in the order
+  // the nodes are created. Nodes made any other way have -1.
+  int id() const { return id_; }
+
   const Loc& location() const { return loc_; }
   void set_location(const Loc& l) { loc_ = l; }
-  const std::string& source_file() const { return loc_.filename; }
+  const std::string& source_file() const { return loc_.filename(); }
   int source_line() const { return loc_.line_begin; }
 
   ABSL_MUST_USE_RESULT bool VisitNode(VisitNodes* v) const { return Visit(v); }
@@ -98,13 +113,20 @@ class NodeI {
  private:
   ABSL_MUST_USE_RESULT virtual bool Visit(VisitNodes*) const = 0;
 
+  friend class Document;
+
   Loc loc_;
+  int id_ = -1;
 };
 
+// Order nodes by location (and then id), i.e. independent of where they are
+// in memory.
 struct StableNodeCompare {
   bool operator()(NodeI const* l, NodeI const* r) const;
 };
 
+// Nodes don't own their children. In general everything is owned by the
+// Document's arena (see Document::New).
 class ExpressionNode : public NodeI {
  public:
   using NodeI::NodeI;
@@ -112,14 +134,13 @@ class ExpressionNode : public NodeI {
 
 class BinaryExpression : public ExpressionNode {
  public:
-  BinaryExpression(std::unique_ptr<ExpressionNode> l,
-                   std::unique_ptr<ExpressionNode> r);
+  BinaryExpression(ExpressionNode* l, ExpressionNode* r);
 
-  ExpressionNode* left() const { return l_.get(); }
-  ExpressionNode* right() const { return r_.get(); }
+  ExpressionNode* left() const { return l_; }
+  ExpressionNode* right() const { return r_; }
 
  private:
-  std::unique_ptr<ExpressionNode> l_, r_;
+  ExpressionNode *l_, *r_;
 };
 
 class UnitExp final : public NodeI {
@@ -149,31 +170,30 @@ class UnitDef final : public NodeI {
 
  public:
   using NodeI::NodeI;
-  UnitDef(Loc loc, std::unique_ptr<std::string>, std::unique_ptr<LiteralValue>,
-          std::unique_ptr<UnitExp>);
+  UnitDef(Loc loc, std::string name, const LiteralValue* lit,
+          const UnitExp* unit);
 
   const std::string& name() const { return name_; }
-  const float value() const { return value_; }
+  double value() const { return value_; }
   const UnitExp& unit() const { return *unit_; }
 
  private:
   std::string name_;
   double value_;
-  std::unique_ptr<UnitExp> unit_;
+  const UnitExp* unit_;
 };
 
 class Equality final : public ExpressionNode {
   ABSL_MUST_USE_RESULT bool Visit(VisitNodes*) const override;
 
  public:
-  Equality(Loc loc, std::unique_ptr<ExpressionNode> l,
-           std::unique_ptr<ExpressionNode> r);
+  Equality(Loc loc, ExpressionNode* l, ExpressionNode* r);
 
-  ExpressionNode* left() const { return l_.get(); }
-  ExpressionNode* right() const { return r_.get(); }
+  ExpressionNode* left() const { return l_; }
+  ExpressionNode* right() const { return r_; }
 
  private:
-  std::unique_ptr<ExpressionNode> l_, r_;
+  ExpressionNode *l_, *r_;
 };
 
 class LiteralValue final : public ExpressionNode {
@@ -184,6 +204,7 @@ class LiteralValue final : public ExpressionNode {
   LiteralValue(Loc loc, double f) : ExpressionNode(loc), value_(f) {}
 
   double value() const { return value_; }
+  void Negate() { value_ = -value_; }
 
  private:
   double value_;
@@ -193,12 +214,10 @@ class NamedValue final : public ExpressionNode {
   ABSL_MUST_USE_RESULT bool Visit(VisitNodes*) const override;
 
  public:
-  NamedValue(Loc loc, std::unique_ptr<std::string> s);
+  NamedValue(Loc loc, std::string s);
 
   std::string name() const { return name_; }
 
-  NamedValue(Loc loc, std::string s);  // for testing
-
  private:
   std::string name_;
 };
@@ -207,13 +226,13 @@ class PowerExp final : public ExpressionNode {
   ABSL_MUST_USE_RESULT bool Visit(VisitNodes*) const override;
 
  public:
-  PowerExp(Loc loc, std::unique_ptr<ExpressionNode> b, int e);
+  PowerExp(Loc loc, ExpressionNode* b, int e);
 
-  ExpressionNode* base() const { return b_.get(); }
+  ExpressionNode* base() const { return b_; }
   int exp() const { return e_; }
 
  private:
-  std::unique_ptr<ExpressionNode> b_;
+  ExpressionNode* b_;
   int e_;
 };
 
@@ -249,45 +268,62 @@ class NegativeExp final : public ExpressionNode {
   ABSL_MUST_USE_RESULT bool Visit(VisitNodes*) const override;
 
  public:
-  NegativeExp(Loc loc, std::unique_ptr<ExpressionNode> e);
-  ExpressionNode* value() const { return e_.get(); }
+  NegativeExp(Loc loc, ExpressionNode* e);
+  ExpressionNode* value() const { return e_; }
 
  private:
-  std::unique_ptr<ExpressionNode> e_;
+  ExpressionNode* e_;
 };
 
 class Define final : public ExpressionNode {
   ABSL_MUST_USE_RESULT bool Visit(VisitNodes*) const override;
 
  public:
-  Define(Loc loc, std::unique_ptr<std::string> name,
-         std::unique_ptr<LiteralValue> val, std::unique_ptr<UnitExp> unit);
+  Define(Loc loc, std::string name, const LiteralValue* val,
+         const UnitExp* unit);
 
   const std::string& name() const { return name_; }
-  double value() const { return val_->value(); }
+  double value() const { return value_; }
   const UnitExp& unit() const { return *unit_; }
 
   Define(Loc loc, std::string s, double v);  // for testing
 
  private:
   std::string name_;
-  std::unique_ptr<LiteralValue> val_;
-  std::unique_ptr<UnitExp> unit_;
+  double value_;
+  const UnitExp* unit_;
 };
 
 class Specification final : public NodeI {
   ABSL_MUST_USE_RESULT bool Visit(VisitNodes*) const override;
 
  public:
-  Specification(Loc loc, std::unique_ptr<std::string> name,
-                std::unique_ptr<UnitExp> unit);
+  Specification(Loc loc, std::string name, const UnitExp* unit);
+
+  const std::string& name() const { return name_; }
+  const UnitExp& unit() const { return *unit_; }
+
+ private:
+  std::string name_;
+  const UnitExp* unit_;
+};
+
+// A starting guess for a value that gets solved for, e.g. "X ~= 3 [m];".
+class Hint final : public NodeI {
+  ABSL_MUST_USE_RESULT bool Visit(VisitNodes*) const override;
+
+ public:
+  Hint(Loc loc, std::string name, const LiteralValue* val,
+       const UnitExp* unit);
 
   const std::string& name() const { return name_; }
+  double value() const { return value_; }
   const UnitExp& unit() const { return *unit_; }
 
  private:
   std::string name_;
-  std::unique_ptr<UnitExp> unit_;
+  double value_;
+  const UnitExp* unit_;
 };
 
 class Document final : public NodeI {
@@ -296,21 +332,43 @@ class Document final : public NodeI {
  public:
   Document() : NodeI(Loc{}) {}
 
-  void AddEquality(std::unique_ptr<Equality> e);
-  void AddDefinition(std::unique_ptr<Define> d);
-  void AddSpecification(std::unique_ptr<Specification> s);
-  void AddUnitDefinition(std::unique_ptr<UnitDef> u);
+  // Allocate a node that lives as long as the document. All of the nodes
+  // are freed together when the document is.
+  template <class T, class... A>
+  T* New(A&&... a) {
+    T* ret = arena_.New<T>(std::forward<A>(a)...);
+    ret->id_ = nodes_.size();
+    nodes_.push_back(ret);
+    return ret;
+  }
+
+  // Add a top level node (from New).
+  void AddEquality(Equality* e) { equality_.push_back(e); }
+  void AddDefinition(Define* d) { defines_.push_back(d); }
+  void AddSpecification(Specification* s) { specs_.push_back(s); }
+  void AddHint(Hint* h) { hints_.push_back(h); }
+  void AddUnitDefinition(UnitDef* u) { unit_def_.push_back(u); }
+
+  // Move the top level nodes of another document to the end of this one.
+  // This document keeps the other alive as long as it needs its nodes, and
+  // gives them ids following its own.
+  void Merge(std::unique_ptr<Document> other);
 
-  std::vector<Equality*> equality() const;
-  std::vector<Define*> defines() const;
-  std::vector<Specification*> specs() const;
-  std::vector<UnitDef*> unit_definition() const;
+  absl::Span<Equality* const> equality() const { return equality_; }
+  absl::Span<Define* const> defines() const { return defines_; }
+  absl::Span<Specification* const> specs() const { return specs_; }
+  absl::Span<Hint* const> hints() const { return hints_; }
+  absl::Span<UnitDef* const> unit_definition() const { return unit_def_; }
 
  private:
-  std::vector<std::unique_ptr<Equality>> equality_;
-  std::vector<std::unique_ptr<Define>> defines_;
-  std::vector<std::unique_ptr<Specification>> specs_;
-  std::vector<std::unique_ptr<UnitDef>> unit_def_;
+  Arena arena_;
+  std::vector<NodeI*> nodes_;  // By id.
+  std::vector<Equality*> equality_;
+  std::vector<Define*> defines_;
+  std::vector<Specification*> specs_;
+  std::vector<Hint*> hints_;
+  std::vector<UnitDef*> unit_def_;
+  std::vector<std::unique_ptr<Document>> merged_;
 };
 
 class VisitNodes {
@@ -331,6 +389,7 @@ class VisitNodes {
   ABSL_MUST_USE_RESULT virtual bool operator()(const NegativeExp&) = 0;
   ABSL_MUST_USE_RESULT virtual bool operator()(const Define&) = 0;
   ABSL_MUST_USE_RESULT virtual bool operator()(const Specification&) = 0;
+  ABSL_MUST_USE_RESULT virtual bool operator()(const Hint&) = 0;
   ABSL_MUST_USE_RESULT virtual bool operator()(const Document&) = 0;
 
   // Only exact matches are allowed. Suppress all conversions.
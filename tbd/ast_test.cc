@@ -74,6 +74,7 @@ class TestVisitor : public VisitNodesWithErrors {
   bool operator()(const NegativeExp&) { return false; }
   bool operator()(const Define&) { return false; }
   bool operator()(const Specification&) { return false; }
+  bool operator()(const Hint&) { return false; }
   bool operator()(const Document&) { return false; }
 };
 
@@ -83,10 +84,49 @@ TEST(TestErrorMessage, Basic) {
   ErrorMessage(__FILE__, __LINE__, &sink, TestNode{loc{}}).get() << "Boo";
   EXPECT_EQ(err,
 #ifndef NDEBUG
-            "(tbd/ast_test.cc:83) "
+            "(tbd/ast_test.cc:84) "
 #endif  // NDEBUG
             "foo:123:[456,456]: Boo\n");
 }
 
+TEST(TestLoc, FileNames) {
+  static_assert(std::is_trivially_copyable<Loc>::value, "");
+
+  Loc a{loc{}}, b{loc{}}, none;
+  EXPECT_EQ(a.file, b.file);
+  EXPECT_NE(a.file, none.file);
+  EXPECT_EQ(a.filename(), "foo");
+  EXPECT_EQ(none.filename(), "??");
+  EXPECT_EQ(FileName(InternFileName("foo")), "foo");
+  EXPECT_NE(InternFileName("bar"), a.file);
+
+  std::stringstream out;
+  out << a;
+  EXPECT_EQ(out.str(), "foo:123:[456,456]");
+}
+
+TEST(TestNodeI, Ids) {
+  Document doc;
+  auto *a = doc.New<TestNode>(loc{}), *b = doc.New<TestNode>(loc{}),
+       *c = doc.New<TestNode>(loc{});
+  EXPECT_EQ(a->id(), 0);
+  EXPECT_EQ(b->id(), 1);
+  EXPECT_EQ(c->id(), 2);
+  EXPECT_EQ(TestNode(loc{}).id(), -1);
+
+  // Same location, so ordered by id.
+  StableNodeCompare before;
+  EXPECT_TRUE(before(a, b));
+  EXPECT_FALSE(before(b, a));
+
+  // Each document starts from zero, and merging keeps the ids dense.
+  auto other = absl::make_unique<Document>();
+  auto* d = other->New<TestNode>(loc{});
+  EXPECT_EQ(d->id(), 0);
+  doc.Merge(std::move(other));
+  EXPECT_EQ(d->id(), 3);
+  EXPECT_EQ(doc.New<TestNode>(loc{})->id(), 4);
+}
+
 }  // namespace
 }  // namespace tbd
\ No newline at end of file
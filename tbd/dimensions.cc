@@ -33,70 +33,19 @@
 
 namespace tbd {
 
-bool operator==(const Dimension& l, const Dimension& r) {
-  return l.L_ == r.L_ && l.M_ == r.M_ && l.T_ == r.T_ && l.I_ == r.I_ &&
-         l.K_ == r.K_ && l.N_ == r.N_ && l.J_ == r.J_;
-}
-
-bool operator!=(const Dimension& l, const Dimension& r) { return !(l == r); }
-
-Dimension operator*(const Dimension& l, const Dimension& r) {
-  return {l.L_ + r.L_, l.M_ + r.M_, l.T_ + r.T_, l.I_ + r.I_,
-          l.K_ + r.K_, l.N_ + r.N_, l.J_ + r.J_};
-}
-
-Dimension operator/(const Dimension& l, const Dimension& r) {
-  return {l.L_ - r.L_, l.M_ - r.M_, l.T_ - r.T_, l.I_ - r.I_,
-          l.K_ - r.K_, l.N_ - r.N_, l.J_ - r.J_};
-}
-
-Dimension pow(const Dimension& l, int i) {
-  return {l.L_ * i, l.M_ * i, l.T_ * i, l.I_ * i, l.K_ * i, l.N_ * i, l.J_ * i};
-}
-
-Dimension root(const Dimension& l, int i) {
-  return {l.L_ / i, l.M_ / i, l.T_ / i, l.I_ / i, l.K_ / i, l.N_ / i, l.J_ / i};
-}
-
 ::std::ostream& operator<<(::std::ostream& os, const Dimension& d) {
   using D = Dimension::D;
+  static constexpr const char* kNames[Dimension::kBase] = {
+      "m", "kg", "s", "A", "K", "mol", "cd"};
 
   auto* ret = &(os << "[");
   const char* c = "";
 
-  if (d.L_ != D::zero()) {
-    ret = &(*ret << "m");
-    if (d.L_ != D::one()) ret = &(*ret << "^" << d.L_);
-    c = ",";
-  }
-  if (d.M_ != D::zero()) {
-    ret = &(*ret << c << "kg");
-    if (d.M_ != D::one()) ret = &(*ret << "^" << d.M_);
-    c = ",";
-  }
-  if (d.T_ != D::zero()) {
-    ret = &(*ret << c << "s");
-    if (d.T_ != D::one()) ret = &(*ret << "^" << d.T_);
-    c = ",";
-  }
-  if (d.I_ != D::zero()) {
-    ret = &(*ret << c << "A");
-    if (d.I_ != D::one()) ret = &(*ret << "^" << d.I_);
-    c = ",";
-  }
-  if (d.K_ != D::zero()) {
-    ret = &(*ret << c << "K");
-    if (d.K_ != D::one()) ret = &(*ret << "^" << d.K_);
-    c = ",";
-  }
-  if (d.N_ != D::zero()) {
-    ret = &(*ret << c << "mol");
-    if (d.N_ != D::one()) ret = &(*ret << "^" << d.N_);
-    c = ",";
-  }
-  if (d.J_ != D::zero()) {
-    ret = &(*ret << c << "cd");
-    if (d.J_ != D::one()) ret = &(*ret << "^" << d.J_);
+  for (int x = 0; x < Dimension::kBase; x++) {
+    D e = d.Exp(x);
+    if (e == D::zero()) continue;
+    ret = &(*ret << c << kNames[x]);
+    if (e != D::one()) ret = &(*ret << "^" << e);
     c = ",";
   }
 
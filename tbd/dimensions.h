@@ -29,6 +29,7 @@
 #define TBD_DIMENSIONS_H_
 
 #include <cmath>
+#include <cstdint>
 #include <ostream>
 #include <string>
 
@@ -40,59 +41,85 @@ namespace tbd {
 
 class Dimension {
  public:
-  Dimension(const Dimension&) = default;
-
-  static Dimension Dimensionless() { return {0, 0, 0, 0, 0, 0, 0}; }
-  static Dimension L() { return {1, 0, 0, 0, 0, 0, 0}; }
-  static Dimension M() { return {0, 1, 0, 0, 0, 0, 0}; }
-  static Dimension T() { return {0, 0, 1, 0, 0, 0, 0}; }
-  static Dimension I() { return {0, 0, 0, 1, 0, 0, 0}; }
-  static Dimension K() { return {0, 0, 0, 0, 1, 0, 0}; }
-  static Dimension N() { return {0, 0, 0, 0, 0, 1, 0}; }
-  static Dimension J() { return {0, 0, 0, 0, 0, 0, 1}; }
-
-  friend bool operator==(const Dimension& l, const Dimension& r);
-  friend bool operator!=(const Dimension& l, const Dimension& r);
+  constexpr Dimension(const Dimension&) = default;
+  constexpr Dimension& operator=(const Dimension&) = default;
+
+  static constexpr Dimension Dimensionless() { return {0, 0, 0, 0, 0, 0, 0}; }
+  static constexpr Dimension L() { return {1, 0, 0, 0, 0, 0, 0}; }
+  static constexpr Dimension M() { return {0, 1, 0, 0, 0, 0, 0}; }
+  static constexpr Dimension T() { return {0, 0, 1, 0, 0, 0, 0}; }
+  static constexpr Dimension I() { return {0, 0, 0, 1, 0, 0, 0}; }
+  static constexpr Dimension K() { return {0, 0, 0, 0, 1, 0, 0}; }
+  static constexpr Dimension N() { return {0, 0, 0, 0, 0, 1, 0}; }
+  static constexpr Dimension J() { return {0, 0, 0, 0, 0, 0, 1}; }
+
+  // Values are always normalized so this is a lane by lane compare.
+  friend constexpr bool operator==(const Dimension& l, const Dimension& r) {
+    bool eq = true;
+    for (int x = 0; x < kLanes; x++) eq &= (l.e_[x] == r.e_[x]);
+    return eq;
+  }
+  friend constexpr bool operator!=(const Dimension& l, const Dimension& r) {
+    return !(l == r);
+  }
 
-  friend Dimension operator*(const Dimension& l, const Dimension& r);
-  friend Dimension operator/(const Dimension& l, const Dimension& r);
-  friend Dimension pow(const Dimension& l, int i);
-  friend Dimension root(const Dimension& l, int i);
+  friend constexpr Dimension operator*(const Dimension& l,
+                                       const Dimension& r) {
+    return Combine(l, r, 1);
+  }
+  friend constexpr Dimension operator/(const Dimension& l,
+                                       const Dimension& r) {
+    return Combine(l, r, -1);
+  }
+  friend constexpr Dimension pow(const Dimension& l, int i) {
+    Dimension ret = l;
+    for (int x = 0; x < kBase; x++) ret.e_[x] *= i;
+    ret.Normalize();
+    return ret;
+  }
+  friend constexpr Dimension root(const Dimension& l, int i) {
+    Dimension ret = l;
+    ret.e_[kBase] *= i;
+    ret.Normalize();
+    return ret;
+  }
 
   friend ::std::ostream& operator<<(::std::ostream& os, const Dimension& d);
   std::string to_str() const;
 
-  std::string l() const { return L_.ToString(); }
-  std::string m() const { return M_.ToString(); }
-  std::string t() const { return T_.ToString(); }
-  std::string i() const { return I_.ToString(); }
-  std::string k() const { return K_.ToString(); }
-  std::string n() const { return N_.ToString(); }
-  std::string j() const { return J_.ToString(); }
+  std::string l() const { return Exp(0).ToString(); }
+  std::string m() const { return Exp(1).ToString(); }
+  std::string t() const { return Exp(2).ToString(); }
+  std::string i() const { return Exp(3).ToString(); }
+  std::string k() const { return Exp(4).ToString(); }
+  std::string n() const { return Exp(5).ToString(); }
+  std::string j() const { return Exp(6).ToString(); }
 
  private:
   struct D {
     // A rational number type.
     // Note this type more or less ignores division by zero.
    public:
-    D(int n, int d) : D(n, d, (d == 0) ? n : gcd(n, d)) {}
+    constexpr D(int n, int d) : D(n, d, (d == 0) ? n : gcd(n, d)) {}
 
-    static D zero() { return {0, 1}; }
-    static D one() { return {1, 1}; }
+    static constexpr D zero() { return {0, 1}; }
+    static constexpr D one() { return {1, 1}; }
 
-    friend D operator+(D l, D r) {
+    friend constexpr D operator+(D l, D r) {
       return {l.n_ * r.d_ + r.n_ * l.d_, l.d_ * r.d_};
     }
-    friend D operator-(D l, D r) {
+    friend constexpr D operator-(D l, D r) {
       return {l.n_ * r.d_ - r.n_ * l.d_, l.d_ * r.d_};
     }
 
-    friend D operator*(D l, int r) { return {l.n_ * r, l.d_}; }
-    friend D operator*(int l, D r) { return r * l; }
-    friend D operator/(D l, int r) { return {l.n_, l.d_ * r}; }
+    friend constexpr D operator*(D l, int r) { return {l.n_ * r, l.d_}; }
+    friend constexpr D operator*(int l, D r) { return r * l; }
+    friend constexpr D operator/(D l, int r) { return {l.n_, l.d_ * r}; }
 
-    friend bool operator==(D l, D r) { return (l.n_ * r.d_) == (r.n_ * l.d_); }
-    friend bool operator!=(D l, D r) { return !(l == r); }
+    friend constexpr bool operator==(D l, D r) {
+      return (l.n_ * r.d_) == (r.n_ * l.d_);
+    }
+    friend constexpr bool operator!=(D l, D r) { return !(l == r); }
 
     std::string ToString() const {
       if (d_ == 0 || d_ == 1) return absl::StrCat(n_);
@@ -103,14 +130,11 @@ class Dimension {
       return os <<d.ToString();
     }
 
-   private:
-    D(int n, int d, int g) : n_(n / g), d_(d / g) {}
-
     // gcd of the argument taking the sign from the second
-    static int gcd(int a, int b) {
+    static constexpr int gcd(int a, int b) {
       int r = b < 0 ? -1 : 1;
-      a = std::abs(a);
-      b = std::abs(b);
+      a = a < 0 ? -a : a;
+      b = b < 0 ? -b : b;
       while (a != 0) {
         int t = b % a;
         b = a;
@@ -119,31 +143,65 @@ class Dimension {
       return b * r;
     }
 
+   private:
+    constexpr D(int n, int d, int g) : n_(g ? n / g : n), d_(g ? d / g : d) {}
+
     int n_ = 0, d_ = 1;
   };
 
-  Dimension(int l, int m, int t, int i, int k, int n, int j)
-      : L_(l, 1), M_(m, 1), T_(t, 1), I_(i, 1), K_(k, 1), N_(n, 1), J_(j, 1) {}
-  Dimension(D l, D m, D t, D i, D k, D n, D j)
-      : L_(l), M_(m), T_(t), I_(i), K_(k), N_(n), J_(j) {}
+  // The exponents of the seven base dimensions are stored as numerators
+  // over one shared, positive denominator (the last lane). Normalize()
+  // keeps that in lowest terms so equal values have equal lanes.
+  static constexpr int kBase = 7;
+  static constexpr int kLanes = 8;
+
+  constexpr Dimension() = default;
+  constexpr Dimension(int l, int m, int t, int i, int k, int n, int j)
+      : e_{l, m, t, i, k, n, j, 1} {}
+
+  constexpr D Exp(int x) const { return D(e_[x], e_[kBase]); }
+
+  static constexpr Dimension Combine(const Dimension& l, const Dimension& r,
+                                     int sign) {
+    Dimension ret;
+    if (l.e_[kBase] == r.e_[kBase]) {  // The common case; usually both 1.
+      for (int x = 0; x < kBase; x++) ret.e_[x] = l.e_[x] + sign * r.e_[x];
+      ret.e_[kBase] = l.e_[kBase];
+    } else {
+      for (int x = 0; x < kBase; x++) {
+        ret.e_[x] = l.e_[x] * r.e_[kBase] + sign * r.e_[x] * l.e_[kBase];
+      }
+      ret.e_[kBase] = l.e_[kBase] * r.e_[kBase];
+    }
+    ret.Normalize();
+    return ret;
+  }
+
+  constexpr void Normalize() {
+    if (e_[kBase] == 1) return;
+    int g = e_[kBase];
+    for (int x = 0; x < kBase; x++) g = D::gcd(e_[x], g);
+    if (g == 0) return;  // Division by zero.
+    for (int x = 0; x < kLanes; x++) e_[x] /= g;
+  }
 
   friend class DimensionTest;
 
-  D L_, M_, T_, I_, K_, N_, J_;
+  int32_t e_[kLanes] = {0, 0, 0, 0, 0, 0, 0, 1};
 };
 
 struct Unit {
   double scale;
   Dimension dim;
 
-  static Unit value() { return {1, Dimension::Dimensionless()}; }
-  static Unit m() { return {1, Dimension::L()}; }
-  static Unit kg() { return {1, Dimension::M()}; }
-  static Unit s() { return {1, Dimension::T()}; }
-  static Unit A() { return {1, Dimension::I()}; }
-  static Unit K() { return {1, Dimension::K()}; }
-  static Unit mol() { return {1, Dimension::N()}; }
-  static Unit cd() { return {1, Dimension::J()}; }
+  static constexpr Unit value() { return {1, Dimension::Dimensionless()}; }
+  static constexpr Unit m() { return {1, Dimension::L()}; }
+  static constexpr Unit kg() { return {1, Dimension::M()}; }
+  static constexpr Unit s() { return {1, Dimension::T()}; }
+  static constexpr Unit A() { return {1, Dimension::I()}; }
+  static constexpr Unit K() { return {1, Dimension::K()}; }
+  static constexpr Unit mol() { return {1, Dimension::N()}; }
+  static constexpr Unit cd() { return {1, Dimension::J()}; }
 
   friend ::std::ostream& operator<<(::std::ostream& os, const Unit& u) {
     return os << u.scale << u.dim;
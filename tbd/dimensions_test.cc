@@ -137,5 +137,28 @@ TEST_F(DimensionTest, Output) {
   EXPECT_EQ(res.to_str(), "[m^2,kg,s^-3,A^-2]");
 }
 
+TEST_F(DimensionTest, Rational) {
+  auto half = root(Dimension::L(), 2);
+  EXPECT_NE(half, Dimension::L());
+  EXPECT_EQ(half * half, Dimension::L());
+  EXPECT_EQ(pow(half, 4), pow(Dimension::L(), 2));
+  EXPECT_EQ(root(pow(Dimension::T(), 6), 4), pow(root(Dimension::T(), 2), 3));
+  EXPECT_EQ(root(Dimension::L(), -2), Dimension::Dimensionless() / half);
+  EXPECT_EQ(half / half, Dimension::Dimensionless());
+
+  EXPECT_EQ(half.l(), "(1/2)");
+  EXPECT_EQ((half * root(Dimension::T(), -3)).to_str(),
+            "[m^(1/2),s^(-1/3)]");
+}
+
+TEST_F(DimensionTest, Constexpr) {
+  constexpr auto vel = Dimension::L() / Dimension::T();
+  constexpr auto acc = vel / Dimension::T();
+  static_assert(acc == Dimension::L() * pow(Dimension::T(), -2), "");
+  static_assert(root(acc * acc, 2) == acc, "");
+  static_assert(root(Dimension::L(), 2) != Dimension::L(), "");
+  static_assert(Unit::kg().dim == Dimension::M(), "");
+}
+
 }  // namespace
 }  // namespace tbd
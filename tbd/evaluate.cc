@@ -27,6 +27,10 @@
 
 #include "tbd/evaluate.h"
 
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <queue>
 #include <set>
 #include <string>
 #include <utility>
@@ -39,6 +43,7 @@
 #include "tbd/find.h"
 #include "tbd/newton_raphson.h"
 #include "tbd/ops.h"
+#include "tbd/plan.h"
 #include "tbd/select_solvable.h"
 #include "tbd/semantic.h"
 
@@ -57,7 +62,6 @@ bool Evaluate::operator()(const Equality& e) {
       if (allow_conflict_) {
         ops_->emplace_back(absl::make_unique<OpCheck>(out_idx_++, l, r));
         i->equ_processed = true;
-        progress_ = true;
       } else {
         SYM_ERROR(e) << "Conflicting result";
         error_ = true;
@@ -72,9 +76,8 @@ bool Evaluate::operator()(const Equality& e) {
     ops_->emplace_back(absl::make_unique<OpAssign>(i, l));
     ops_->emplace_back(absl::make_unique<OpAssign>(r, l));
     i->equ_processed = true;
-    i->resolved = true;
-    r->resolved = true;
-    progress_ = true;
+    Resolve(i);
+    Resolve(r);
     return true;
   }
 
@@ -83,9 +86,8 @@ bool Evaluate::operator()(const Equality& e) {
     ops_->emplace_back(absl::make_unique<OpAssign>(i, r));
     ops_->emplace_back(absl::make_unique<OpAssign>(l, r));
     i->equ_processed = true;
-    i->resolved = true;
-    l->resolved = true;
-    progress_ = true;
+    Resolve(i);
+    Resolve(l);
     return true;
   }
 
@@ -99,8 +101,7 @@ bool Evaluate::operator()(const LiteralValue& l) {
 
   node->value = l.value();
   node->equ_processed = true;
-  node->resolved = true;
-  progress_ = true;
+  Resolve(node);
 
   return true;
 }
@@ -126,8 +127,7 @@ bool Evaluate::operator()(const PowerExp& e) {
         ops_->emplace_back(absl::make_unique<OpCheck>(out_idx_++, exp, anon));
         exp->equ_processed = true;
         anon->equ_processed = true;
-        anon->resolved = true;
-        progress_ = true;
+        Resolve(anon);
       } else {
         SYM_ERROR(e) << "Conflicting result";
         error_ = true;
@@ -141,8 +141,7 @@ bool Evaluate::operator()(const PowerExp& e) {
     CHECK(!exp->resolved);
     ops_->emplace_back(absl::make_unique<OpExp>(exp, b, e.exp()));
     exp->equ_processed = true;
-    exp->resolved = true;
-    progress_ = true;
+    Resolve(exp);
     return true;
   }
 
@@ -151,8 +150,7 @@ bool Evaluate::operator()(const PowerExp& e) {
     if (e.exp() % 2 == 1) {
       ops_->emplace_back(absl::make_unique<OpExp>(b, exp, 1.0 / e.exp()));
       exp->equ_processed = true;
-      b->resolved = true;
-      progress_ = true;
+      Resolve(b);
       return true;
     } else {
       LOG(INFO) << "^ " << exp->resolved << b->resolved;
@@ -178,8 +176,7 @@ bool Evaluate::operator()(const ProductExp& p) {
         ops_->emplace_back(absl::make_unique<OpCheck>(out_idx_++, n, anon));
         n->equ_processed = true;
         anon->equ_processed = true;
-        anon->resolved = true;
-        progress_ = true;
+        Resolve(anon);
       } else {
         SYM_ERROR(p) << "Conflicting result";
         error_ = true;
@@ -193,8 +190,7 @@ bool Evaluate::operator()(const ProductExp& p) {
     CHECK(!n->resolved);
     ops_->emplace_back(absl::make_unique<OpMul>(n, l, r));
     n->equ_processed = true;
-    n->resolved = true;
-    progress_ = true;
+    Resolve(n);
     return true;
   }
 
@@ -202,8 +198,7 @@ bool Evaluate::operator()(const ProductExp& p) {
     CHECK(!r->resolved);
     ops_->emplace_back(absl::make_unique<OpDiv>(r, n, l));
     n->equ_processed = true;
-    r->resolved = true;
-    progress_ = true;
+    Resolve(r);
     return true;
   }
 
@@ -211,8 +206,7 @@ bool Evaluate::operator()(const ProductExp& p) {
     CHECK(!l->resolved);
     ops_->emplace_back(absl::make_unique<OpDiv>(l, n, r));
     n->equ_processed = true;
-    l->resolved = true;
-    progress_ = true;
+    Resolve(l);
     return true;
   }
 
@@ -235,8 +229,7 @@ bool Evaluate::operator()(const QuotientExp& q) {
         ops_->emplace_back(absl::make_unique<OpCheck>(out_idx_++, n, anon));
         n->equ_processed = true;
         anon->equ_processed = true;
-        anon->resolved = true;
-        progress_ = true;
+        Resolve(anon);
       } else {
         SYM_ERROR(q) << "Conflicting result";
         error_ = true;
@@ -250,8 +243,7 @@ bool Evaluate::operator()(const QuotientExp& q) {
     CHECK(!n->resolved);
     ops_->emplace_back(absl::make_unique<OpDiv>(n, l, r));
     n->equ_processed = true;
-    n->resolved = true;
-    progress_ = true;
+    Resolve(n);
     return true;
   }
 
@@ -259,8 +251,7 @@ bool Evaluate::operator()(const QuotientExp& q) {
     CHECK(!l->resolved);
     ops_->emplace_back(absl::make_unique<OpMul>(l, n, r));
     n->equ_processed = true;
-    l->resolved = true;
-    progress_ = true;
+    Resolve(l);
     return true;
   }
 
@@ -268,8 +259,7 @@ bool Evaluate::operator()(const QuotientExp& q) {
     CHECK(!r->resolved);
     ops_->emplace_back(absl::make_unique<OpDiv>(r, l, n));
     n->equ_processed = true;
-    r->resolved = true;
-    progress_ = true;
+    Resolve(r);
     return true;
   }
 
@@ -292,8 +282,7 @@ bool Evaluate::operator()(const SumExp& s) {
         ops_->emplace_back(absl::make_unique<OpCheck>(out_idx_++, n, anon));
         n->equ_processed = true;
         anon->equ_processed = true;
-        anon->resolved = true;
-        progress_ = true;
+        Resolve(anon);
       } else {
         SYM_ERROR(s) << "Conflicting result";
         error_ = true;
@@ -307,8 +296,7 @@ bool Evaluate::operator()(const SumExp& s) {
     CHECK(!n->resolved);
     ops_->emplace_back(absl::make_unique<OpAdd>(n, l, r));
     n->equ_processed = true;
-    n->resolved = true;
-    progress_ = true;
+    Resolve(n);
     return true;
   }
 
@@ -316,8 +304,7 @@ bool Evaluate::operator()(const SumExp& s) {
     CHECK(!r->resolved);
     ops_->emplace_back(absl::make_unique<OpSub>(r, n, l));
     n->equ_processed = true;
-    r->resolved = true;
-    progress_ = true;
+    Resolve(r);
     return true;
   }
 
@@ -325,8 +312,7 @@ bool Evaluate::operator()(const SumExp& s) {
     CHECK(!l->resolved);
     ops_->emplace_back(absl::make_unique<OpSub>(l, n, r));
     n->equ_processed = true;
-    l->resolved = true;
-    progress_ = true;
+    Resolve(l);
     return true;
   }
 
@@ -349,8 +335,7 @@ bool Evaluate::operator()(const DifExp& d) {
         ops_->emplace_back(absl::make_unique<OpCheck>(out_idx_++, n, anon));
         n->equ_processed = true;
         anon->equ_processed = true;
-        anon->resolved = true;
-        progress_ = true;
+        Resolve(anon);
       } else {
         SYM_ERROR(d) << "Conflicting result";
         error_ = true;
@@ -364,8 +349,7 @@ bool Evaluate::operator()(const DifExp& d) {
     CHECK(!n->resolved);
     ops_->emplace_back(absl::make_unique<OpSub>(n, l, r));
     n->equ_processed = true;
-    n->resolved = true;
-    progress_ = true;
+    Resolve(n);
     return true;
   }
 
@@ -373,8 +357,7 @@ bool Evaluate::operator()(const DifExp& d) {
     CHECK(!r->resolved);
     ops_->emplace_back(absl::make_unique<OpSub>(r, l, n));
     n->equ_processed = true;
-    r->resolved = true;
-    progress_ = true;
+    Resolve(r);
     return true;
   }
 
@@ -382,8 +365,7 @@ bool Evaluate::operator()(const DifExp& d) {
     CHECK(!l->resolved);
     ops_->emplace_back(absl::make_unique<OpAdd>(l, r, n));
     n->equ_processed = true;
-    l->resolved = true;
-    progress_ = true;
+    Resolve(l);
     return true;
   }
 
@@ -404,8 +386,7 @@ bool Evaluate::operator()(const NegativeExp& n) {
         ops_->emplace_back(absl::make_unique<OpCheck>(out_idx_++, exp, anon));
         exp->equ_processed = true;
         anon->equ_processed = true;
-        anon->resolved = true;
-        progress_ = true;
+        Resolve(anon);
       } else {
         SYM_ERROR(n) << "Conflicting result";
         error_ = true;
@@ -419,8 +400,7 @@ bool Evaluate::operator()(const NegativeExp& n) {
     CHECK(!exp->resolved);
     ops_->emplace_back(absl::make_unique<OpNeg>(exp, b));
     exp->equ_processed = true;
-    exp->resolved = true;
-    progress_ = true;
+    Resolve(exp);
     return true;
   }
 
@@ -428,8 +408,7 @@ bool Evaluate::operator()(const NegativeExp& n) {
     CHECK(!b->resolved);
     ops_->emplace_back(absl::make_unique<OpNeg>(b, exp));
     exp->equ_processed = true;
-    b->resolved = true;
-    progress_ = true;
+    Resolve(b);
     return true;
   }
 
@@ -440,149 +419,416 @@ bool Evaluate::operator()(const Define& d) {
   auto node = doc_->TryGetNamedNode(d.name());
   CHECK(node != nullptr) << d.location();
   CHECK(!node->resolved) << d.location();
-  CHECK(node->unit.has_value()) << d.location();
+  CHECK(node->meta->unit != nullptr) << d.location();
 
-  node->value = d.value() * node->unit->scale;
+  node->value = d.value() * node->meta->unit->scale;
   node->equ_processed = true;
-  node->resolved = true;
-  progress_ = true;
+  Resolve(node);
 
   return true;
 }
 
+void Evaluate::Resolve(SemanticDocument::Exp* e) {
+  e->resolved = true;
+  resolved_.push_back(e);
+  solved_.push_back(e);
+}
+
+void Evaluate::NodeSet::Clear() {
+  for (int r : members_) in_[r] = false;
+  members_.clear();
+  size_ = 0;
+}
+
+const std::vector<int>& Evaluate::NodeSet::Ranks() {
+  members_.erase(std::remove_if(members_.begin(), members_.end(),
+                                [this](int r) { return !in_[r]; }),
+                 members_.end());
+  std::sort(members_.begin(), members_.end());
+  members_.erase(std::unique(members_.begin(), members_.end()),
+                 members_.end());
+  return members_;
+}
+
+void Evaluate::RankNodes(const Document& doc) {
+  Find<ExpressionNode> find;
+  (void)doc.VisitNode(&find);
+  order_ = std::move(find.nodes());
+  for (auto* exp : doc_->nodes()) {
+    if (exp && exp->meta->node) order_.push_back(exp->meta->node);
+  }
+  std::sort(order_.begin(), order_.end(), StableNodeCompare{});
+  order_.erase(std::unique(order_.begin(), order_.end()), order_.end());
+
+  in_pass_.assign(order_.size(), false);
+  in_next_.assign(order_.size(), false);
+
+  rank_.clear();
+  for (size_t r = 0; r < order_.size(); r++) {
+    const size_t id = order_[r]->id();
+    if (id >= rank_.size()) rank_.resize(id + 1, -1);
+    rank_[id] = r;
+  }
+}
+
 bool Evaluate::DirectEvaluateNodes(
-    std::set<const ExpressionNode*, StableNodeCompare>* nodes) {
-  // For every pass where progress is made, at least one node is
-  // removed from nodes so watching that bounds the number of passes.
+    NodeSet* nodes, const std::vector<const SemanticDocument::Exp*>* changed) {
+  // The first pass visits every node (or, if the rest are known to be
+  // stuck, the users of what changed). After that, a node can only make
+  // progress if something it references was resolved since it was last
+  // visited, so only the users of newly resolved values get queued.
+  // Users that sort after the current node are visited later in the same
+  // pass and the rest in the next one, which gives the same order (and so
+  // the same ops) as re-scanning every node on every pass.
+  using Queue = std::priority_queue<int, std::vector<int>, std::greater<int>>;
+  Queue pass, next;
+  // Every flag is cleared again as its node is taken from a queue, so the
+  // flags are all false between calls.
+  auto& in_pass = in_pass_;
+  auto& in_next = in_next_;
+  if (changed == nullptr) {
+    const auto& ranks = nodes->Ranks();
+    pass = Queue{std::greater<int>(), ranks};
+    for (int r : ranks) in_pass[r] = true;
+  } else {
+    for (const auto* e : *changed) {
+      for (const auto* u : e->meta->users) {
+        const int u_r = Rank(u);
+        if (u_r < 0 || !nodes->Contains(u_r) || in_pass[u_r]) continue;
+        in_pass[u_r] = true;
+        pass.push(u_r);
+      }
+    }
+  }
+
   bool made_progress = false;
-  progress_ = true;
-  for (int p = 0; (progress_ && !nodes->empty()); p++) {
-    LOG(INFO) << "Pass " << p << ", " << nodes->size() << " nodes un-resolved";
-    progress_ = false;
-    for (auto it = nodes->begin(); it != nodes->end();) {
-      if ((*it)->VisitNode(this)) {
-        it = nodes->erase(it);
-        progress_ = true;
+  resolved_.clear();
+  int p = 0;
+  for (; !pass.empty(); p++) {
+    for (; !pass.empty(); pass.pop()) {
+      const int r = pass.top();
+      in_pass[r] = false;
+      const ExpressionNode* n = order_[r];
+      if (n->VisitNode(this)) {
+        nodes->Erase(r);
         made_progress = true;
-      } else {
-        ++it;
       }
+      for (const auto* e : resolved_) {
+        for (const auto* u : e->meta->users) {
+          const int u_r = Rank(u);
+          if (u_r < 0 || !nodes->Contains(u_r)) continue;
+          if (u_r > r) {
+            if (!in_pass[u_r]) pass.push(u_r);
+            in_pass[u_r] = true;
+          } else {
+            if (!in_next[u_r]) next.push(u_r);
+            in_next[u_r] = true;
+          }
+        }
+      }
+      resolved_.clear();
     }
+    std::swap(pass, next);
+    std::swap(in_pass, in_next);
   }
-  LOG(INFO) << nodes->size() << " nodes not resolved";
+  LOG(INFO) << p << " passes, " << nodes->size() << " nodes not resolved";
   return made_progress;
 }
 
 bool Evaluate::operator()(const Document& doc) {
   // Collect the set of expressions.
-  std::set<const ExpressionNode*, StableNodeCompare> nodes;
+  RankNodes(doc);
+  NodeSet nodes(order_.size());
+  block_ = NodeSet(order_.size());
   for (auto* exp : doc_->nodes()) {
-    if (exp && exp->node) nodes.insert(exp->node);
+    if (exp && exp->meta->node) nodes.Insert(Rank(exp->meta->node));
   }
 
   // Processes all values on defines first.
   for (auto d : doc.defines()) {
     CHECK(d->VisitNode(this)) << d;
-    CHECK(nodes.erase(static_cast<const ExpressionNode*>(d)) == 1) << d;
+    const int r = Rank(d);
+    CHECK(r >= 0 && nodes.Contains(r)) << d;
+    nodes.Erase(r);
   }
 
   if (error_) return false;
 
   // The sequence of ops that solve for all the direct solutions.
   stages_.emplace_back();
-  auto& stage = stages_.back();
-  ops_ = &stage.direct_ops;
-
-  {
-    // Find all the literals.
-    Find<LiteralValue> literal;
-    for (auto const* e : nodes) {
-      (void)e->VisitNode(&literal);
-    }
-    std::set<const ExpressionNode*, StableNodeCompare> l = {
-        literal.nodes().begin(), literal.nodes().end()};
+  ops_ = &stages_.back().direct_ops;
 
-    // Process and remove them first becasue they will always
-    // process and it makes the error message better.
-    for (const auto* n : l) nodes.erase(n);
-    DirectEvaluateNodes(&l);
-    CHECK(l.empty());
+  // Find all the literals.
+  Find<LiteralValue> literal;
+  for (int r : nodes.Ranks()) {
+    (void)order_[r]->VisitNode(&literal);
   }
+  NodeSet l(order_.size());
+  for (const auto* n : literal.nodes()) l.Insert(Rank(n));
+
+  // Process and remove them first becasue they will always
+  // process and it makes the error message better.
+  for (int r : l.Ranks()) nodes.Erase(r);
+  DirectEvaluateNodes(&l);
+  CHECK(l.empty());
+
   allow_conflict_ = false;
   DirectEvaluateNodes(&nodes);
-
   if (error_) return false;
 
-  if (!nodes.empty()) {
-    LOG(INFO) << "Finding solvable systems";
+  // Solve each block of coupled equations in a stage of its own, after
+  // the ones it depends on, and directly solve whatever that pins down as
+  // the start of the next stage.
+  std::vector<std::vector<Equality*>> blocks;
+  if (!nodes.empty()) blocks = OrderBlocks(doc);
+  for (const auto& block : blocks) {
+    if (nodes.empty()) break;
+    if (!SolveBlock(block, &nodes, &stages_.back())) continue;
+    if (!nodes.empty() && !NextStage(&nodes)) return false;
+  }
+
+  // Whatever the decomposition missed gets searched for the hard way.
+  while (!nodes.empty() &&
+         SolveBlock(doc.equality(), &nodes, &stages_.back())) {
+    if (!nodes.empty() && !NextStage(&nodes)) return false;
+  }
+
+  for (auto& stage : stages_) {
+    stage.plan = Plan(stage.direct_ops, stage.solve_ops);
+  }
+
+  // Compute the values and keep them in the document as well.
+  frame_ = Frame{doc_->Values()};
+  Run(&frame_);
+  doc_->SetValues(frame_.values);
+  LOG(INFO) << "==== DONE ====";
+
+  // Whatever a failed solve left behind isn't an answer.
+  for (size_t i = 0; i < stages_.size(); i++) {
+    const auto& stage = stages_[i];
+    if (stage.solve_ops.empty() || frame_.stats[i].converged) continue;
+    SYM_ERROR(stage.solve_ops.front()->location())
+        << "Failed to solve the system of " << stage.count
+        << " equations starting here: " << frame_.stats[i];
+    error_ = true;
+  }
+
+  return !error_;
+}
+
+bool Evaluate::NextStage(NodeSet* nodes) {
+  stages_.emplace_back();
+  ops_ = &stages_.back().direct_ops;
+  allow_conflict_ = false;
+  DirectEvaluateNodes(nodes, &solved_);
+  return !error_;
+}
+
+std::vector<std::vector<Equality*>> Evaluate::OrderBlocks(
+    const Document& doc) {
+  LOG(INFO) << "Decomposing unsolved systems";
 
+  std::map<const ExpressionNode*, std::set<std::string>, StableNodeCompare>
+      all;
+  std::map<const ExpressionNode*, Equality*> root_equality;
+  for (auto* e : doc.equality()) {
     FindUnsolvedRoots roots{doc_};
-    for (const auto* e : doc.equality()) (void)e->VisitNode(&roots);
-    const auto& all = roots.Unsolved();
-    LOG(INFO) << "Found " << all.size() << " unresolved components.";
-
-    // Select a small system to solve.
-    std::set<ExpressionNode const*, StableNodeCompare> exp_result;
-    std::set<std::string> var_result;
-    if(!FindSolution(all, &exp_result, &var_result)) {
-       LOG(WARNING) << "Failed to select solvable set";
-    } else {
-      // Find the involved expressions
-      Find<ExpressionNode> find;
-      for (auto const* e : exp_result) (void)e->VisitNode(&find);
-
-      // Collect the unresolved into exp_result.
-      std::vector<ExpressionNode const*> exp_bits_v =
-          find.NodesWhere([this, exp_result](const ExpressionNode* n) {
-            return !doc_->TryGetNode(n)->resolved;
-          });
-      exp_result.insert(exp_bits_v.begin(), exp_bits_v.end());
-
-      ops_ = &stage.solve_ops;  // Switch the output
-      allow_conflict_ = true;   // Emit OpCheck
-      in_idx_ = out_idx_ = 0;   // Starting in and out at zero
-      while (!var_result.empty()) {
-        // Pick a variable.
-        auto pick = var_result.begin();
-        auto node = doc_->TryGetNamedNode(*pick);
-        var_result.erase(pick);
-        if (node->equ_processed) continue;
-
-        // "Resolve" the picked var.
-        node->resolved = true;
-        node->equ_processed = true;
-        ops_->emplace_back(absl::make_unique<OpLoad>(node, in_idx_++));
-
-        // Figure out what else that pins.
-        DirectEvaluateNodes(&exp_result);
-      }
-      CHECK(in_idx_ == out_idx_) << in_idx_ << "!=" << out_idx_;
-      stage.count = in_idx_;
+    (void)e->VisitNode(&roots);
+    for (const auto& r : roots.Unsolved()) {
+      all.insert(r);
+      root_equality.emplace(r.first, e);
     }
   }
+  LOG(INFO) << "Found " << all.size() << " unresolved components.";
+
+  std::vector<std::set<const ExpressionNode*, StableNodeCompare>> roots;
+  std::vector<std::set<std::string>> vars;
+  std::vector<std::vector<Equality*>> ret;
+  if (!tbd::OrderBlocks(all, &roots, &vars)) return ret;
+
+  ret.resize(roots.size());
+  for (size_t i = 0; i < roots.size(); i++) {
+    for (const auto* r : roots[i]) ret[i].push_back(root_equality.at(r));
+  }
+  return ret;
+}
+
+bool Evaluate::SolveBlock(absl::Span<Equality* const> equalities,
+                          NodeSet* nodes, Stage* stage) {
+  LOG(INFO) << "Finding solvable systems";
+
+  FindUnsolvedRoots roots{doc_};
+  for (const auto* e : equalities) (void)e->VisitNode(&roots);
+  const auto& all = roots.Unsolved();
+  LOG(INFO) << "Found " << all.size() << " unresolved components.";
+  if (all.empty()) return false;
+
+  // Select a small system to solve.
+  std::set<ExpressionNode const*, StableNodeCompare> selected;
+  std::set<std::string> var_result;
+  if (!FindBlock(all, &selected, &var_result) &&
+      !FindSolution(all, &selected, &var_result)) {
+    LOG(WARNING) << "Failed to select solvable set";
+    return false;
+  }
+  solved_.clear();
+
+  // Find the involved expressions
+  Find<ExpressionNode> find;
+  for (auto const* e : selected) (void)e->VisitNode(&find);
+
+  // Collect the unresolved into exp_result.
+  NodeSet& exp_result = block_;
+  for (const auto* e : selected) exp_result.Insert(Rank(e));
+  for (const auto* n : find.NodesWhere([this](const ExpressionNode* n) {
+         return !doc_->TryGetNode(n)->resolved;
+       })) {
+    exp_result.Insert(Rank(n));
+  }
+  const std::vector<int> involved = exp_result.Ranks();
+
+  ops_ = &stage->solve_ops;  // Switch the output
+  allow_conflict_ = true;    // Emit OpCheck
+  in_idx_ = out_idx_ = 0;    // Starting in and out at zero
+  std::vector<double> start;
+  while (!var_result.empty()) {
+    // Pick a variable.
+    auto pick = var_result.begin();
+    auto node = doc_->TryGetNamedNode(*pick);
+    var_result.erase(pick);
+    if (node->equ_processed) continue;
+
+    // "Resolve" the picked var.
+    Resolve(node);
+    node->equ_processed = true;
+    ops_->emplace_back(absl::make_unique<OpLoad>(node, in_idx_++));
+    start.push_back(node->meta->start);
+
+    // Figure out what else that pins.
+    DirectEvaluateNodes(&exp_result);
+  }
+  CHECK(in_idx_ == out_idx_) << in_idx_ << "!=" << out_idx_;
+  stage->count = in_idx_;
+  stage->start = VXd::Map(start.data(), start.size());
+
+  // What got solved no longer needs to be visited.
+  for (int r : involved) {
+    if (!exp_result.Contains(r)) nodes->Erase(r);
+  }
+  exp_result.Clear();
+  return true;
+}
+
+void Evaluate::Run(Frame* frame) const {
+  frame->stats.resize(stages_.size());
+  frame->solutions.resize(stages_.size());
+  for (size_t i = 0; i < stages_.size(); i++) RunStage(i, frame);
+}
+
+std::vector<double> Evaluate::NewLanes(int rows) const {
+  std::vector<double> lanes(frame_.values.size() * rows);
+  for (size_t i = 0; i < frame_.values.size(); i++) {
+    std::fill_n(lanes.begin() + i * rows, rows, frame_.values[i]);
+  }
+  return lanes;
+}
+
+bool Evaluate::RunBatch(int rows, std::vector<double>* lanes) const {
+  CHECK(lanes->size() == frame_.values.size() * rows)
+      << lanes->size() << "!=" << frame_.values.size() << "*" << rows;
+  for (const auto& stage : stages_) {
+    if (!stage.solve_ops.empty()) return false;
+  }
+
+  for (const auto& stage : stages_) {
+    std::vector<double> slots = stage.plan.ReloadLanes(*lanes, rows);
+    stage.plan.RunBatch(rows, slots.data());
+    stage.plan.StoreLanes(slots, rows, lanes);
+  }
+  return true;
+}
+
+void Evaluate::RunStage(size_t i, Frame* frame) const {
+  const Stage& stage = stages_[i];
+  const Plan& plan = stage.plan;
 
   // Run the evaluation plan.
-  VXd in, out;
-  DirectEvaluate eval(&in, &out);
-  for (const auto& op : stage.direct_ops) (void)op->VisitOp(&eval);
+  std::vector<double> slots = plan.Reload(frame->values);
+  Plan::Run(plan.direct(), slots.data(), nullptr, nullptr);
 
   if (!stage.solve_ops.empty()) {
-    in.resize(stage.count);
-    out.resize(stage.count);
-
-    // Convert a vector of values guesses into a vector or errors.
-    auto fn = [&stage, &in, &out, &eval](const VXd& in_p) {
-      CHECK(stage.count == in_p.size()) << stage.count << "!=" << in_p.size();
-      in = in_p;
-      for (const auto& op : stage.solve_ops) (void)op->VisitOp(&eval);
+    const int count = stage.count;
+    const Plan::Sparsity& sparsity = plan.sparsity();
+    const bool sparse =
+        solver_ == Solver::kNewton && IsSparse(count, sparsity.rows.size());
+    VXd out(count);
+    std::vector<double> tangents(
+        sparse ? sparsity.deps.size() : slots.size() * count, 0.0);
+
+    // Convert a vector of values guesses into a vector or errors and,
+    // when asked for, the exact Jacobian of those errors.
+    auto fn = [count, &plan, &slots, &tangents, &out](const VXd& in,
+                                                      MXd* jac) {
+      CHECK(count == in.size()) << count << "!=" << in.size();
+      if (jac == nullptr) {
+        Plan::Run(plan.solve(), slots.data(), in.data(), out.data());
+      } else {
+        jac->setZero();
+        Plan::RunTangent(plan.solve(), count, slots.data(), tangents.data(),
+                         in.data(), out.data(), jac->data());
+      }
       return out;
     };
 
-    NewtonRaphson(fn, /*dim=*/stage.count, /*count=*/10, /*tol=*/1e-4);
-  }
-  LOG(INFO) << "==== DONE ====";
+    // As above but only computing the parts of the Jacobian that can be
+    // non-zero, which are then assembled from triplets.
+    std::vector<double> values(sparse ? sparsity.rows.size() : 0);
+    std::vector<Eigen::Triplet<double>> triplets;
+    auto sparse_fn = [&](const VXd& in, SMXd* jac) {
+      CHECK(count == in.size()) << count << "!=" << in.size();
+      if (jac == nullptr) {
+        Plan::Run(plan.solve(), slots.data(), in.data(), out.data());
+        return out;
+      }
+      Plan::RunSparseTangent(plan.solve(), sparsity, slots.data(),
+                             tangents.data(), in.data(), out.data(),
+                             values.data());
+      triplets.clear();
+      for (size_t k = 0; k < values.size(); k++) {
+        triplets.emplace_back(sparsity.rows[k], sparsity.cols[k], values[k]);
+      }
+      jac->setFromTriplets(triplets.begin(), triplets.end());
+      return out;
+    };
 
-  return !error_;
+    // Start from the last solution if there is one, or else the hints.
+    VXd& solution = frame->solutions[i];
+    VXd start = solution;
+    if (start.size() != count) start = stage.start;
+
+    SolveStats& stats = frame->stats[i];
+    stats = SolveStats{};
+    switch (solver_) {
+      case Solver::kNewton:
+        if (sparse) {
+          start = NewtonRaphson(SparseJacobianFunction(sparse_fn),
+                                std::move(start), /*count=*/10, /*tol=*/1e-4,
+                                &stats);
+        } else {
+          start = NewtonRaphson(JacobianFunction(fn), std::move(start),
+                                /*count=*/10, /*tol=*/1e-4, &stats);
+        }
+        break;
+      case Solver::kBroyden:
+        // Cycles are cheaper but converge slower so allow more of them.
+        start = Broyden(JacobianFunction(fn), std::move(start), /*count=*/50,
+                        /*tol=*/1e-4, &stats);
+        break;
+    }
+    LOG(INFO) << "Solved for " << count << " values: " << stats;
+    solution = stats.converged ? std::move(start) : VXd{};
+  }
+  plan.Store(slots, &frame->values);
 }
 
 bool FindUnsolvedRoots::Resolved(tbd::ExpressionNode const* e) {
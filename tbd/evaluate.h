@@ -34,8 +34,11 @@
 #include <vector>
 
 #include "absl/log/log.h"
+#include "absl/types/span.h"
 #include "tbd/ast.h"
+#include "tbd/newton_raphson.h"
 #include "tbd/ops.h"
+#include "tbd/plan.h"
 #include "tbd/semantic.h"
 
 namespace tbd {
@@ -45,6 +48,8 @@ class Evaluate final : public VisitNodesWithErrors {
   Evaluate(SemanticDocument* doc, ErrorSink e)
       : VisitNodesWithErrors(e), doc_(doc) {}
 
+  // The parts of the evaluation that don't depend on the values. These
+  // don't change once the document has been evaluated.
   struct Stage {
     // The ops that directly solve for the parts where that works for.
     std::vector<std::unique_ptr<OpI>> direct_ops;
@@ -52,8 +57,46 @@ class Evaluate final : public VisitNodesWithErrors {
     std::vector<std::unique_ptr<OpI>> solve_ops;
     // The number of variables to solve for.
     int count = 0;
+    // Where solving starts (by OpLoad slot) without a prior solution. Zero
+    // unless the variable has a hint.
+    VXd start;
+    // The compiled form of direct_ops and solve_ops.
+    Plan plan;
   };
 
+  // The state of one evaluation: a value for every SemanticDocument::Exp
+  // (by Exp::index) and how solving each stage went. Running a frame only
+  // reads the stages, so any number of frames may be run at the same time.
+  struct Frame {
+    std::vector<double> values;
+    // The work done solving for the variables of each stage.
+    std::vector<SolveStats> stats;
+    // The last solution found for each stage, used as the starting point
+    // for the next.
+    std::vector<VXd> solutions;
+  };
+
+  void set_solver(Solver solver) { solver_ = solver; }
+
+  // A copy of the frame the document was evaluated with. Changing its
+  // values for defined values and running it gives a "what if".
+  Frame NewFrame() const { return frame_; }
+
+  // Re-compute every stage of a frame from the values it has for whatever
+  // they don't compute themselves (e.g. after a defined value has been
+  // changed).
+  void Run(Frame* frame) const;
+
+  // The values of the frame the document was evaluated with, laid out for
+  // running rows evaluations at once: rows copies of the value for
+  // Exp::index i at [i * rows, (i + 1) * rows).
+  std::vector<double> NewLanes(int rows) const;
+
+  // As Run but for rows sets of values at once (see NewLanes). Only the
+  // direct part of a stage can be run this way, so if any stage has a
+  // system to solve, this does nothing and returns false.
+  bool RunBatch(int rows, std::vector<double>* lanes) const;
+
   std::vector<const Stage*> GetStages() const {
     std::vector<const Stage*> ret;
     ret.reserve(stages_.size());
@@ -77,18 +120,88 @@ class Evaluate final : public VisitNodesWithErrors {
 
   bool operator()(const Define&) override;
   bool operator()(const Specification&) override { return false; }
+  bool operator()(const Hint&) override { return false; }
   bool operator()(const Document&) override;
 
+  // A set of expression nodes, identified by their rank (position in
+  // order_). Membership is a flag per rank.
+  class NodeSet {
+   public:
+    explicit NodeSet(size_t ranks) : in_(ranks, false) {}
+
+    void Insert(int r) {
+      if (in_[r]) return;
+      in_[r] = true;
+      members_.push_back(r);
+      size_++;
+    }
+    void Erase(int r) {
+      if (!in_[r]) return;
+      in_[r] = false;
+      size_--;
+    }
+    void Clear();  // Keeps the number of ranks.
+    bool Contains(int r) const { return in_[r]; }
+    bool empty() const { return size_ == 0; }
+    int size() const { return size_; }
+
+    // The members in rank order.
+    const std::vector<int>& Ranks();
+
+   private:
+    std::vector<bool> in_;
+    std::vector<int> members_;  // May have extras that Ranks() removes.
+    int size_ = 0;
+  };
+
+  // Set up order_ and rank_ for every expression in the document.
+  void RankNodes(const Document& doc);
+  int Rank(const ExpressionNode* n) const {
+    const size_t id = n->id();
+    return id < rank_.size() ? rank_[id] : -1;
+  }
+
+  // Directly solve what can be. If the only nodes that might now make
+  // progress are users of `changed`, only they need to be given.
   bool DirectEvaluateNodes(
-      std::set<const ExpressionNode*, StableNodeCompare>* nodes);
+      NodeSet* nodes,
+      const std::vector<const SemanticDocument::Exp*>* changed = nullptr);
+  // Start a new stage with whatever the last one pinned down.
+  bool NextStage(NodeSet* nodes);
+  // Decompose the unsolved equations (once) into the blocks that need to
+  // be solved together, in an order they can be solved in.
+  std::vector<std::vector<Equality*>> OrderBlocks(const Document& doc);
+  // Select the next block of equations (from the given ones) that need to
+  // be solved together and generate the solve_ops for it.
+  bool SolveBlock(absl::Span<Equality* const> equalities, NodeSet* nodes,
+                  Stage* stage);
+  // Compute the values for a stage and store them in a frame.
+  void RunStage(size_t i, Frame* frame) const;
+  // Mark a value as resolved and record it so its users get re-visited.
+  void Resolve(SemanticDocument::Exp* e);
 
   SemanticDocument* doc_;
 
   bool error_ = false;     // Set if an expression evaluation yields an error.
-  bool progress_ = false;  // Set when a expressions value it found.
   bool allow_conflict_ = false;  // Make OpCheck op rather than error on conflit
+  Solver solver_ = Solver::kNewton;
 
   std::vector<Stage> stages_;
+  Frame frame_;  // The result of evaluating the document.
+
+  // The expressions to evaluate in the order to visit them (by location)
+  // and the rank in that of each, by NodeI::id() (or -1).
+  std::vector<const ExpressionNode*> order_;
+  std::vector<int> rank_;
+  // Scratch for DirectEvaluateNodes, by rank.
+  std::vector<bool> in_pass_, in_next_;
+  // Scratch for SolveBlock.
+  NodeSet block_{0};
+
+  // Values resolved by the node currently being visited.
+  std::vector<const SemanticDocument::Exp*> resolved_;
+  // Values resolved since the last block was selected.
+  std::vector<const SemanticDocument::Exp*> solved_;
 
   // The count of set vars and checked equarions
   // handled so far. Used to assign indexes to them.
@@ -122,6 +235,7 @@ class FindUnsolvedRoots final : public VisitNodes {
 
   bool operator()(const Define&) override { return false; }
   bool operator()(const Specification&) override { return false; }
+  bool operator()(const Hint&) override { return false; }
   bool operator()(const Document&) override { return false; }
 
   SemanticDocument* doc_;
@@ -27,8 +27,17 @@
 
 #include "tbd/evaluate.h"
 
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "tbd/resolve_units.h"
+#include "tbd/validate.h"
 
 namespace tbd {
 
@@ -43,26 +52,22 @@ TEST(FindUnsolvedRoots, Smoke) {
 }
 
 TEST(FindUnsolvedRoots, Try) {
-  auto ua = absl::make_unique<NamedValue>(Loc{}, "a");
-  auto ub = absl::make_unique<NamedValue>(Loc{}, "b");
-  auto a = ua.get();
-  auto b = ub.get();
-
-  auto us = absl::make_unique<SumExp>(std::move(ua), std::move(ub));
-  auto ul = absl::make_unique<LiteralValue>(Loc{}, 2);
-  auto s = us.get();
-  auto l = ul.get();
-  Equality e{Loc{}, std::move(us), std::move(ul)};
+  Document ast;
+  auto a = ast.New<NamedValue>(Loc{}, "a");
+  auto b = ast.New<NamedValue>(Loc{}, "b");
+  auto s = ast.New<SumExp>(a, b);
+  auto l = ast.New<LiteralValue>(Loc{}, 2);
+  auto e = ast.New<Equality>(Loc{}, s, l);
 
   SemanticDocument doc;
   doc.RefernceNamedNode(a);
   doc.RefernceNamedNode(b);
   doc.GetUnnamedNode(s);
   doc.GetUnnamedNode(l)->equ_processed = true;
-  doc.GetUnnamedNode(&e)->equ_processed = true;
+  doc.GetUnnamedNode(e)->equ_processed = true;
 
   FindUnsolvedRoots roots{&doc};
-  (void)e.VisitNode(&roots);
+  (void)e->VisitNode(&roots);
 
   const auto& all = roots.Unsolved();
   ASSERT_EQ(all.size(), 1);
@@ -72,4 +77,345 @@ TEST(FindUnsolvedRoots, Try) {
   EXPECT_EQ(it.second.size(), 2);
 }
 
+TEST(Evaluate, Chain) {
+  // x0 := 1; x1 = x0 + 1; ... with the equations listed in reverse order
+  // so each one only becomes solvable after the one listed after it.
+  constexpr int kLen = 50;
+  Document doc;
+  doc.AddDefinition(doc.New<Define>(Loc{}, "x0", 1));
+  for (int i = kLen - 1; i > 0; i--) {
+    auto sum = doc.New<SumExp>(
+        doc.New<NamedValue>(Loc{}, absl::StrCat("x", i - 1)),
+        doc.New<LiteralValue>(Loc{}, 1));
+    doc.AddEquality(doc.New<Equality>(
+        Loc{}, doc.New<NamedValue>(Loc{}, absl::StrCat("x", i)), sum));
+  }
+
+  SemanticDocument sem;
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, Evaluate::DefaultSink).as_ptr()));
+  ASSERT_TRUE(
+      doc.VisitNode(ResolveUnits(&sem, Evaluate::DefaultSink).as_ptr()));
+  Evaluate eval{&sem, Evaluate::DefaultSink};
+  ASSERT_TRUE(doc.VisitNode(&eval));
+
+  for (int i = 0; i < kLen; i++) {
+    auto* n = sem.TryGetNamedNode(absl::StrCat("x", i));
+    ASSERT_NE(n, nullptr) << i;
+    EXPECT_TRUE(n->resolved) << i;
+    EXPECT_EQ(n->value, i + 1) << i;
+  }
+
+  auto stages = eval.GetStages();
+  ASSERT_EQ(stages.size(), 1);
+  EXPECT_TRUE(stages[0]->solve_ops.empty());
+}
+
+TEST(Evaluate, Blocks) {
+  // x0 := 1; a{i} + b{i} = x{i-1}; a{i} - b{i} = 1; x{i} = a{i} + 1;
+  // A chain of coupled pairs, each depending on the one before it.
+  constexpr int kLen = 20;
+  Document doc;
+  auto n = [&doc](const std::string& name) {
+    return doc.New<NamedValue>(Loc{}, name);
+  };
+  auto l = [&doc](double v) { return doc.New<LiteralValue>(Loc{}, v); };
+  auto eq = [&doc](ExpressionNode* a, ExpressionNode* b) {
+    doc.AddEquality(doc.New<Equality>(Loc{}, a, b));
+  };
+  doc.AddDefinition(doc.New<Define>(Loc{}, "x0", 1));
+  for (int i = 1; i <= kLen; i++) {
+    const std::string a = absl::StrCat("a", i), b = absl::StrCat("b", i);
+    eq(doc.New<SumExp>(n(a), n(b)), n(absl::StrCat("x", i - 1)));
+    eq(doc.New<DifExp>(n(a), n(b)), l(1));
+    eq(n(absl::StrCat("x", i)), doc.New<SumExp>(n(a), l(1)));
+  }
+
+  SemanticDocument sem;
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, Evaluate::DefaultSink).as_ptr()));
+  ASSERT_TRUE(
+      doc.VisitNode(ResolveUnits(&sem, Evaluate::DefaultSink).as_ptr()));
+  Evaluate eval{&sem, Evaluate::DefaultSink};
+  ASSERT_TRUE(doc.VisitNode(&eval));
+
+  // A stage for each pair and one more to finish the last off.
+  auto stages = eval.GetStages();
+  ASSERT_EQ(stages.size(), kLen + 1);
+  for (int i = 0; i < kLen; i++) EXPECT_EQ(stages[i]->count, 1) << i;
+  EXPECT_TRUE(stages[kLen]->solve_ops.empty());
+
+  double x = 1;
+  for (int i = 1; i <= kLen; i++) {
+    x = (x + 3) / 2;
+    auto* v = sem.TryGetNamedNode(absl::StrCat("x", i));
+    ASSERT_NE(v, nullptr) << i;
+    EXPECT_TRUE(v->resolved) << i;
+    EXPECT_NEAR(v->value, x, 1e-6) << i;
+  }
+}
+
+TEST(Evaluate, Hint) {
+  // a := 4; x * x = a; x ~= -3;
+  Document doc;
+  doc.AddDefinition(doc.New<Define>(Loc{}, "a", 4));
+  doc.AddEquality(doc.New<Equality>(
+      Loc{},
+      doc.New<ProductExp>(doc.New<NamedValue>(Loc{}, "x"),
+                          doc.New<NamedValue>(Loc{}, "x")),
+      doc.New<NamedValue>(Loc{}, "a")));
+  doc.AddHint(doc.New<Hint>(Loc{}, "x", doc.New<LiteralValue>(Loc{}, -3.0),
+                            doc.New<UnitExp>(Loc{})));
+
+  SemanticDocument sem;
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, Evaluate::DefaultSink).as_ptr()));
+  ASSERT_TRUE(
+      doc.VisitNode(ResolveUnits(&sem, Evaluate::DefaultSink).as_ptr()));
+  Evaluate eval{&sem, Evaluate::DefaultSink};
+  ASSERT_TRUE(doc.VisitNode(&eval));
+
+  // Starting from zero would find the other root.
+  auto stages = eval.GetStages();
+  ASSERT_EQ(stages.size(), 1);
+  ASSERT_EQ(stages[0]->start.size(), 1);
+  EXPECT_EQ(stages[0]->start[0], -3);
+  EXPECT_NEAR(sem.TryGetNamedNode("x")->value, -2, 1e-4);
+}
+
+TEST(Evaluate, NoSolution) {
+  // a := -4; x * x = a;
+  Document doc;
+  doc.AddDefinition(doc.New<Define>(Loc{}, "a", -4));
+  doc.AddEquality(doc.New<Equality>(
+      Loc{},
+      doc.New<ProductExp>(doc.New<NamedValue>(Loc{}, "x"),
+                          doc.New<NamedValue>(Loc{}, "x")),
+      doc.New<NamedValue>(Loc{}, "a")));
+
+  SemanticDocument sem;
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, Evaluate::DefaultSink).as_ptr()));
+  ASSERT_TRUE(
+      doc.VisitNode(ResolveUnits(&sem, Evaluate::DefaultSink).as_ptr()));
+
+  std::vector<std::string> errors;
+  Evaluate eval{&sem, [&errors](const std::string& e) { errors.push_back(e); }};
+  EXPECT_FALSE(doc.VisitNode(&eval));
+  EXPECT_THAT(errors, testing::ElementsAre(testing::HasSubstr(
+                          "Failed to solve the system of 1 equations")));
+}
+
+TEST(Evaluate, Tearing) {
+  Document doc;
+  auto n = [&doc](const char* name) {
+    return doc.New<NamedValue>(Loc{}, name);
+  };
+  auto l = [&doc](double v) { return doc.New<LiteralValue>(Loc{}, v); };
+  auto eq = [&doc](ExpressionNode* a, ExpressionNode* b) {
+    doc.AddEquality(doc.New<Equality>(Loc{}, a, b));
+  };
+
+  // a + b + c = 6; a + b * 2 + c = 8; a + b + c * 3 = 12;
+  // Three equations that all use all three variables need two guesses.
+  eq(doc.New<SumExp>(doc.New<SumExp>(n("a"), n("b")), n("c")), l(6));
+  eq(doc.New<SumExp>(
+         doc.New<SumExp>(n("a"), doc.New<ProductExp>(n("b"), l(2))), n("c")),
+     l(8));
+  eq(doc.New<SumExp>(doc.New<SumExp>(n("a"), n("b")),
+                     doc.New<ProductExp>(n("c"), l(3))),
+     l(12));
+
+  // w = x + 1; x = y * 2; y = z - 1; z = w + 3;
+  // A larger ring of equations that only needs one guess.
+  eq(n("w"), doc.New<SumExp>(n("x"), l(1)));
+  eq(n("x"), doc.New<ProductExp>(n("y"), l(2)));
+  eq(n("y"), doc.New<DifExp>(n("z"), l(1)));
+  eq(n("z"), doc.New<SumExp>(n("w"), l(3)));
+
+  SemanticDocument sem;
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, Evaluate::DefaultSink).as_ptr()));
+  ASSERT_TRUE(
+      doc.VisitNode(ResolveUnits(&sem, Evaluate::DefaultSink).as_ptr()));
+  Evaluate eval{&sem, Evaluate::DefaultSink};
+  ASSERT_TRUE(doc.VisitNode(&eval));
+
+  // The ring needs fewer guesses so it goes first, despite being larger.
+  auto stages = eval.GetStages();
+  ASSERT_EQ(stages.size(), 2);
+  EXPECT_EQ(stages[0]->count, 1);
+  EXPECT_EQ(stages[1]->count, 2);
+
+  const std::pair<const char*, double> expected[] = {
+      {"a", 1}, {"b", 2}, {"c", 3}, {"w", -5}, {"x", -6}, {"y", -3}, {"z", -2}};
+  for (const auto& e : expected) {
+    auto* v = sem.TryGetNamedNode(e.first);
+    ASSERT_NE(v, nullptr) << e.first;
+    EXPECT_TRUE(v->resolved) << e.first;
+    EXPECT_NEAR(v->value, e.second, 1e-6) << e.first;
+  }
+}
+
+TEST(Evaluate, Sparse) {
+  // x{i} * x{i} + x{i+1} * x{i+1} + x{i} = 3; around a ring. Nothing can be
+  // directly solved for from the others so every value is guessed, but each
+  // equation only uses two of them.
+  constexpr int kLen = 40;
+  Document doc;
+  auto n = [&doc](int i) {
+    return doc.New<NamedValue>(Loc{}, absl::StrCat("x", i % kLen));
+  };
+  for (int i = 0; i < kLen; i++) {
+    auto* sq = doc.New<SumExp>(doc.New<ProductExp>(n(i), n(i)),
+                               doc.New<ProductExp>(n(i + 1), n(i + 1)));
+    doc.AddEquality(doc.New<Equality>(Loc{}, doc.New<SumExp>(sq, n(i)),
+                                      doc.New<LiteralValue>(Loc{}, 3)));
+  }
+
+  SemanticDocument sem;
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, Evaluate::DefaultSink).as_ptr()));
+  ASSERT_TRUE(
+      doc.VisitNode(ResolveUnits(&sem, Evaluate::DefaultSink).as_ptr()));
+  Evaluate eval{&sem, Evaluate::DefaultSink};
+  ASSERT_TRUE(doc.VisitNode(&eval));
+
+  auto stages = eval.GetStages();
+  ASSERT_EQ(stages.size(), 1);
+  ASSERT_EQ(stages[0]->count, kLen);
+  EXPECT_EQ(stages[0]->plan.sparsity().rows.size(), 2 * kLen);
+  EXPECT_TRUE(IsSparse(kLen, stages[0]->plan.sparsity().rows.size()));
+
+  for (int i = 0; i < kLen; i++) {
+    auto* v = sem.TryGetNamedNode(absl::StrCat("x", i));
+    ASSERT_NE(v, nullptr) << i;
+    EXPECT_NEAR(v->value, 1, 1e-4) << i;
+  }
+}
+
+TEST(Evaluate, RunFrame) {
+  // s := 3; a + b = s; a - b = 1;
+  Document doc;
+  doc.AddDefinition(doc.New<Define>(Loc{}, "s", 3));
+  doc.AddEquality(doc.New<Equality>(
+      Loc{},
+      doc.New<SumExp>(doc.New<NamedValue>(Loc{}, "a"),
+                      doc.New<NamedValue>(Loc{}, "b")),
+      doc.New<NamedValue>(Loc{}, "s")));
+  doc.AddEquality(doc.New<Equality>(
+      Loc{},
+      doc.New<DifExp>(doc.New<NamedValue>(Loc{}, "a"),
+                      doc.New<NamedValue>(Loc{}, "b")),
+      doc.New<LiteralValue>(Loc{}, 1)));
+
+  SemanticDocument sem;
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, Evaluate::DefaultSink).as_ptr()));
+  ASSERT_TRUE(
+      doc.VisitNode(ResolveUnits(&sem, Evaluate::DefaultSink).as_ptr()));
+  Evaluate eval{&sem, Evaluate::DefaultSink};
+  ASSERT_TRUE(doc.VisitNode(&eval));
+
+  auto* s = sem.TryGetNamedNode("s");
+  auto* a = sem.TryGetNamedNode("a");
+  auto* b = sem.TryGetNamedNode("b");
+  EXPECT_NEAR(a->value, 2, 1e-6);
+  EXPECT_NEAR(b->value, 1, 1e-6);
+
+  // Change the input in a frame and re-use the existing stages.
+  auto stages = eval.GetStages();
+  ASSERT_EQ(stages.size(), 1);
+  Evaluate::Frame frame = eval.NewFrame();
+  ASSERT_EQ(frame.solutions.size(), 1);
+  ASSERT_EQ(frame.solutions[0].size(), stages[0]->count);
+
+  frame.values[s->index] = 11;
+  eval.Run(&frame);
+  EXPECT_EQ(eval.GetStages().size(), 1);
+  EXPECT_NEAR(frame.values[a->index], 6, 1e-6);
+  EXPECT_NEAR(frame.values[b->index], 5, 1e-6);
+  EXPECT_TRUE(frame.stats[0].converged);
+
+  // Frames are independent of each other and of the document.
+  Evaluate::Frame other = eval.NewFrame();
+  other.values[s->index] = 7;
+  eval.Run(&other);
+  EXPECT_NEAR(other.values[a->index], 4, 1e-6);
+  EXPECT_NEAR(frame.values[a->index], 6, 1e-6);
+  EXPECT_NEAR(a->value, 2, 1e-6);
+  EXPECT_NEAR(b->value, 1, 1e-6);
+
+  // Any number of frames can be run at the same time.
+  std::vector<Evaluate::Frame> frames(8, eval.NewFrame());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < frames.size(); i++) {
+    frames[i].values[s->index] = 2 * i + 1;
+    threads.emplace_back([&eval, f = &frames[i]] { eval.Run(f); });
+  }
+  for (auto& t : threads) t.join();
+  for (size_t i = 0; i < frames.size(); i++) {
+    EXPECT_NEAR(frames[i].values[a->index], i + 1, 1e-6) << i;
+    EXPECT_NEAR(frames[i].values[b->index], i, 1e-6) << i;
+  }
+}
+
+TEST(Evaluate, RunBatch) {
+  // x0 := 1; x1 = x0 + 1; ... x4 = x3 + 1;
+  constexpr int kLen = 5;
+  Document doc;
+  doc.AddDefinition(doc.New<Define>(Loc{}, "x0", 1));
+  for (int i = 1; i < kLen; i++) {
+    auto sum = doc.New<SumExp>(
+        doc.New<NamedValue>(Loc{}, absl::StrCat("x", i - 1)),
+        doc.New<LiteralValue>(Loc{}, 1));
+    doc.AddEquality(doc.New<Equality>(
+        Loc{}, doc.New<NamedValue>(Loc{}, absl::StrCat("x", i)), sum));
+  }
+
+  SemanticDocument sem;
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, Evaluate::DefaultSink).as_ptr()));
+  ASSERT_TRUE(
+      doc.VisitNode(ResolveUnits(&sem, Evaluate::DefaultSink).as_ptr()));
+  Evaluate eval{&sem, Evaluate::DefaultSink};
+  ASSERT_TRUE(doc.VisitNode(&eval));
+
+  constexpr int kRows = 19;
+  std::vector<double> lanes = eval.NewLanes(kRows);
+  const int x0 = sem.TryGetNamedNode("x0")->index;
+  for (int k = 0; k < kRows; k++) lanes[x0 * kRows + k] = 10 * k;
+  ASSERT_TRUE(eval.RunBatch(kRows, &lanes));
+
+  for (int i = 0; i < kLen; i++) {
+    const int x = sem.TryGetNamedNode(absl::StrCat("x", i))->index;
+    for (int k = 0; k < kRows; k++) {
+      EXPECT_EQ(lanes[x * kRows + k], 10 * k + i) << i << " " << k;
+    }
+  }
+  // The document keeps its values.
+  EXPECT_EQ(sem.TryGetNamedNode("x4")->value, 5);
+}
+
+TEST(Evaluate, RunBatchSolve) {
+  // s := 3; a + b = s; a - b = 1;
+  Document doc;
+  doc.AddDefinition(doc.New<Define>(Loc{}, "s", 3));
+  doc.AddEquality(doc.New<Equality>(
+      Loc{},
+      doc.New<SumExp>(doc.New<NamedValue>(Loc{}, "a"),
+                      doc.New<NamedValue>(Loc{}, "b")),
+      doc.New<NamedValue>(Loc{}, "s")));
+  doc.AddEquality(doc.New<Equality>(
+      Loc{},
+      doc.New<DifExp>(doc.New<NamedValue>(Loc{}, "a"),
+                      doc.New<NamedValue>(Loc{}, "b")),
+      doc.New<LiteralValue>(Loc{}, 1)));
+
+  SemanticDocument sem;
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, Evaluate::DefaultSink).as_ptr()));
+  ASSERT_TRUE(
+      doc.VisitNode(ResolveUnits(&sem, Evaluate::DefaultSink).as_ptr()));
+  Evaluate eval{&sem, Evaluate::DefaultSink};
+  ASSERT_TRUE(doc.VisitNode(&eval));
+
+  // A system can't be solved as a batch.
+  std::vector<double> lanes = eval.NewLanes(4);
+  const std::vector<double> before = lanes;
+  EXPECT_FALSE(eval.RunBatch(4, &lanes));
+  EXPECT_EQ(lanes, before);
+}
+
 }  // namespace tbd
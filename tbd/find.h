@@ -111,10 +111,15 @@ class Find final : public VisitNodes {
     Sink(&n);
     return true;
   }
+  bool operator()(const Hint& n) override {
+    Sink(&n);
+    return true;
+  }
   bool operator()(const Document& n) override {
     Sink(&n);
     for (auto d : n.defines()) (void)d->VisitNode(this);
     for (auto d : n.specs()) (void)d->VisitNode(this);
+    for (auto h : n.hints()) (void)h->VisitNode(this);
     for (auto e : n.equality()) (void)e->VisitNode(this);
     return true;
   }
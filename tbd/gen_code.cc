@@ -27,10 +27,24 @@
 
 #include "tbd/gen_code.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
+#include "tbd/evaluate.h"
 #include "tbd/semantic.h"
 
 namespace tbd {
@@ -38,25 +52,25 @@ namespace tbd {
 bool CodeEvaluate::BinaryOp(ExpP r, ExpP a, ExpP b, absl::string_view op) {
   auto it_a = expressions_.find(a);
   if (it_a == expressions_.end()) {
-    if (!a->name.empty()) {
-      it_a = expressions_.emplace(a, a->name).first;
+    if (!a->meta->name.empty()) {
+      it_a = expressions_.emplace(a, CppName(a->meta->name)).first;
     } else if (a->is_literal) {
-      it_a = expressions_.emplace(a, absl::StrCat(a->value)).first;
+      it_a = expressions_.emplace(a, CppNumber(a->value)).first;
     } else {
       LOG(WARNING) << "Unknown source has no name or value: "
-                   << a->node->location();
+                   << a->meta->node->location();
       return false;
     }
   }
   auto it_b = expressions_.find(b);
   if (it_b == expressions_.end()) {
-    if (!b->name.empty()) {
-      it_b = expressions_.emplace(b, b->name).first;
+    if (!b->meta->name.empty()) {
+      it_b = expressions_.emplace(b, CppName(b->meta->name)).first;
     } else if (b->is_literal) {
-      it_b = expressions_.emplace(b, absl::StrCat(b->value)).first;
+      it_b = expressions_.emplace(b, CppNumber(b->value)).first;
     } else {
       LOG(WARNING) << "Unknown source has no name or value: "
-                   << b->node->location();
+                   << b->meta->node->location();
       return false;
     }
   }
@@ -65,11 +79,11 @@ bool CodeEvaluate::BinaryOp(ExpP r, ExpP a, ExpP b, absl::string_view op) {
 }
 
 bool CodeEvaluate::Add(const ExpP e, std::string v) {
-  if (e->name.empty()) {
+  if (e->meta->name.empty()) {
     return expressions_.emplace(e, std::move(v)).second;
   } else {
-    out_ << e->name << " = " << v << ";\n";
-    expressions_.emplace(e, e->name);
+    out_ << indent_ << CppName(e->meta->name) << " = " << v << ";\n";
+    expressions_.emplace(e, CppName(e->meta->name));
     return true;
   }
 }
@@ -93,11 +107,11 @@ bool CodeEvaluate::operator()(const OpDiv& o) {
 bool CodeEvaluate::operator()(const OpNeg& o) {
   auto it = expressions_.find(o.a);
   if (it == expressions_.end()) {
-    if (o.a->name.empty()) {
+    if (o.a->meta->name.empty()) {
       LOG(WARNING) << "Unknown source has no name";
       return false;
     }
-    it = expressions_.emplace(o.a, o.a->name).first;
+    it = expressions_.emplace(o.a, CppName(o.a->meta->name)).first;
   }
 
   return Add(o.r, absl::StrCat("(-", it->second, ")"));
@@ -106,23 +120,24 @@ bool CodeEvaluate::operator()(const OpNeg& o) {
 bool CodeEvaluate::operator()(const OpExp& o) {
   auto it_b = expressions_.find(o.b);
   if (it_b == expressions_.end()) {
-    if (o.b->name.empty()) return false;
-    it_b = expressions_.emplace(o.b, o.b->name).first;
+    if (o.b->meta->name.empty()) return false;
+    it_b = expressions_.emplace(o.b, CppName(o.b->meta->name)).first;
   }
 
-  return Add(o.r, absl::StrCat("std::pow(", it_b->second, ", ", o.e, ")"));
+  return Add(o.r, absl::StrCat("std::pow(", it_b->second, ", ", CppNumber(o.e),
+                               ")"));
 }
 
 bool CodeEvaluate::operator()(const OpAssign& o) {
   auto it = expressions_.find(o.s);
   if (it == expressions_.end()) {
-    if (!o.s->name.empty()) {
-      it = expressions_.emplace(o.s, o.s->name).first;
+    if (!o.s->meta->name.empty()) {
+      it = expressions_.emplace(o.s, CppName(o.s->meta->name)).first;
     } else if (o.s->is_literal) {
-      it = expressions_.emplace(o.s, absl::StrCat(o.s->value)).first;
+      it = expressions_.emplace(o.s, CppNumber(o.s->value)).first;
     } else {
       LOG(WARNING) << "Unknown source has no name or value: "
-                   << o.s->node->location();
+                   << o.s->meta->node->location();
       return false;
     }
   }
@@ -133,10 +148,10 @@ bool CodeEvaluate::operator()(const OpAssign& o) {
 bool CodeEvaluate::operator()(const OpLoad& o) {
   auto it = expressions_.find(o.n);
   CHECK(it == expressions_.end()) << it->second << " is already loaded";
-  CHECK(!o.n->name.empty());
-  CHECK(expressions_.emplace(o.n, o.n->name).second);
+  CHECK(!o.n->meta->name.empty());
+  CHECK(expressions_.emplace(o.n, CppName(o.n->meta->name)).second);
 
-  out_ << o.n->name << " = @src[" << o.i << "];\n";
+  out_ << indent_ << CppName(o.n->meta->name) << " = tbd_src[" << o.i << "];\n";
   return true;
 }
 
@@ -151,8 +166,290 @@ bool CodeEvaluate::operator()(const OpCheck& o) {
     if (it != expressions_.end()) b = it->second;
   }
 
-  out_ << "@des[" << o.i << "] = (" << a << " - " << b << ");\n";
+  out_ << indent_ << "tbd_des[" << o.i << "] = (" << a << " - " << b << ");\n";
   return true;
 }
 
+std::string CppName(absl::string_view name) {
+  static const auto* const kKeywords = new std::set<absl::string_view>{
+      "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor",
+      "bool", "break", "case", "catch", "char", "char16_t", "char32_t",
+      "char8_t", "class", "co_await", "co_return", "co_yield", "compl",
+      "concept", "const", "const_cast", "consteval", "constexpr", "constinit",
+      "continue", "decltype", "default", "delete", "do", "double",
+      "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false",
+      "float", "for", "friend", "goto", "if", "inline", "int", "long",
+      "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr",
+      "operator", "or", "or_eq", "private", "protected", "public", "register",
+      "reinterpret_cast", "requires", "return", "short", "signed", "sizeof",
+      "static", "static_assert", "static_cast", "struct", "switch", "template",
+      "this", "thread_local", "throw", "true", "try", "typedef", "typeid",
+      "typename", "union", "unsigned", "using", "virtual", "void", "volatile",
+      "wchar_t", "while", "xor", "xor_eq",
+  };
+  // Names the generated code declares or uses itself.
+  static const auto* const kReserved = new std::set<absl::string_view>{
+      "Evaluate", "Inputs", "Outputs", "std",
+  };
+  // Tacking on a '_' can't collide with another name as long as every name
+  // that already ends in one also gets another.
+  if (kKeywords->count(name) || kReserved->count(name) ||
+      absl::StartsWith(name, "tbd_") || absl::EndsWith(name, "_")) {
+    return absl::StrCat(name, "_");
+  }
+  return std::string(name);
+}
+
+std::string CppNumber(double v) {
+  if (std::isnan(v)) return "std::numeric_limits<double>::quiet_NaN()";
+  if (std::isinf(v)) {
+    return v < 0 ? "-std::numeric_limits<double>::infinity()"
+                 : "std::numeric_limits<double>::infinity()";
+  }
+
+  // Use the shortest form that reads back as the same value.
+  std::string ret;
+  for (int p = 6; p <= 17; p++) {
+    ret = absl::StrFormat("%.*g", p, v);
+    if (std::strtod(ret.c_str(), nullptr) == v) break;
+  }
+  // Don't let it look like an integer (e.g. to avoid integer division).
+  if (ret.find_first_of(".e") == std::string::npos) ret += ".0";
+  return ret;
+}
+
+namespace {
+
+using ExpP = const SemanticDocument::Exp*;
+
+// The body of the solver used by the generated code.
+constexpr absl::string_view kSolver = R"(// Solve residual(x) = 0 by Newton's method, starting from x.
+template <int N, class F>
+bool tbd_solve(F residual, double (&x)[N]) {
+  constexpr double kTolerance = 1e-9;
+  double y[N], x_d[N], y_d[N], jac[N][N];
+  for (int cycle = 0; cycle < 50; cycle++) {
+    residual(x, y);
+    double err = 0;
+    for (int i = 0; i < N; i++) err = std::fmax(err, std::fabs(y[i]));
+    if (err < kTolerance) return true;
+
+    // Find the Jacobian by finite differences.
+    for (int j = 0; j < N; j++) {
+      for (int i = 0; i < N; i++) x_d[i] = x[i];
+      const double h = 1e-7 * std::fmax(1.0, std::fabs(x[j]));
+      x_d[j] += h;
+      residual(x_d, y_d);
+      for (int i = 0; i < N; i++) jac[i][j] = (y_d[i] - y[i]) / h;
+    }
+
+    // Solve jac * d = y by Gaussian elimination with partial pivoting.
+    for (int k = 0; k < N; k++) {
+      int p = k;
+      for (int i = k + 1; i < N; i++) {
+        if (std::fabs(jac[i][k]) > std::fabs(jac[p][k])) p = i;
+      }
+      if (!(std::fabs(jac[p][k]) > 0)) break;
+      for (int j = 0; j < N; j++) std::swap(jac[k][j], jac[p][j]);
+      std::swap(y[k], y[p]);
+      for (int i = k + 1; i < N; i++) {
+        const double f = jac[i][k] / jac[k][k];
+        for (int j = k; j < N; j++) jac[i][j] -= f * jac[k][j];
+        y[i] -= f * y[k];
+      }
+    }
+    for (int k = N - 1; k >= 0; k--) {
+      for (int j = k + 1; j < N; j++) y[k] -= jac[k][j] * y[j];
+      y[k] /= jac[k][k];
+    }
+    for (int i = 0; i < N; i++) x[i] -= y[i];
+  }
+
+  // Leave the values as computed from the final guess.
+  residual(x, y);
+  double err = 0;
+  for (int i = 0; i < N; i++) err = std::fmax(err, std::fabs(y[i]));
+  return err < kTolerance;
+}
+)";
+
+// Make an identifier from an arbitrary string.
+std::string Identifier(absl::string_view s) {
+  std::string ret;
+  for (char c : s) {
+    ret.push_back(absl::ascii_isalnum(c) ? c : '_');
+  }
+  if (ret.empty() || absl::ascii_isdigit(ret[0])) ret.insert(0, "_");
+  return CppName(ret);
+}
+
+std::string Name(ExpP e) { return CppName(e->meta->name); }
+
+double Scale(ExpP e) {
+  return e->meta->unit ? e->meta->unit->scale : 1;
+}
+
+std::string UnitComment(ExpP e) {
+  if (e->meta->unit) {
+    return absl::StrCat("  // [", e->meta->unit->name, "]");
+  }
+  if (e->meta->dim.has_value()) {
+    std::stringstream out;
+    out << "  // " << *e->meta->dim;
+    return out.str();
+  }
+  return "";
+}
+
+// The initializer for where solving a stage starts. Empty (i.e. zero) if no
+// variable has a hint.
+std::string Start(const Evaluate::Stage& s) {
+  if (s.start.isZero(0)) return "";
+  std::vector<std::string> ret;
+  for (int i = 0; i < s.start.size(); i++) {
+    ret.push_back(CppNumber(s.start[i]));
+  }
+  return absl::StrJoin(ret, ", ");
+}
+
+void Declarations(absl::string_view name, const std::vector<ExpP>& inputs,
+                  const std::vector<ExpP>& outputs, std::ostream& out) {
+  out << "namespace " << name << " {\n\n"
+      << "// The defined values.\n"
+      << "struct Inputs {\n";
+  for (const auto* e : inputs) {
+    out << "  double " << Name(e) << " = " << CppNumber(e->value / Scale(e))
+        << ";" << UnitComment(e) << "\n";
+  }
+  out << "};\n\n"
+      << "// The computed values. Anything that can't be found is NaN.\n"
+      << "struct Outputs {\n";
+  for (const auto* e : outputs) {
+    out << "  double " << Name(e)
+        << " = std::numeric_limits<double>::quiet_NaN();" << UnitComment(e)
+        << "\n";
+  }
+  out << "};\n\n"
+      << "// Compute the outputs from the inputs. Returns false if a system\n"
+      << "// of equations did not converge.\n"
+      << "bool Evaluate(const Inputs& tbd_in, Outputs* tbd_out);\n\n"
+      << "}  // namespace " << name << "\n";
+}
+
+}  // namespace
+
+bool RenderCppModel(const SemanticDocument& doc,
+                    const std::vector<const Evaluate::Stage*>& stages,
+                    absl::string_view name, std::ostream& src,
+                    std::ostream* hdr, absl::string_view header_name) {
+  const std::string ns = Identifier(name);
+
+  // Sort out what each named value is.
+  std::vector<ExpP> constants, inputs, outputs;
+  for (const auto* e : doc.nodes()) {
+    if (e->meta->name.empty()) continue;
+    if (e->meta->node && InPreamble(e->meta->node->location())) {
+      if (e->meta->def != nullptr) constants.push_back(e);
+    } else if (e->meta->def != nullptr) {
+      inputs.push_back(e);
+    } else {
+      outputs.push_back(e);
+    }
+  }
+  auto by_name = [](ExpP a, ExpP b) { return a->meta->name < b->meta->name; };
+  std::sort(constants.begin(), constants.end(), by_name);
+  std::sort(inputs.begin(), inputs.end(), by_name);
+  std::sort(outputs.begin(), outputs.end(), by_name);
+
+  src << "// Generated by tbd. Do not edit.\n";
+  if (hdr != nullptr) {
+    std::string guard =
+        absl::AsciiStrToUpper(absl::StrCat(Identifier(header_name), "_"));
+    *hdr << "// Generated by tbd. Do not edit.\n"
+         << "#ifndef " << guard << "\n"
+         << "#define " << guard << "\n\n"
+         << "#include <limits>\n\n";
+    Declarations(ns, inputs, outputs, *hdr);
+    *hdr << "\n#endif  // " << guard << "\n";
+    src << "#include \"" << header_name << "\"\n\n";
+  }
+  src << "#include <cmath>\n"
+      << "#include <limits>\n"
+      << "#include <utility>\n\n";
+  if (hdr == nullptr) {
+    Declarations(ns, inputs, outputs, src);
+    src << "\n";
+  }
+
+  src << "namespace " << ns << " {\n"
+      << "namespace {\n\n";
+  for (const auto* e : constants) {
+    src << "[[maybe_unused]] constexpr double " << Name(e) << " = "
+        << CppNumber(e->value) << ";\n";
+  }
+  if (!constants.empty()) src << "\n";
+  src << kSolver << "\n"
+      << "}  // namespace\n\n"
+      << "bool Evaluate([[maybe_unused]] const Inputs& tbd_in,\n"
+      << "              [[maybe_unused]] Outputs* tbd_out) {\n"
+      << "  bool tbd_ok = true;\n\n";
+
+  // All the computation is done in SI units.
+  for (const auto* e : inputs) {
+    src << "  [[maybe_unused]] const double " << Name(e)
+        << " = tbd_in." << Name(e);
+    if (Scale(e) != 1) src << " * " << CppNumber(Scale(e));
+    src << ";\n";
+  }
+  for (const auto* e : outputs) {
+    src << "  double " << Name(e)
+        << " = std::numeric_limits<double>::quiet_NaN();\n";
+  }
+
+  bool success = true;
+  CodeEvaluate code(src);
+  code.set_indent("  ");
+  for (size_t i = 0; i < stages.size(); i++) {
+    const auto* s = stages[i];
+    src << "\n  // Stage " << i << "\n";
+    for (const auto& op : s->direct_ops) {
+      if (!op->VisitOp(&code)) {
+        LOG(ERROR) << "Error generateding C++ for opertion at "
+                   << op->location();
+        success = false;
+      }
+    }
+    if (s->solve_ops.empty()) continue;
+
+    src << "  {\n"
+        << "    auto tbd_residual = [&](const double (&tbd_src)[" << s->count
+        << "], double (&tbd_des)[" << s->count << "]) {\n";
+    code.set_indent("      ");
+    for (const auto& op : s->solve_ops) {
+      if (!op->VisitOp(&code)) {
+        LOG(ERROR) << "Error generateding C++ for opertion at "
+                   << op->location();
+        success = false;
+      }
+    }
+    code.set_indent("  ");
+    src << "    };\n"
+        << "    double tbd_x[" << s->count << "] = {" << Start(*s) << "};\n"
+        << "    tbd_ok = tbd_solve(tbd_residual, tbd_x) && tbd_ok;\n"
+        << "  }\n";
+  }
+
+  src << "\n";
+  for (const auto* e : outputs) {
+    src << "  tbd_out->" << Name(e) << " = " << Name(e);
+    if (Scale(e) != 1) src << " / " << CppNumber(Scale(e));
+    src << ";\n";
+  }
+  src << "  return tbd_ok;\n"
+      << "}\n\n"
+      << "}  // namespace " << ns << "\n";
+
+  return success;
+}
+
 }  // namespace tbd
@@ -31,8 +31,11 @@
 #include <map>
 #include <ostream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/strings/string_view.h"
+#include "tbd/evaluate.h"
 #include "tbd/ops.h"
 #include "tbd/semantic.h"
 
@@ -45,6 +48,9 @@ class CodeEvaluate final : public VisitOps {
  public:
   CodeEvaluate(std::ostream& out) : out_(out) {}
 
+  // Prefix each statement with this.
+  void set_indent(std::string indent) { indent_ = std::move(indent); }
+
   ABSL_MUST_USE_RESULT bool operator()(const OpAdd&) override;
   ABSL_MUST_USE_RESULT bool operator()(const OpSub&) override;
   ABSL_MUST_USE_RESULT bool operator()(const OpMul&) override;
@@ -62,9 +68,30 @@ class CodeEvaluate final : public VisitOps {
   bool Add(ExpP, std::string);
 
   std::ostream& out_;
+  std::string indent_;
   std::map<const SemanticDocument::Exp*, std::string> expressions_;
 };
 
+// Make a name usable as a C++ identifier (i.e. not a keyword).
+std::string CppName(absl::string_view name);
+
+// Format a value as a C++ floating point literal that reads back exactly.
+std::string CppNumber(double v);
+
+// Render an evaluated document as C++. This consists of an Inputs struct
+// (the defined values), an Outputs struct (the rest of the named values)
+// and an Evaluate function that computes the one from the other, solving
+// each stage's system of equations with a small, allocation free, Newton
+// loop. Values in the structs are in the units they were given in.
+//
+// Everything is put in namespace name. If hdr is null, the declarations are
+// written to src, otherwise they are written to hdr which src includes as
+// header_name.
+ABSL_MUST_USE_RESULT bool RenderCppModel(
+    const SemanticDocument& doc, const std::vector<const Evaluate::Stage*>& stages,
+    absl::string_view name, std::ostream& src, std::ostream* hdr,
+    absl::string_view header_name);
+
 }  // namespace tbd
 
 #endif  // TBD_GEN_CODE_H_
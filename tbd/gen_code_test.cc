@@ -27,6 +27,7 @@
 
 #include "tbd/gen_code.h"
 
+#include <cmath>
 #include <sstream>
 
 #include "gmock/gmock.h"
@@ -42,21 +43,18 @@ TEST(TestCodeEvaluate, VisitAdd) {
   EXPECT_THAT(out.str(), testing::Eq(""));
 
   // Add some operations.
-  SemanticDocument::Exp A, B;
-  SemanticDocument::Exp R1, R2, R3;
-  SemanticDocument::Exp T1, T2, T3;
-  A.name = "a";
-  B.name = "b";
-  T1.name = "T1";
-  T2.name = "T2";
-  T3.name = "T3";
-
-  OpAdd a(&R1, &A, &B);
-  OpAssign e1(&T1, &R1);
-  OpSub s(&R2, &T1, &B);
-  OpAssign e2(&T2, &R2);
-  OpMul m(&R3, &R1, &R1);
-  OpAssign e3(&T3, &R3);
+  SemanticDocument doc;
+  auto *A = doc.GetNodeForName("a"), *B = doc.GetNodeForName("b");
+  auto *R1 = doc.GetNode(), *R2 = doc.GetNode(), *R3 = doc.GetNode();
+  auto *T1 = doc.GetNodeForName("T1"), *T2 = doc.GetNodeForName("T2"),
+       *T3 = doc.GetNodeForName("T3");
+
+  OpAdd a(R1, A, B);
+  OpAssign e1(T1, R1);
+  OpSub s(R2, T1, B);
+  OpAssign e2(T2, R2);
+  OpMul m(R3, R1, R1);
+  OpAssign e3(T3, R3);
 
   out << "\n";
 
@@ -70,5 +68,59 @@ T3 = ((a + b) * (a + b));
 )"));
 }
 
+TEST(TestCodeEvaluate, VisitSystem) {
+  std::stringstream out(std::ios_base::out);
+  CodeEvaluate code(out);
+  code.set_indent("  ");
+
+  SemanticDocument doc;
+  auto *A = doc.GetNodeForName("a"), *B = doc.GetNodeForName("b");
+  auto *C = doc.GetNode(), *R1 = doc.GetNode(), *R2 = doc.GetNode();
+  C->is_literal = true;
+  C->value = 2;
+
+  OpLoad l(A, 0);
+  OpMul m(R1, A, C);
+  OpAssign e(B, R1);
+  OpDiv d(R2, B, C);
+  OpCheck c(0, R2, A);
+
+  OpI* all_ops[] = {&l, &m, &e, &d, &c};
+  for (OpI* op : all_ops) EXPECT_TRUE(op->VisitOp(&code));
+
+  EXPECT_THAT(out.str(), testing::Eq(R"(  a = tbd_src[0];
+  b = (a * 2.0);
+  tbd_des[0] = ((b / 2.0) - a);
+)"));
+}
+
+TEST(TestCppNumber, Basic) {
+  EXPECT_EQ(CppNumber(2), "2.0");
+  EXPECT_EQ(CppNumber(-0.5), "-0.5");
+  EXPECT_EQ(CppNumber(1e30), "1e+30");
+  EXPECT_EQ(CppNumber(0.1), "0.1");
+  EXPECT_EQ(CppNumber(1.0 / 3), "0.3333333333333333");
+  EXPECT_EQ(CppNumber(-INFINITY), "-std::numeric_limits<double>::infinity()");
+}
+
+TEST(TestCppName, Keywords) {
+  EXPECT_EQ(CppName("x"), "x");
+  EXPECT_EQ(CppName("new"), "new_");
+  EXPECT_EQ(CppName("int"), "int_");
+}
+
+TEST(TestCppName, Reserved) {
+  EXPECT_EQ(CppName("Inputs"), "Inputs_");
+  EXPECT_EQ(CppName("Evaluate"), "Evaluate_");
+  EXPECT_EQ(CppName("std"), "std_");
+  EXPECT_EQ(CppName("tbd_x"), "tbd_x_");
+  EXPECT_EQ(CppName("tbd"), "tbd");
+
+  // Names that already end in '_' must not collide with mangled names.
+  EXPECT_EQ(CppName("new_"), "new__");
+  EXPECT_EQ(CppName("tbd_x_"), "tbd_x__");
+  EXPECT_EQ(CppName("x_"), "x__");
+}
+
 }  // namespace
 }  // namespace tbd
\ No newline at end of file
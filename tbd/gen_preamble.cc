@@ -0,0 +1,156 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Resolve the preamble at build time and write it out as C++ that seeds a
+// document directly (see preamble.h).
+//
+// Usage: gen_preamble <preamble.tbd> <output.cc>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "absl/log/check.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "tbd/ast.h"
+#include "tbd/dimensions.h"
+#include "tbd/gen_code.h"
+#include "tbd/parser.h"
+#include "tbd/resolve_units.h"
+#include "tbd/semantic.h"
+#include "tbd/validate.h"
+
+namespace tbd {
+namespace {
+
+std::string Exponent(const std::string& s) {
+  int i;
+  CHECK(absl::SimpleAtoi(s, &i)) << "Fractional exponent '" << s << "'";
+  return absl::StrCat(i);
+}
+
+class TableOutput : public UnitsOutput {
+ public:
+  explicit TableOutput(std::ostream& out) : out_(out) {}
+
+  void Output(const std::string& name, const Unit& u) const override {
+    if (base_.LookupUnit(name)) return;  // Already in every document.
+    const Dimension& d = u.dim;
+    out_ << "    {\"" << name << "\", " << CppNumber(u.scale) << ", {"
+         << absl::StrJoin({Exponent(d.l()), Exponent(d.m()), Exponent(d.t()),
+                           Exponent(d.i()), Exponent(d.k()), Exponent(d.n()),
+                           Exponent(d.j())},
+                          ", ")
+         << "}},\n";
+  }
+
+ private:
+  std::ostream& out_;
+  SemanticDocument base_;
+};
+
+std::string L(const Loc& l) {
+  return absl::StrCat("L(", l.line_begin, ", ", l.line_end, ", ", l.col_begin,
+                      ", ", l.col_end, ")");
+}
+
+void WriteDefine(std::ostream& out, const Define& d) {
+  out << "  {\n"
+      << "    auto* unit = doc->New<UnitExp>(" << L(d.unit().location())
+      << ");\n";
+  for (const auto& b : d.unit().bits()) {
+    out << "    unit->Mul(absl::make_unique<UnitExp::UnitT>(\n"
+        << "        UnitExp::UnitT{\""
+        << b.id << "\", " << b.exp << ", " << L(b.loc) << "}));\n";
+  }
+  out << "    doc->AddDefinition(doc->New<Define>(\n"
+      << "        " << L(d.location()) << ", \"" << d.name() << "\",\n"
+      << "        doc->New<LiteralValue>(" << L(d.location()) << ", "
+      << CppNumber(d.value()) << "), unit));\n"
+      << "  }\n";
+}
+
+}  // namespace
+}  // namespace tbd
+
+int main(int argc, char** argv) {
+  CHECK(argc == 3) << "Usage: " << argv[0] << " <preamble.tbd> <output.cc>";
+
+  std::ifstream in(argv[1]);
+  CHECK(in) << "Failed to open " << argv[1];
+  std::string text{std::istreambuf_iterator<char>(in), {}};
+
+  auto outp = [](const std::string& s) { std::cerr << s << "\n"; };
+  tbd::Document doc;
+  tbd::SemanticDocument sem;
+  CHECK(tbd::Parse(tbd::kPreamble, text, outp, &doc) == 0);
+  CHECK(doc.VisitNode(tbd::Validate(&sem, outp).as_ptr()));
+  tbd::ResolveUnits resolve(&sem, outp);
+  CHECK(doc.VisitNode(&resolve));
+  CHECK(resolve.ResolveAll());
+
+  std::ofstream out(argv[2]);
+  CHECK(out) << "Failed to open " << argv[2];
+  out << "// Generated from " << argv[1] << " by gen_preamble. Do not edit.\n"
+      << "\n"
+      << "#include <cmath>\n"
+      << "#include <limits>\n"
+      << "\n"
+      << "#include \"absl/memory/memory.h\"\n"
+      << "#include \"tbd/ast.h\"\n"
+      << "#include \"tbd/preamble.h\"\n"
+      << "#include \"tbd/semantic.h\"\n"
+      << "\n"
+      << "namespace tbd {\n"
+      << "\n"
+      << "const PreambleUnit kPreambleUnits[] = {\n";
+  sem.LogUnits(tbd::TableOutput(out));
+  out << "};\n"
+      << "const size_t kPreambleUnitCount =\n"
+      << "    sizeof(kPreambleUnits) / sizeof(kPreambleUnits[0]);\n"
+      << "\n"
+      << "void AddPreambleDefines(Document* doc) {\n"
+      << "  const int file = InternFileName(kPreamble);\n"
+      << "  auto L = [file](int lb, int le, int cb, int ce) {\n"
+      << "    Loc l;\n"
+      << "    l.file = file;\n"
+      << "    l.line_begin = lb;\n"
+      << "    l.line_end = le;\n"
+      << "    l.col_begin = cb;\n"
+      << "    l.col_end = ce;\n"
+      << "    return l;\n"
+      << "  };\n";
+  for (const auto* d : doc.defines()) tbd::WriteDefine(out, *d);
+  out << "}\n"
+      << "\n"
+      << "}  // namespace tbd\n";
+  CHECK(out) << "Failed to write " << argv[2];
+  return 0;
+}
@@ -86,7 +86,7 @@ int RenderAsGraphViz::AddDefault(const ExpressionNode* n) {
   auto& it = all_nodes_[ret];
   auto sem = doc_->TryGetNode(n);
   if (sem) {
-    it.dim = sem->dim;
+    it.dim = sem->meta->dim;
     it.has_value = sem->resolved;
   }
   CHECK(id_.emplace(n, ret).second);
@@ -125,7 +125,7 @@ bool RenderAsGraphViz::operator()(const NamedValue& n) {
 
   if (r.second) it.label = n.name();
   if (sem) {
-    it.dim = sem->dim;
+    it.dim = sem->meta->dim;
     it.has_value = sem->resolved;
   }
 
@@ -163,7 +163,7 @@ bool RenderAsGraphViz::operator()(const Define& d) {
   }
 
   // Ignore preamble.
-  if (d.location().filename == kPreamble) return true;
+  if (InPreamble(d.location())) return true;
 
   // Un-used nodes get negative id.
   auto& n = all_nodes_[-(++unknown_)];
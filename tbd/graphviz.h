@@ -65,6 +65,7 @@ class RenderAsGraphViz : public VisitNodes {
   bool operator()(const NegativeExp&) override;
   bool operator()(const Define&) override;
   bool operator()(const Specification&) override { return false; }
+  bool operator()(const Hint&) override { return false; }
   bool operator()(const Document&) override;
 
   SemanticDocument* doc_;
@@ -0,0 +1,118 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tbd/mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+
+namespace tbd {
+namespace {
+
+// Close a file descriptor without losing the errno from an earlier failure.
+void CloseKeepErrno(int fd) {
+  int e = errno;
+  close(fd);
+  errno = e;
+}
+
+}  // namespace
+
+std::unique_ptr<MappedFile> MappedFile::Open(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return nullptr;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    CloseKeepErrno(fd);
+    return nullptr;
+  }
+
+  if (!S_ISREG(st.st_mode)) {
+    // Can't be mapped, so read it.
+    std::string data;
+    char chunk[1 << 16];
+    for (ssize_t n; (n = read(fd, chunk, sizeof(chunk))) != 0;) {
+      if (n > 0) {
+        data.append(chunk, n);
+      } else if (errno != EINTR) {
+        CloseKeepErrno(fd);
+        return nullptr;
+      }
+    }
+    close(fd);
+
+    const size_t size = data.size();
+    data.append(kPadding, '\0');
+    auto ret = absl::WrapUnique(new MappedFile(nullptr, size, 0));
+    ret->read_ = std::move(data);
+    ret->base_ = &ret->read_[0];
+    return ret;
+  }
+
+  // Reserve zeroed memory for the file and the padding and then map the file
+  // over the start of it. That way the padding is there even when the file
+  // ends on a page boundary.
+  const size_t size = st.st_size;
+  const size_t length = size + kPadding;
+  void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    CloseKeepErrno(fd);
+    return nullptr;
+  }
+  if (size > 0) {
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+             0) == MAP_FAILED) {
+      int e = errno;
+      munmap(base, length);
+      close(fd);
+      errno = e;
+      return nullptr;
+    }
+    // It's going to be scanned from start to end.
+    madvise(base, size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  return absl::WrapUnique(
+      new MappedFile(static_cast<char*>(base), size, length));
+}
+
+MappedFile::~MappedFile() {
+  if (length_ != 0) munmap(base_, length_);
+}
+
+}  // namespace tbd
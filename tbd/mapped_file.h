@@ -0,0 +1,75 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TBD_MAPPED_FILE_H_
+#define TBD_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace tbd {
+
+// The contents of a file, mapped into memory rather than read, and followed
+// by the two NUL bytes flex needs at the end of a buffer it scans in place.
+//
+// The mapping is private, so writing to buffer() only copies the pages
+// written to and never changes the file. Things that can't be mapped (e.g.
+// pipes) are read into memory instead.
+class MappedFile {
+ public:
+  // Open and map a file. On failure, returns null with errno set.
+  static std::unique_ptr<MappedFile> Open(const std::string& path);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  // The contents of the file.
+  absl::string_view contents() const { return {base_, size_}; }
+
+  // The contents of the file followed by the two NULs.
+  absl::Span<char> buffer() { return {base_, size_ + kPadding}; }
+
+  static constexpr size_t kPadding = 2;
+
+ private:
+  MappedFile(char* base, size_t size, size_t length)
+      : base_(base), size_(size), length_(length) {}
+
+  char* base_;
+  size_t size_;    // The size of the file.
+  size_t length_;  // The size of the mapping, or 0 if it's not mapped.
+  std::string read_;  // The contents, if they were read rather than mapped.
+};
+
+}  // namespace tbd
+
+#endif  // TBD_MAPPED_FILE_H_
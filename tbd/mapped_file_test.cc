@@ -0,0 +1,104 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tbd/mapped_file.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace tbd {
+namespace {
+
+std::string WriteFile(const std::string& name, const std::string& data) {
+  std::string path = absl::StrCat(testing::TempDir(), "/", name);
+  std::ofstream out(path, std::ios::out | std::ios::binary);
+  out << data;
+  return path;
+}
+
+void ExpectPadded(MappedFile* file, const std::string& data) {
+  EXPECT_EQ(file->contents(), data);
+  auto buffer = file->buffer();
+  ASSERT_EQ(buffer.size(), data.size() + MappedFile::kPadding);
+  EXPECT_EQ(buffer[data.size()], '\0');
+  EXPECT_EQ(buffer[data.size() + 1], '\0');
+}
+
+TEST(MappedFile, Small) {
+  const std::string data = "a := 1 [m];\n";
+  auto file = MappedFile::Open(WriteFile("small.tbd", data));
+  ASSERT_NE(file, nullptr);
+  ExpectPadded(file.get(), data);
+}
+
+TEST(MappedFile, PageSized) {
+  // The padding has to come from past the end of the file's pages.
+  const std::string data(2 * sysconf(_SC_PAGESIZE), 'x');
+  auto file = MappedFile::Open(WriteFile("page.tbd", data));
+  ASSERT_NE(file, nullptr);
+  ExpectPadded(file.get(), data);
+}
+
+TEST(MappedFile, Empty) {
+  auto file = MappedFile::Open(WriteFile("empty.tbd", ""));
+  ASSERT_NE(file, nullptr);
+  ExpectPadded(file.get(), "");
+}
+
+TEST(MappedFile, NotRegular) {
+  auto file = MappedFile::Open("/dev/null");
+  ASSERT_NE(file, nullptr);
+  ExpectPadded(file.get(), "");
+}
+
+TEST(MappedFile, Missing) {
+  errno = 0;
+  EXPECT_EQ(MappedFile::Open(absl::StrCat(testing::TempDir(), "/missing")),
+            nullptr);
+  EXPECT_EQ(errno, ENOENT);
+}
+
+TEST(MappedFile, WritesArePrivate) {
+  const std::string path = WriteFile("private.tbd", "abc");
+  auto file = MappedFile::Open(path);
+  ASSERT_NE(file, nullptr);
+  file->buffer()[1] = '\0';
+  EXPECT_EQ(file->contents(), absl::string_view("a\0c", 3));
+
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  EXPECT_EQ(std::string(std::istreambuf_iterator<char>(in), {}), "abc");
+}
+
+}  // namespace
+}  // namespace tbd
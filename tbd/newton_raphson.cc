@@ -28,41 +28,245 @@
 #include "tbd/newton_raphson.h"
 
 #include <cmath>
+#include <ostream>
+#include <utility>
 
 #include "Eigen/Core"
-#include "Eigen/Geometry"
+#include "Eigen/LU"
+#include "Eigen/SparseCore"
+#include "Eigen/SparseLU"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 
 namespace tbd {
+namespace {
 
-VXd NewtonRaphson(SystemFunction fn, int dim, int count, double tol) {
+// Systems at least this big that are mostly zeros are solved as sparse.
+constexpr int kSparseMinDim = 32;
+constexpr double kSparseMaxFill = 0.1;
+
+// Find the Jacobian by finite differences from the residuals at x.
+void FiniteDifference(const JacobianFunction& fn, const VXd& x, const VXd& y_0,
+                      MXd* jac) {
+  // TODO scale delta based on how much we expect to need to mutate.
+  VXd probe = x;
+  for (int i = 0; i < x.size(); i++) {
+    probe[i] += 1;
+    jac->col(i) = fn(probe, nullptr) - y_0;
+    probe[i] = x[i];
+  }
+}
+
+// Find the next update from the Jacobian at x. If that is singular, fall
+// back to a finite difference or, failing that, a step to somewhere else.
+VXd Step(const JacobianFunction& fn, const VXd& x, const VXd& y, MXd* jac,
+         SolveStats* stats) {
+  VXd update = NewtonStep(*jac, y);
+  if (!update.allFinite()) {
+    // The exact slope is singular here (e.g. x*y at x = y = 0). A finite
+    // difference looks a step away, where it often isn't.
+    FiniteDifference(fn, x, y, jac);
+    stats->evaluations += x.size();
+    update = NewtonStep(*jac, y);
+  }
+  if (!update.allFinite()) {
+    // Nowhere to go from here (e.g. x/y at y = 0), so try from nearby.
+    LOG(INFO) << "No finite step from [" << x.transpose() << "]";
+    update = VXd::Constant(x.size(), -1.0);
+  }
+  return update;
+}
+
+}  // namespace
+
+bool IsSparse(int dim, int64_t nonzeros) {
+  if (dim < kSparseMinDim) return false;
+  return nonzeros <= kSparseMaxFill * dim * dim;
+}
+
+VXd NewtonStep(const MXd& jac, const VXd& y) {
+  return jac.partialPivLu().solve(y);
+}
+
+std::ostream& operator<<(std::ostream& o, const SolveStats& s) {
+  return o << (s.converged ? "converged" : "did not converge") << " in "
+           << s.cycles << " cycles using " << s.evaluations
+           << " evaluations and " << s.jacobians << " Jacobians";
+}
+
+VXd NewtonRaphson(SystemFunction fn, int dim, int count, double tol,
+                  SolveStats* stats) {
+  // Find the Jacobian by finite differences.
+  JacobianFunction residual = [&fn](const VXd& x, MXd*) { return fn(x); };
+  auto jac_fn = [&fn, &residual](const VXd& x, MXd* jac) {
+    VXd y_0 = fn(x);
+    if (jac != nullptr) FiniteDifference(residual, x, y_0, jac);
+    return y_0;
+  };
+  return NewtonRaphson(JacobianFunction(jac_fn), dim, count, tol, stats);
+}
+
+VXd NewtonRaphson(JacobianFunction fn, int dim, int count, double tol,
+                  SolveStats* stats) {
   CHECK(dim >= 1);
+  // Start from zero. Evaluate starts from the hints (e.g. "x ~= 3;") when
+  // there are any, and zero otherwise.
+  return NewtonRaphson(fn, VXd::Constant(dim, 1, 0.0), count, tol, stats);
+}
 
-  // TODO find a better way to get intial guesses
-  VXd ret = VXd::Constant(dim, 1, 0.0);  // Populate (with 0) as the first guess
+VXd NewtonRaphson(JacobianFunction fn, VXd start, int count, double tol,
+                  SolveStats* stats) {
+  const int dim = start.size();
+  CHECK(dim >= 1);
+  SolveStats local;
+  if (stats == nullptr) stats = &local;
 
-  MXd delta = MXd::Identity(dim, dim);
+  VXd ret = std::move(start);
 
-  VXd y_ret = fn(ret);  // get the inital result at the guess
-  for (int cycle = 0; cycle < count; cycle++) {
-    Eigen::MatrixXd d_x{dim, dim};
+  MXd d_x{dim, dim};
+  VXd y_ret;
+  for (int cycle = 0;; cycle++) {
+    // Get the result and slope at the guess. After the last step, only the
+    // result is needed.
+    if (cycle < count) {
+      y_ret = fn(ret, &d_x);
+      stats->jacobians++;
+    } else {
+      y_ret = fn(ret, nullptr);
+      stats->evaluations++;
+    }
 
-    // TODO scale delta based on how much we expect to need to mutate.
-    auto y_0 = fn(ret);
-    for (int i = 0; i < dim; i++) {
-      d_x.col(i) = fn(ret + delta.col(i)) - y_0;
+    if (y_ret.array().abs().maxCoeff() < tol) {
+      stats->converged = true;
+      return ret;
     }
+    if (cycle == count) break;
 
     // Compute the next guess
-    VXd update = d_x.inverse() * y_ret;
-    ret -= update;
+    ret -= Step(fn, ret, y_ret, &d_x, stats);
+    stats->cycles++;
+  }
+  LOG(INFO) << "Did not converge in " << count << " steps ["  //
+            << y_ret.transpose() << "]";
+  return ret;
+}
+
+VXd NewtonRaphson(SparseJacobianFunction fn, VXd start, int count,
+                  double tol, SolveStats* stats) {
+  const int dim = start.size();
+  CHECK(dim >= 1);
+  SolveStats local;
+  if (stats == nullptr) stats = &local;
 
-    y_ret = fn(ret);  // get the next result at the guess
+  VXd ret = std::move(start);
+
+  // The non-zeros don't change so the ordering only needs to be found once.
+  SMXd d_x{dim, dim};
+  Eigen::SparseLU<SMXd> lu;
+  bool analyzed = false;
+  VXd y_ret;
+  for (int cycle = 0;; cycle++) {
+    // As above, only the last check skips the slope.
+    if (cycle < count) {
+      y_ret = fn(ret, &d_x);
+      stats->jacobians++;
+    } else {
+      y_ret = fn(ret, nullptr);
+      stats->evaluations++;
+    }
 
     if (y_ret.array().abs().maxCoeff() < tol) {
+      stats->converged = true;
+      return ret;
+    }
+    if (cycle == count) break;
+
+    if (!analyzed) {
+      lu.analyzePattern(d_x);
+      analyzed = true;
+    }
+
+    // Compute the next guess, the same way as above if the sparse
+    // factorization can't.
+    lu.factorize(d_x);
+    VXd update;
+    if (lu.info() == Eigen::Success) update = lu.solve(y_ret);
+    if (update.size() != dim || !update.allFinite()) {
+      JacobianFunction residual = [&fn](const VXd& x, MXd*) {
+        return fn(x, nullptr);
+      };
+      MXd dense{d_x};
+      update = Step(residual, ret, y_ret, &dense, stats);
+    }
+    ret -= update;
+    stats->cycles++;
+  }
+  LOG(INFO) << "Did not converge in " << count << " steps ["  //
+            << y_ret.transpose() << "]";
+  return ret;
+}
+
+VXd Broyden(JacobianFunction fn, int dim, int count, double tol,
+            SolveStats* stats) {
+  CHECK(dim >= 1);
+  return Broyden(fn, VXd::Constant(dim, 1, 0.0), count, tol, stats);
+}
+
+VXd Broyden(JacobianFunction fn, VXd start, int count, double tol,
+            SolveStats* stats) {
+  const int dim = start.size();
+  CHECK(dim >= 1);
+  SolveStats local;
+  if (stats == nullptr) stats = &local;
+
+  VXd ret = std::move(start);
+
+  // Rather than the Jacobian, track its inverse so that each cycle is
+  // just a product and the rank-one update can be applied to it directly
+  // (via Sherman-Morrison).
+  MXd inv{dim, dim};
+  VXd y_ret = fn(ret, &inv);
+  stats->jacobians++;
+  inv = inv.partialPivLu().inverse();
+
+  for (int cycle = 0; cycle < count; cycle++) {
+    VXd d_x = -(inv * y_ret);
+    if (!d_x.allFinite()) {
+      // No finite step (e.g. the Jacobian is singular), so try from nearby.
+      LOG(INFO) << "No finite step from [" << ret.transpose() << "]";
+      ret.array() += 1;
+      stats->cycles++;
+      y_ret = fn(ret, &inv);
+      stats->jacobians++;
+      inv = inv.partialPivLu().inverse();
+      continue;
+    }
+    ret += d_x;
+    stats->cycles++;
+
+    VXd y_next = fn(ret, nullptr);
+    stats->evaluations++;
+
+    if (y_next.array().abs().maxCoeff() < tol) {
+      stats->converged = true;
       return ret;
     }
+
+    if (!(y_next.norm() < y_ret.norm())) {
+      // No progress was made, start over from a real Jacobian.
+      y_ret = fn(ret, &inv);
+      stats->jacobians++;
+      inv = inv.partialPivLu().inverse();
+      continue;
+    }
+
+    VXd d_y = y_next - y_ret;
+    y_ret = y_next;
+
+    VXd inv_dy = inv * d_y;
+    double denom = d_x.dot(inv_dy);
+    if (denom == 0 || !std::isfinite(denom)) continue;
+    inv += ((d_x - inv_dy) * (d_x.transpose() * inv)) / denom;
   }
   LOG(INFO) << "Did not converge in " << count << " steps ["  //
             << y_ret.transpose() << "]";
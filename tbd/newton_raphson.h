@@ -28,23 +28,84 @@
 #ifndef TBD_NEWTON_RAPHSON_H_
 #define TBD_NEWTON_RAPHSON_H_
 
+#include <cstdint>
 #include <functional>
+#include <ostream>
 
 #include "Eigen/Core"
+#include "Eigen/SparseCore"
 
 namespace tbd {
 
 using VXd = Eigen::VectorXd;
 using MXd = Eigen::MatrixXd;
+using SMXd = Eigen::SparseMatrix<double>;
 
 using SystemFunction = std::function<VXd(const VXd&)>;
 
+// Like SystemFunction but, if jac is not null, it also populates it with
+// the Jacobian of the residuals at the given input; jac(i, j) is the
+// derivative of result i with respect to input j.
+using JacobianFunction = std::function<VXd(const VXd&, MXd* jac)>;
+
+// Like JacobianFunction but with a sparse Jacobian. It must have the same
+// non-zeros (explicit zeros included) every time.
+using SparseJacobianFunction = std::function<VXd(const VXd&, SMXd* jac)>;
+
+// Which solver to use for systems of equations.
+enum class Solver {
+  kNewton,   // NewtonRaphson
+  kBroyden,  // Broyden
+};
+
+// A tally of the work done by a solver.
+struct SolveStats {
+  int cycles = 0;       // The number of updates made to the guess.
+  int evaluations = 0;  // The number of calls made for just the residuals.
+  int jacobians = 0;    // The number of calls made for the Jacobian.
+  bool converged = false;
+};
+std::ostream& operator<<(std::ostream& o, const SolveStats& s);
+
+// Is a dim x dim Jacobian with this many non-zeros big enough, and empty
+// enough, to be worth solving as a sparse matrix.
+bool IsSparse(int dim, int64_t nonzeros);
+
+// Find the update that solves jac * update = y.
+VXd NewtonStep(const MXd& jac, const VXd& y);
+
 // A NewtonRaphson solver.
 //
 // Takes a function that accepts a vector of size dim and returns
 // another vector of size dim with residual errors. The solver
 // seeks for an input that results in residual errors of zeros.
-VXd NewtonRaphson(SystemFunction fn, int dim, int count, double tol);
+VXd NewtonRaphson(SystemFunction fn, int dim, int count, double tol,
+                  SolveStats* stats = nullptr);
+
+// As above but using the Jacobian provided by the function rather than
+// finding it by finite differences.
+VXd NewtonRaphson(JacobianFunction fn, int dim, int count, double tol,
+                  SolveStats* stats = nullptr);
+
+// As above but starting from the given guess rather than zeros.
+VXd NewtonRaphson(JacobianFunction fn, VXd start, int count, double tol,
+                  SolveStats* stats = nullptr);
+
+// As above but with a sparse Jacobian. Its pattern is analyzed once and
+// then only re-factored each cycle.
+VXd NewtonRaphson(SparseJacobianFunction fn, VXd start, int count,
+                  double tol, SolveStats* stats = nullptr);
+
+// A Broyden quasi-Newton solver.
+//
+// Like NewtonRaphson but, rather than getting a new Jacobian every cycle,
+// the last one is adjusted by a rank-one update based on the change in
+// the residuals. The Jacobian is only re-evaluated if a cycle fails to
+// reduce the residual errors.
+VXd Broyden(JacobianFunction fn, int dim, int count, double tol,
+            SolveStats* stats = nullptr);
+VXd Broyden(JacobianFunction fn, VXd start, int count, double tol,
+            SolveStats* stats = nullptr);
 
 }  // namespace tbd
 
@@ -28,8 +28,10 @@
 #include "tbd/newton_raphson.h"
 
 #include <cmath>
+#include <vector>
 
 #include "Eigen/Core"
+#include "Eigen/SparseCore"
 #include "absl/log/check.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -104,4 +106,209 @@ INSTANTIATE_TEST_SUITE_P(  //
                },
                /*dim=*/2, /*count=*/10, /*tol=*/1e-4}));
 
+TEST(NewtonRaphson, Jacobian) {
+  int calls = 0, jacs = 0;
+  JacobianFunction fn = [&calls, &jacs](const VXd& d, MXd* jac) {
+    CHECK(d.size() == 2);
+    calls++;
+    VXd r(2);
+    r << std::pow(2, d[0]) + (d[1] * d[1] * d[1] + d[1] * 10) / 2 - 16,
+        d[0] * 2 + d[1] * 3 - 8;
+    if (jac != nullptr) {
+      jacs++;
+      *jac << std::log(2) * std::pow(2, d[0]), (3 * d[1] * d[1] + 10) / 2,  //
+          2, 3;
+    }
+    return r;
+  };
+
+  SolveStats stats;
+  auto res =
+      NewtonRaphson(fn, /*dim=*/2, /*count=*/10, /*tol=*/1e-4, &stats);
+  EXPECT_THAT(res, ElementsAre(DoubleNear(1, 1e-5), DoubleNear(2, 1e-5)));
+  // Each cycle takes one pass, which also gives the residuals checked for
+  // convergence. Only the final check is extra.
+  EXPECT_EQ(calls, jacs);
+  EXPECT_EQ(stats.jacobians, stats.cycles + 1) << stats;
+  EXPECT_EQ(stats.evaluations, 0) << stats;
+
+  // Starting at the root takes no steps.
+  stats = SolveStats{};
+  res = NewtonRaphson(fn, res, /*count=*/10, /*tol=*/1e-4, &stats);
+  EXPECT_TRUE(stats.converged) << stats;
+  EXPECT_EQ(stats.cycles, 0) << stats;
+  EXPECT_EQ(stats.jacobians, 1) << stats;
+}
+
+TEST(NewtonRaphson, SingularStart) {
+  // The exact slope at zero is zero.
+  JacobianFunction fn = [](const VXd& d, MXd* jac) {
+    if (jac != nullptr) (*jac)(0, 0) = 2 * d[0];
+    return VXd::Constant(1, 1, d[0] * d[0] - 4);
+  };
+
+  SolveStats stats;
+  auto res = NewtonRaphson(fn, /*dim=*/1, /*count=*/10, /*tol=*/1e-6, &stats);
+  EXPECT_TRUE(stats.converged) << stats;
+  EXPECT_THAT(res, ElementsAre(DoubleNear(2, 1e-5)));
+}
+
+TEST(NewtonRaphson, NoFiniteStep) {
+  // Nothing at zero is finite.
+  JacobianFunction fn = [](const VXd& d, MXd* jac) {
+    if (jac != nullptr) (*jac)(0, 0) = -1 / (d[0] * d[0]);
+    return VXd::Constant(1, 1, 1 / d[0] - 0.5);
+  };
+
+  SolveStats stats;
+  auto res = NewtonRaphson(fn, /*dim=*/1, /*count=*/10, /*tol=*/1e-6, &stats);
+  EXPECT_TRUE(stats.converged) << stats;
+  EXPECT_THAT(res, ElementsAre(DoubleNear(2, 1e-5)));
+}
+
+TEST(NewtonRaphson, StepDense) {
+  MXd jac(2, 2);
+  jac << 5, 7,  //
+      2, 3;
+  VXd y(2);
+  y << 19, 8;
+  EXPECT_THAT(NewtonStep(jac, y),
+              ElementsAre(DoubleNear(1, 1e-12), DoubleNear(2, 1e-12)));
+}
+
+TEST(NewtonRaphson, IsSparse) {
+  EXPECT_FALSE(IsSparse(10, 10));
+  EXPECT_TRUE(IsSparse(200, 600));
+  EXPECT_FALSE(IsSparse(200, 20000));
+}
+
+TEST(NewtonRaphson, LargeSparse) {
+  // A chain of x[i]^3 + x[i] - x[i-1] = c[i] with a root at x[i] = 1.
+  constexpr int kDim = 200;
+  JacobianFunction fn = [](const VXd& x, MXd* jac) {
+    VXd r(x.size());
+    for (int i = 0; i < x.size(); i++) {
+      double prev = i > 0 ? x[i - 1] : 1;
+      r[i] = x[i] * x[i] * x[i] + x[i] - prev - 1;
+    }
+    if (jac != nullptr) {
+      jac->setZero();
+      for (int i = 0; i < x.size(); i++) {
+        (*jac)(i, i) = 3 * x[i] * x[i] + 1;
+        if (i > 0) (*jac)(i, i - 1) = -1;
+      }
+    }
+    return r;
+  };
+
+  auto res = NewtonRaphson(fn, /*dim=*/kDim, /*count=*/20, /*tol=*/1e-10);
+  EXPECT_LT((res - VXd::Ones(kDim)).array().abs().maxCoeff(), 1e-6);
+}
+
+TEST(NewtonRaphson, Sparse) {
+  // A chain of x[i]^3 + x[i] - x[i-1] = c[i] with a root at x[i] = 1.
+  constexpr int kDim = 200;
+  SparseJacobianFunction fn = [](const VXd& x, SMXd* jac) {
+    VXd r(x.size());
+    for (int i = 0; i < x.size(); i++) {
+      double prev = i > 0 ? x[i - 1] : 1;
+      r[i] = x[i] * x[i] * x[i] + x[i] - prev - 1;
+    }
+    if (jac != nullptr) {
+      std::vector<Eigen::Triplet<double>> t;
+      for (int i = 0; i < x.size(); i++) {
+        t.emplace_back(i, i, 3 * x[i] * x[i] + 1);
+        if (i > 0) t.emplace_back(i, i - 1, -1);
+      }
+      jac->setFromTriplets(t.begin(), t.end());
+    }
+    return r;
+  };
+
+  SolveStats stats;
+  auto res = NewtonRaphson(fn, VXd::Zero(kDim), /*count=*/20, /*tol=*/1e-10,
+                           &stats);
+  EXPECT_TRUE(stats.converged) << stats;
+  EXPECT_LT((res - VXd::Ones(kDim)).array().abs().maxCoeff(), 1e-6);
+}
+
+TEST(NewtonRaphson, SparseSingularStart) {
+  // x[i]^2 = 4, where the exact slope at zero is zero.
+  constexpr int kDim = 40;
+  SparseJacobianFunction fn = [](const VXd& x, SMXd* jac) {
+    if (jac != nullptr) {
+      std::vector<Eigen::Triplet<double>> t;
+      for (int i = 0; i < x.size(); i++) t.emplace_back(i, i, 2 * x[i]);
+      jac->setFromTriplets(t.begin(), t.end());
+    }
+    return VXd((x.array() * x.array() - 4).matrix());
+  };
+
+  SolveStats stats;
+  auto res = NewtonRaphson(fn, VXd::Zero(kDim), /*count=*/10, /*tol=*/1e-6,
+                           &stats);
+  EXPECT_TRUE(stats.converged) << stats;
+  EXPECT_LT((res - VXd::Constant(kDim, 2)).array().abs().maxCoeff(), 1e-5);
+}
+
+TEST(Broyden, TwoDim) {
+  JacobianFunction fn = [](const VXd& d, MXd* jac) {
+    VXd r(2);
+    r << std::pow(2, d[0]) + (d[1] * d[1] * d[1] + d[1] * 10) / 2 - 16,
+        d[0] * 2 + d[1] * 3 - 8;
+    if (jac != nullptr) {
+      *jac << std::log(2) * std::pow(2, d[0]), (3 * d[1] * d[1] + 10) / 2,  //
+          2, 3;
+    }
+    return r;
+  };
+
+  SolveStats stats;
+  auto res = Broyden(fn, /*dim=*/2, /*count=*/50, /*tol=*/1e-6, &stats);
+  EXPECT_THAT(res, ElementsAre(DoubleNear(1, 1e-5), DoubleNear(2, 1e-5)));
+  EXPECT_TRUE(stats.converged);
+  EXPECT_EQ(stats.evaluations, stats.cycles);
+}
+
+TEST(Broyden, SingularStart) {
+  JacobianFunction fn = [](const VXd& d, MXd* jac) {
+    if (jac != nullptr) (*jac)(0, 0) = 2 * d[0];
+    return VXd::Constant(1, 1, d[0] * d[0] - 4);
+  };
+
+  SolveStats stats;
+  auto res = Broyden(fn, /*dim=*/1, /*count=*/50, /*tol=*/1e-6, &stats);
+  EXPECT_TRUE(stats.converged) << stats;
+  EXPECT_THAT(res, ElementsAre(DoubleNear(2, 1e-5)));
+}
+
+TEST(Broyden, FewerJacobians) {
+  // A mildly non-linear system: x[i] + x[i]^3 / 100 - x[i-1] / 2 = c[i]
+  // with a root at x[i] = 1.
+  JacobianFunction fn = [](const VXd& x, MXd* jac) {
+    VXd r(x.size());
+    for (int i = 0; i < x.size(); i++) {
+      double prev = i > 0 ? x[i - 1] : 1;
+      r[i] = x[i] + x[i] * x[i] * x[i] / 100 - prev / 2 - 0.51;
+    }
+    if (jac != nullptr) {
+      jac->setZero();
+      for (int i = 0; i < x.size(); i++) {
+        (*jac)(i, i) = 1 + 3 * x[i] * x[i] / 100;
+        if (i > 0) (*jac)(i, i - 1) = -0.5;
+      }
+    }
+    return r;
+  };
+
+  SolveStats newton, broyden;
+  auto n = NewtonRaphson(fn, /*dim=*/50, /*count=*/20, /*tol=*/1e-8, &newton);
+  auto b = Broyden(fn, /*dim=*/50, /*count=*/50, /*tol=*/1e-8, &broyden);
+  EXPECT_TRUE(newton.converged) << newton;
+  EXPECT_TRUE(broyden.converged) << broyden;
+  EXPECT_LT((n - VXd::Ones(50)).array().abs().maxCoeff(), 1e-6);
+  EXPECT_LT((b - VXd::Ones(50)).array().abs().maxCoeff(), 1e-6);
+  EXPECT_LT(broyden.jacobians, newton.jacobians) << broyden << " vs " << newton;
+}
+
 }  // namespace tbd
\ No newline at end of file
@@ -34,55 +34,55 @@
 namespace tbd {
 
 bool DirectEvaluate::operator()(const OpAdd& o) {
-  if (std::isnan(o.a->value) || std::isnan(o.b->value)) return false;
-  o.r->value = o.a->value + o.b->value;
+  if (std::isnan(V(o.a)) || std::isnan(V(o.b))) return false;
+  V(o.r) = V(o.a) + V(o.b);
   return true;
 }
 
 bool DirectEvaluate::operator()(const OpSub& o) {
-  if (std::isnan(o.a->value) || std::isnan(o.b->value)) return false;
-  o.r->value = o.a->value - o.b->value;
+  if (std::isnan(V(o.a)) || std::isnan(V(o.b))) return false;
+  V(o.r) = V(o.a) - V(o.b);
   return true;
 }
 
 bool DirectEvaluate::operator()(const OpMul& o) {
-  if (std::isnan(o.a->value) || std::isnan(o.b->value)) return false;
-  o.r->value = o.a->value * o.b->value;
+  if (std::isnan(V(o.a)) || std::isnan(V(o.b))) return false;
+  V(o.r) = V(o.a) * V(o.b);
   return true;
 }
 
 bool DirectEvaluate::operator()(const OpDiv& o) {
-  if (std::isnan(o.a->value) || std::isnan(o.b->value)) return false;
-  o.r->value = o.a->value / o.b->value;
+  if (std::isnan(V(o.a)) || std::isnan(V(o.b))) return false;
+  V(o.r) = V(o.a) / V(o.b);
   return true;
 }
 
 bool DirectEvaluate::operator()(const OpNeg& o) {
-  if (std::isnan(o.a->value)) return false;
-  o.r->value = -o.a->value;
+  if (std::isnan(V(o.a))) return false;
+  V(o.r) = -V(o.a);
   return true;
 }
 
 bool DirectEvaluate::operator()(const OpExp& o) {
-  if (std::isnan(o.b->value)) return false;
-  o.r->value = std::pow(o.b->value, o.e);
+  if (std::isnan(V(o.b))) return false;
+  V(o.r) = std::pow(V(o.b), o.e);
   return true;
 }
 
 bool DirectEvaluate::operator()(const OpAssign& o) {
-  if (std::isnan(o.s->value)) return false;
-  o.d->value = o.s->value;
+  if (std::isnan(V(o.s))) return false;
+  V(o.d) = V(o.s);
   return true;
 }
 
 bool DirectEvaluate::operator()(const OpLoad& o) {
-  o.n->value = (*in_)[o.i];
+  V(o.n) = (*in_)[o.i];
   return true;
 }
 
 bool DirectEvaluate::operator()(const OpCheck& o) {
-  if (std::isnan(o.a->value) || std::isnan(o.b->value)) return false;
-  (*out_)[o.i] = o.a->value - o.b->value;
+  if (std::isnan(V(o.a)) || std::isnan(V(o.b))) return false;
+  (*out_)[o.i] = V(o.a) - V(o.b);
   return true;
 }
 
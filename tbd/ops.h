@@ -57,7 +57,7 @@ class OpI {
 
 class OpAdd final : public OpI {
   ABSL_MUST_USE_RESULT bool Visit(VisitOps*) const override;
-  Loc location() const override { return r->node->location(); }
+  Loc location() const override { return r->meta->node->location(); }
 
  public:
   OpAdd(ExpP r_, ExpP a_, ExpP b_) : r(r_), a(a_), b(b_) {}
@@ -67,7 +67,7 @@ class OpAdd final : public OpI {
 
 class OpSub final : public OpI {
   ABSL_MUST_USE_RESULT bool Visit(VisitOps*) const override;
-  Loc location() const override { return r->node->location(); }
+  Loc location() const override { return r->meta->node->location(); }
 
  public:
   OpSub(ExpP r_, ExpP a_, ExpP b_) : r(r_), a(a_), b(b_) {}
@@ -77,7 +77,7 @@ class OpSub final : public OpI {
 
 class OpMul final : public OpI {
   ABSL_MUST_USE_RESULT bool Visit(VisitOps*) const override;
-  Loc location() const override { return r->node->location(); }
+  Loc location() const override { return r->meta->node->location(); }
 
  public:
   OpMul(ExpP r_, ExpP a_, ExpP b_) : r(r_), a(a_), b(b_) {}
@@ -87,7 +87,7 @@ class OpMul final : public OpI {
 
 class OpDiv final : public OpI {
   ABSL_MUST_USE_RESULT bool Visit(VisitOps*) const override;
-  Loc location() const override { return r->node->location(); }
+  Loc location() const override { return r->meta->node->location(); }
 
  public:
   OpDiv(ExpP r_, ExpP a_, ExpP b_) : r(r_), a(a_), b(b_) {}
@@ -97,7 +97,7 @@ class OpDiv final : public OpI {
 
 class OpNeg final : public OpI {
   ABSL_MUST_USE_RESULT bool Visit(VisitOps*) const override;
-  Loc location() const override { return r->node->location(); }
+  Loc location() const override { return r->meta->node->location(); }
 
  public:
   OpNeg(ExpP r_, ExpP a_) : r(r_), a(a_) {}
@@ -107,7 +107,7 @@ class OpNeg final : public OpI {
 
 class OpExp final : public OpI {
   ABSL_MUST_USE_RESULT bool Visit(VisitOps*) const override;
-  Loc location() const override { return r->node->location(); }
+  Loc location() const override { return r->meta->node->location(); }
 
  public:
   OpExp(ExpP r_, ExpP b_, double e_) : r(r_), b(b_), e(e_) {}
@@ -118,7 +118,7 @@ class OpExp final : public OpI {
 
 class OpAssign final : public OpI {
   ABSL_MUST_USE_RESULT bool Visit(VisitOps*) const override;
-  Loc location() const override { return d->node->location(); }
+  Loc location() const override { return d->meta->node->location(); }
 
  public:
   OpAssign(ExpP d_, ExpP s_) : d(d_), s(s_) {}
@@ -128,7 +128,7 @@ class OpAssign final : public OpI {
 
 class OpLoad final : public OpI {
   ABSL_MUST_USE_RESULT bool Visit(VisitOps*) const override;
-  Loc location() const override { return n->node->location(); }
+  Loc location() const override { return n->meta->node->location(); }
 
  public:
   OpLoad(ExpP n_, int i_) : n(n_), i(i_) {}
@@ -172,11 +172,11 @@ class VisitOps {
 
 ////////////////////////////////////////////
 
-// Direct in place evaluation.
+// Direct evaluation into a frame of values (by SemanticDocument::Exp::index).
 class DirectEvaluate final : public VisitOps {
  public:
-  DirectEvaluate(Eigen::VectorXd* in, Eigen::VectorXd* out)
-      : in_(in), out_(out) {}
+  DirectEvaluate(double* frame, Eigen::VectorXd* in, Eigen::VectorXd* out)
+      : v_(frame), in_(in), out_(out) {}
 
   ABSL_MUST_USE_RESULT bool operator()(const OpAdd&) override;
   ABSL_MUST_USE_RESULT bool operator()(const OpSub&) override;
@@ -189,6 +189,9 @@ class DirectEvaluate final : public VisitOps {
   ABSL_MUST_USE_RESULT bool operator()(const OpCheck&) override;
 
  private:
+  double& V(const SemanticDocument::Exp* e) { return v_[e->index]; }
+
+  double* v_;
   Eigen::VectorXd* in_;
   Eigen::VectorXd* out_;
 };
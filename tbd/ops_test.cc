@@ -28,6 +28,7 @@
 #include "tbd/ops.h"
 
 #include <cmath>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -38,14 +39,20 @@ namespace tbd {
 namespace {
 
 TEST(TestOp, VisitAdd) {
-  SemanticDocument::Exp R, A, B;
-  OpAdd a(&R, &A, &B);
-  EXPECT_FALSE(a.VisitOp(DirectEvaluate{nullptr, nullptr}.as_ptr()));
+  SemanticDocument doc;
+  auto* R = doc.GetNode();
+  auto* A = doc.GetNode();
+  auto* B = doc.GetNode();
+  OpAdd a(R, A, B);
+  std::vector<double> frame = doc.Values();
+  DirectEvaluate eval{frame.data(), nullptr, nullptr};
+  EXPECT_FALSE(a.VisitOp(&eval));
 
-  A.value = 1;
-  B.value = 2;
-  EXPECT_TRUE(a.VisitOp(DirectEvaluate{nullptr, nullptr}.as_ptr()));
-  ASSERT_FALSE(std::isnan(R.value));
+  frame[A->index] = 1;
+  frame[B->index] = 2;
+  EXPECT_TRUE(a.VisitOp(&eval));
+  ASSERT_FALSE(std::isnan(frame[R->index]));
+  EXPECT_TRUE(std::isnan(R->value));  // Only the frame is changed.
 }
 
 }  // namespace
@@ -27,12 +27,24 @@
 
 #include "tbd/parser.h"
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "absl/flags/flag.h"
+#include "absl/log/check.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "parser/parser_support.h"
 #include "tbd/gen.lexer.h"
 
@@ -48,27 +60,140 @@ int tbdlex(tbd_parser::parser::semantic_type* stype,
 
 namespace tbd {
 
-int Parse(std::string filename, absl::string_view file,
-          std::function<void(const std::string&)> outp, Document* doc) {
+namespace {
+// Don't bother splitting the input into chunks smaller than this.
+constexpr size_t kMinChunk = 256 << 10;
+
+// Parse whatever the scanner has been set up to read.
+int RunParser(std::string* filename, tbdscan_t scanner, int line,
+              std::function<void(const std::string&)> outp, Document* doc) {
   parser_support::ScannerExtra extra;
-  extra.filename = &filename;
+  extra.filename = filename;
   extra.outp = outp;
 
-  tbdscan_t scanner;
-  tbdlex_init(&scanner);
-  auto buffer_state = tbd_scan_bytes(file.data(), file.size(), scanner);
-  tbdset_lineno(1, scanner);
+  tbdset_lineno(line, scanner);
   tbdset_column(1, scanner);
   tbdset_extra(&extra, scanner);
-  int ret = 0;
-  {
-    tbd_parser::parser p{scanner, doc, &extra};
+  tbd_parser::parser p{scanner, doc, &extra};
 #if defined(YYDEBUG) && YYDEBUG
-    p.set_debug_level(absl::GetFlag(FLAGS_parser_debug));
-    p.set_debug_stream(std::cout);
+  p.set_debug_level(absl::GetFlag(FLAGS_parser_debug));
+  p.set_debug_stream(std::cout);
 #endif
-    ret = p.parse();
+  return p.parse();
+}
+
+// Parse a copy of some text that starts at the given line.
+int ParseCopy(std::string* filename, absl::string_view text, int line,
+              std::function<void(const std::string&)> outp, Document* doc) {
+  tbdscan_t scanner;
+  tbdlex_init(&scanner);
+  auto buffer_state = tbd_scan_bytes(text.data(), text.size(), scanner);
+  int ret = RunParser(filename, scanner, line, outp, doc);
+  tbd_delete_buffer(buffer_state, scanner);
+  tbdlex_destroy(scanner);
+  return ret;
+}
+
+// Is the last thing on a line, other than comments and white space, a ';'?
+// Every statement ends with a ';' and nothing else does, so what follows
+// such a line is the start of a statement.
+bool EndsStatement(absl::string_view line) {
+  line = absl::StripTrailingAsciiWhitespace(line.substr(0, line.find("//")));
+  return absl::EndsWith(line, ";");
+}
+
+int ParseChunks(std::string* filename, absl::string_view file,
+                const std::vector<size_t>& starts,
+                std::function<void(const std::string&)> outp, Document* doc) {
+  struct Chunk {
+    absl::string_view text;
+    int line;
+    std::unique_ptr<Document> doc;
+    std::vector<std::string> errors;
+    int ret = 0;
+  };
+  std::vector<Chunk> chunks(starts.size());
+  int line = 1;
+  for (size_t i = 0; i < starts.size(); i++) {
+    size_t end = (i + 1 < starts.size()) ? starts[i + 1] : file.size();
+    auto& c = chunks[i];
+    c.text = file.substr(starts[i], end - starts[i]);
+    c.line = line;
+    c.doc = absl::make_unique<Document>();
+    line += std::count(c.text.begin(), c.text.end(), '\n');
+  }
+
+  auto parse = [filename](Chunk* c) {
+    c->ret = ParseCopy(
+        filename, c->text, c->line,
+        [c](const std::string& e) { c->errors.push_back(e); }, c->doc.get());
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < chunks.size(); i++) {
+    workers.emplace_back(parse, &chunks[i]);
   }
+  parse(&chunks[0]);
+  for (auto& w : workers) w.join();
+
+  // Put the pieces together in order, stopping where parsing it all in one
+  // go would have.
+  for (auto& c : chunks) {
+    for (const auto& e : c.errors) outp(e);
+    if (c.ret != 0) return c.ret;
+    doc->Merge(std::move(c.doc));
+  }
+  return 0;
+}
+}  // namespace
+
+int ChunkCount(size_t size, int threads) {
+  if (threads == 0) threads = std::thread::hardware_concurrency();
+  return std::max<size_t>(1, std::min<size_t>(threads, size / kMinChunk));
+}
+
+std::vector<size_t> SplitStatements(absl::string_view file, int count) {
+  std::vector<size_t> ret = {0};
+  for (int i = 1; i < count; i++) {
+    // Start from the line the even split would be in and find the first
+    // line that ends a statement. Split after that.
+    size_t at = std::max(file.size() * i / count, ret.back());
+    size_t b = (at == 0) ? file.npos : file.rfind('\n', at - 1);
+    b = (b == file.npos) ? 0 : b + 1;
+    size_t e = file.find('\n', b);
+    while (e != file.npos && !EndsStatement(file.substr(b, e - b))) {
+      b = e + 1;
+      e = file.find('\n', b);
+    }
+    if (e == file.npos || e + 1 == file.size()) break;
+    ret.push_back(e + 1);
+  }
+  return ret;
+}
+
+int Parse(std::string filename, absl::string_view file,
+          std::function<void(const std::string&)> outp, Document* doc,
+          int threads) {
+  const int count = ChunkCount(file.size(), threads);
+  if (count > 1) {
+    return ParseChunks(&filename, file, SplitStatements(file, count), outp,
+                       doc);
+  }
+  return ParseCopy(&filename, file, 1, outp, doc);
+}
+
+int ParseBuffer(std::string filename, absl::Span<char> buffer,
+                std::function<void(const std::string&)> outp, Document* doc) {
+  if (buffer.size() < 2 || buffer[buffer.size() - 1] != '\0' ||
+      buffer[buffer.size() - 2] != '\0') {
+    outp(absl::StrCat(filename, ": buffer isn't terminated by two NULs"));
+    return 1;
+  }
+
+  tbdscan_t scanner;
+  tbdlex_init(&scanner);
+  auto buffer_state = tbd_scan_buffer(buffer.data(), buffer.size(), scanner);
+  CHECK(buffer_state != nullptr);
+  int ret = RunParser(&filename, scanner, 1, outp, doc);
   tbd_delete_buffer(buffer_state, scanner);
   tbdlex_destroy(scanner);
   return ret;
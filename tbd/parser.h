@@ -30,14 +30,40 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "tbd/ast.h"
 
 namespace tbd {
 
+// Parse a file into a document.
+//
+// Given more than one thread (or 0 for one per core), large inputs are split
+// into chunks between statements and the chunks are parsed at the same time.
+// The resulting document and any errors are the same either way.
 int Parse(std::string filename, absl::string_view file,
-          std::function<void(const std::string&)> oupt, Document* doc);
+          std::function<void(const std::string&)> oupt, Document* doc,
+          int threads = 1);
+
+// Parse a buffer in place rather than from a copy. The buffer must end with
+// two NULs (which aren't part of the input) and is written to while it's
+// being scanned, but is left as it was.
+//
+// This is always done on one thread: each chunk would need its own two NULs
+// and there is no room for them between the chunks. Use Parse to parse in
+// parallel, which works from copies of the chunks.
+int ParseBuffer(std::string filename, absl::Span<char> buffer,
+                std::function<void(const std::string&)> oupt, Document* doc);
+
+// The number of chunks Parse splits a file of the given size into.
+int ChunkCount(size_t size, int threads);
+
+// Find where to split a file into about count chunks that can each be
+// parsed on their own. The result is the offset each chunk starts at, the
+// first always being 0.
+std::vector<size_t> SplitStatements(absl::string_view file, int count);
 
 }  // namespace tbd
 
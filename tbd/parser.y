@@ -42,7 +42,6 @@ void parser::error(tbd_parser::location const& loc, std::string const& msg) {
 }
 
 using absl::WrapUnique;
-using absl::make_unique;
 
 using tbd::Join;
 using tbd::Define;
@@ -68,12 +67,28 @@ int tbd_parserlex(tbd_parser::parser::semantic_type* o,
 }  // namespace
 
 %}
+%code requires {
+#include <cstddef>
+#include <string>
+
+namespace tbd {
+// The text of a token. This points into the buffer being scanned rather
+// than being a copy so it's only good until that buffer goes away.
+struct TokenText {
+  const char* data;
+  size_t size;
+
+  std::string str() const { return std::string(data, size); }
+};
+}  // namespace tbd
+}
+
 %define api.prefix {tbd_parser}
 %param {tbdscan_t scanner}
 %parse-param { tbd::Document *result }
 %parse-param { parser_support::ScannerExtra* extra }
 
-%token DEF;
+%token DEF HINT;
 %token NUM ID INT;
 
 %type <str> ID;
@@ -90,25 +105,28 @@ int tbd_parserlex(tbd_parser::parser::semantic_type* o,
   tbd::UnitExp::UnitT* unit_t;
   tbd::Define* def;
   tbd::Specification* spec;
+  tbd::Hint* hint;
   tbd::UnitDef* unit_def;
 
-  std::string* str;
+  tbd::TokenText str;
   double fp;
   int32_t i;
 }
 // Define destructor for things that aren't pointers or are not new'ed.
-%destructor {  } <i> <fp> <doc>;
+// Nodes are owned by the Document (see Document::New).
+%destructor {  } <str> <i> <fp> <doc> <exp> <lit> <equal> <unit> <def> <spec> <hint> <unit_def>;
 %destructor { delete $$; } <*>;
 
 %type <doc> input;
 
 %type <exp> AddExp ExpExp MulExp PriExp;
-%type <lit> Num;
+%type <lit> Num Guess;
 %type <equal> Equ;
 %type <unit> Unit;
 %type <unit_t> UnitT;
 %type <def> Def;
 %type <spec> Spec;
+%type <hint> Hint;
 %type <unit_def> DefUnit;
 %type <i> Int;
 
@@ -116,10 +134,11 @@ int tbd_parserlex(tbd_parser::parser::semantic_type* o,
 
 %start input;
 
-input : input Def     { ($$ = $1)->AddDefinition(WrapUnique($2)); }
-      | input Spec    { ($$ = $1)->AddSpecification(WrapUnique($2)); }
-      | input DefUnit { ($$ = $1)->AddUnitDefinition(WrapUnique($2)); }
-      | input Equ     { ($$ = $1)->AddEquality(WrapUnique($2)); }
+input : input Def     { ($$ = $1)->AddDefinition($2); }
+      | input Spec    { ($$ = $1)->AddSpecification($2); }
+      | input Hint    { ($$ = $1)->AddHint($2); }
+      | input DefUnit { ($$ = $1)->AddUnitDefinition($2); }
+      | input Equ     { ($$ = $1)->AddEquality($2); }
       |               { $$ = result; }
       ;
 
@@ -127,53 +146,62 @@ Int : INT { $$ = $1; }
     | '1' { $$ = 1;  }
     ;
 
-Num : NUM { $$ = new LiteralValue(@1, $1); }
-    | Int { $$ = new LiteralValue(@1, $1); }
+Num : NUM { $$ = result->New<LiteralValue>(@1, $1); }
+    | Int { $$ = result->New<LiteralValue>(@1, $1); }
     ;
 
 Unit : Unit '*' UnitT  { ($$ = $1)->Mul(WrapUnique($3)); }
      | Unit '/' UnitT  { ($$ = $1)->Div(WrapUnique($3)); }
-     | UnitT           { ($$ = new UnitExp(@1))->Mul(WrapUnique($1)); }
-     | '1'             { ($$ = new UnitExp(@1)); }
+     | UnitT           { ($$ = result->New<UnitExp>(@1))->Mul(WrapUnique($1)); }
+     | '1'             { ($$ = result->New<UnitExp>(@1)); }
      ;
 
-UnitT : ID              { $$ = new UnitExp::UnitT{std::move(*WrapUnique($1)), 1, @1}; }
-      | ID '^' Int      { $$ = new UnitExp::UnitT{std::move(*WrapUnique($1)), $3, Join(@1, @3)}; }
-      | ID '^' '-' Int  { $$ = new UnitExp::UnitT{std::move(*WrapUnique($1)), -$4, Join(@1, @4)}; }
+UnitT : ID              { $$ = new UnitExp::UnitT{$1.str(), 1, @1}; }
+      | ID '^' Int      { $$ = new UnitExp::UnitT{$1.str(), $3, Join(@1, @3)}; }
+      | ID '^' '-' Int  { $$ = new UnitExp::UnitT{$1.str(), -$4, Join(@1, @4)}; }
       ;
 
-Def : ID DEF Num ';'              { $$ = new Define(Join(@1, @4), WrapUnique($1), WrapUnique($3), make_unique<UnitExp>(@4)); }
-    | ID DEF Num '[' ']' ';'      { $$ = new Define(Join(@1, @6), WrapUnique($1), WrapUnique($3), make_unique<UnitExp>(@4)); }
-    | ID DEF Num '[' Unit ']' ';' { $$ = new Define(Join(@1, @7), WrapUnique($1), WrapUnique($3), WrapUnique($5)); }
+Def : ID DEF Num ';'              { $$ = result->New<Define>(Join(@1, @4), $1.str(), $3, result->New<UnitExp>(@4)); }
+    | ID DEF Num '[' ']' ';'      { $$ = result->New<Define>(Join(@1, @6), $1.str(), $3, result->New<UnitExp>(@4)); }
+    | ID DEF Num '[' Unit ']' ';' { $$ = result->New<Define>(Join(@1, @7), $1.str(), $3, $5); }
     ;
 
-Spec : ID DEF '[' Unit ']' ';' { $$ = new tbd::Specification(Join(@1, @6), WrapUnique($1), WrapUnique($4)); }
-     | ID DEF '[' ']' ';'      { $$ = new tbd::Specification(Join(@1, @5), WrapUnique($1), make_unique<UnitExp>(@3));}
+Spec : ID DEF '[' Unit ']' ';' { $$ = result->New<tbd::Specification>(Join(@1, @6), $1.str(), $4); }
+     | ID DEF '[' ']' ';'      { $$ = result->New<tbd::Specification>(Join(@1, @5), $1.str(), result->New<UnitExp>(@3));}
+     ;
+
+Hint : ID HINT Guess ';'              { $$ = result->New<tbd::Hint>(Join(@1, @4), $1.str(), $3, result->New<UnitExp>(@4)); }
+     | ID HINT Guess '[' ']' ';'      { $$ = result->New<tbd::Hint>(Join(@1, @6), $1.str(), $3, result->New<UnitExp>(@4)); }
+     | ID HINT Guess '[' Unit ']' ';' { $$ = result->New<tbd::Hint>(Join(@1, @7), $1.str(), $3, $5); }
      ;
 
-DefUnit : '[' ID ']' DEF Num '[' Unit ']' ';' { $$ = new UnitDef(Join(@1, @9), WrapUnique($2), WrapUnique($5), WrapUnique($7)); }
+Guess : Num      { $$ = $1; }
+      | '-' Num  { $2->Negate(); $2->set_location(Join(@1, @2)); $$ = $2; }
+      ;
+
+DefUnit : '[' ID ']' DEF Num '[' Unit ']' ';' { $$ = result->New<UnitDef>(Join(@1, @9), $2.str(), $5, $7); }
         ;
 
-Equ : AddExp '=' AddExp ';' { $$ = new Equality(@4, WrapUnique($1), WrapUnique($3)); }
+Equ : AddExp '=' AddExp ';' { $$ = result->New<Equality>(@4, $1, $3); }
     ;
 
 ExpExp : PriExp          { $$ = $1; }
-       | PriExp '^' Int  { $$ = new PowerExp(@3, WrapUnique($1), $3); }
+       | PriExp '^' Int  { $$ = result->New<PowerExp>(@3, $1, $3); }
        ;
 
-MulExp : MulExp '*' ExpExp  { $$ = new ProductExp(WrapUnique($1), WrapUnique($3)); }
-       | MulExp '/' ExpExp  { $$ = new QuotientExp(WrapUnique($1), WrapUnique($3)); }
+MulExp : MulExp '*' ExpExp  { $$ = result->New<ProductExp>($1, $3); }
+       | MulExp '/' ExpExp  { $$ = result->New<QuotientExp>($1, $3); }
        | ExpExp             { $$ = $1; }
        ;
 
-AddExp : AddExp '+' MulExp { $$ = new SumExp(WrapUnique($1), WrapUnique($3)); }
-       | AddExp '-' MulExp { $$ = new DifExp(WrapUnique($1), WrapUnique($3)); }
+AddExp : AddExp '+' MulExp { $$ = result->New<SumExp>($1, $3); }
+       | AddExp '-' MulExp { $$ = result->New<DifExp>($1, $3); }
        | MulExp            { $$ = $1; }
        ;
 
 PriExp : '(' AddExp ')'  { ($$ = $2)->set_location(Join(@1, @3)); }
        | Num             { $$ = $1; }
-       | ID              { $$ = new NamedValue(@1, WrapUnique($1)); }
+       | ID              { $$ = result->New<NamedValue>(@1, $1.str()); }
        | '+' PriExp      { ($$ = $2)->set_location(Join(@1, $2->location())); }
-       | '-' PriExp      { $$ = new NegativeExp(Join(@1, @2), WrapUnique($2)); }
+       | '-' PriExp      { $$ = result->New<NegativeExp>(Join(@1, @2), $2); }
        ;
\ No newline at end of file
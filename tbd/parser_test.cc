@@ -0,0 +1,162 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tbd/parser.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tbd/ast.h"
+
+namespace tbd {
+namespace {
+
+using testing::ElementsAre;
+
+TEST(SplitStatements, Lines) {
+  // Only split after a line that ends with a ';' that isn't in a comment.
+  absl::string_view file =
+      "a := 1 [m];\n"       // 0
+      "b = a +\n"           // 12
+      "  a; // x;\n"        // 20
+      "c = b; // ;\n"       // 31
+      "d = c // ;\n"        // 43
+      "  ;  \n"             // 54
+      "e = d;\n";           // 60
+  EXPECT_THAT(SplitStatements(file, 1), ElementsAre(0));
+  EXPECT_THAT(SplitStatements(file, 2), ElementsAre(0, 43));
+  EXPECT_THAT(SplitStatements(file, 4), ElementsAre(0, 31, 43, 60));
+  EXPECT_THAT(SplitStatements(file, 100),
+              ElementsAre(0, 12, 31, 43, 60));
+
+  // Nowhere to split.
+  EXPECT_THAT(SplitStatements("a = b;", 4), ElementsAre(0));
+  EXPECT_THAT(SplitStatements("", 4), ElementsAre(0));
+}
+
+TEST(Parse, Hint) {
+  Document doc;
+  ASSERT_EQ(Parse("hint", "a ~= -2.5 [km];\nb ~= 3;\nc ~= 1 [];\n",
+                  VisitNodesWithErrors::DefaultSink, &doc),
+            0);
+  ASSERT_EQ(doc.hints().size(), 3);
+  EXPECT_EQ(doc.hints()[0]->name(), "a");
+  EXPECT_EQ(doc.hints()[0]->value(), -2.5);
+  ASSERT_EQ(doc.hints()[0]->unit().bits().size(), 1);
+  EXPECT_EQ(doc.hints()[0]->unit().bits()[0].id, "km");
+  EXPECT_EQ(doc.hints()[1]->value(), 3);
+  EXPECT_TRUE(doc.hints()[1]->unit().bits().empty());
+  EXPECT_TRUE(doc.hints()[2]->unit().bits().empty());
+}
+
+// Something big enough to be split up.
+std::string BigFile() {
+  std::string ret;
+  for (int i = 0; ret.size() < (2 << 20); i++) {
+    absl::StrAppend(&ret, "x", i, " := ", i, " [m];  // x", i, ";\n",
+                    "y", i, " = x", i, " *\n   2;\n");
+  }
+  return ret;
+}
+
+// Everything, in order with locations.
+std::string Dump(const Document& doc) {
+  std::stringstream out;
+  for (const auto* d : doc.defines()) {
+    out << d->name() << " " << d->location() << "\n";
+  }
+  for (const auto* e : doc.equality()) out << e->location() << "\n";
+  return out.str();
+}
+
+TEST(Parse, Parallel) {
+  const std::string file = BigFile();
+  Document one, many;
+  ASSERT_EQ(Parse("big", file, VisitNodesWithErrors::DefaultSink, &one), 0);
+  ASSERT_EQ(Parse("big", file, VisitNodesWithErrors::DefaultSink, &many, 4), 0);
+
+  EXPECT_EQ(many.defines().size(), one.defines().size());
+  EXPECT_EQ(many.equality().size(), one.equality().size());
+  EXPECT_EQ(Dump(many), Dump(one));
+}
+
+TEST(ParseBuffer, InPlace) {
+  // Always one thread, however big the input.
+  const std::string file = BigFile();
+  std::vector<char> buffer(file.begin(), file.end());
+  buffer.resize(buffer.size() + 2, '\0');
+  const std::vector<char> before = buffer;
+
+  Document one, in_place;
+  ASSERT_EQ(Parse("big", file, VisitNodesWithErrors::DefaultSink, &one), 0);
+  ASSERT_EQ(ParseBuffer("big", absl::MakeSpan(buffer),
+                        VisitNodesWithErrors::DefaultSink, &in_place),
+            0);
+  EXPECT_EQ(Dump(in_place), Dump(one));
+  EXPECT_TRUE(buffer == before);  // Left as it was.
+
+  EXPECT_EQ(ChunkCount(file.size(), 1), 1);
+  EXPECT_GT(ChunkCount(file.size(), 4), 1);
+  EXPECT_EQ(ChunkCount(100, 4), 1);
+}
+
+TEST(ParseBuffer, Unterminated) {
+  std::vector<char> buffer = {'a', ';', '\0'};
+  std::vector<std::string> errors;
+  Document doc;
+  EXPECT_NE(ParseBuffer("bad", absl::MakeSpan(buffer),
+                        [&](const std::string& e) { errors.push_back(e); },
+                        &doc),
+            0);
+  EXPECT_THAT(errors, ElementsAre("bad: buffer isn't terminated by two NULs"));
+}
+
+TEST(Parse, ParallelError) {
+  // The error is in the last chunk. Only it should be reported.
+  const std::string file = absl::StrCat(BigFile(), "z := ;\n", BigFile());
+  std::vector<std::string> one_errors, many_errors;
+  Document one, many;
+  int one_ret = Parse(
+      "big", file,
+      [&](const std::string& e) { one_errors.push_back(e); }, &one);
+  int many_ret = Parse(
+      "big", file,
+      [&](const std::string& e) { many_errors.push_back(e); }, &many, 4);
+  EXPECT_NE(one_ret, 0);
+  EXPECT_EQ(many_ret, one_ret);
+  EXPECT_FALSE(one_errors.empty());
+  EXPECT_EQ(many_errors, one_errors);
+}
+
+}  // namespace
+}  // namespace tbd
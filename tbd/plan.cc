@@ -0,0 +1,550 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tbd/plan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "tbd/ops.h"
+#include "tbd/semantic.h"
+
+namespace tbd {
+
+class CompilePlan final : public VisitOps {
+ public:
+  CompilePlan(Plan* plan) : plan_(plan) {}
+
+  // Only solve code may load guesses and check them.
+  bool Compile(const std::vector<std::unique_ptr<OpI>>& ops, bool solve,
+               std::vector<Plan::Inst>* code) {
+    code_ = code;
+    solve_ = solve;
+    code_->reserve(ops.size());
+    for (const auto& op : ops) {
+      if (!op->VisitOp(this)) return false;
+    }
+    return true;
+  }
+
+ private:
+  using Code = Plan::Code;
+
+  int Slot(SemanticDocument::Exp* e) {
+    auto it = plan_->slot_.emplace(e, plan_->slots_.size());
+    if (it.second) {
+      plan_->slots_.push_back(e->value);
+      plan_->index_.push_back(e->index);
+      plan_->computed_.push_back(false);
+    }
+    return it.first->second;
+  }
+
+  int Constant(double v) {
+    plan_->slots_.push_back(v);
+    plan_->index_.push_back(-1);
+    plan_->computed_.push_back(false);
+    return plan_->slots_.size() - 1;
+  }
+
+  bool Emit(Code c, int r, int a, int b) {
+    if (c != Code::kCheck) plan_->computed_[r] = true;
+    code_->push_back(Plan::Inst{c, r, a, b});
+    return true;
+  }
+
+  bool operator()(const OpAdd& o) override {
+    return Emit(Code::kAdd, Slot(o.r), Slot(o.a), Slot(o.b));
+  }
+  bool operator()(const OpSub& o) override {
+    return Emit(Code::kSub, Slot(o.r), Slot(o.a), Slot(o.b));
+  }
+  bool operator()(const OpMul& o) override {
+    return Emit(Code::kMul, Slot(o.r), Slot(o.a), Slot(o.b));
+  }
+  bool operator()(const OpDiv& o) override {
+    return Emit(Code::kDiv, Slot(o.r), Slot(o.a), Slot(o.b));
+  }
+  bool operator()(const OpNeg& o) override {
+    return Emit(Code::kNeg, Slot(o.r), Slot(o.a), 0);
+  }
+  bool operator()(const OpExp& o) override {
+    return Emit(Code::kExp, Slot(o.r), Slot(o.b), Constant(o.e));
+  }
+  bool operator()(const OpAssign& o) override {
+    return Emit(Code::kAssign, Slot(o.d), Slot(o.s), 0);
+  }
+  bool operator()(const OpLoad& o) override {
+    return solve_ && Emit(Code::kLoad, Slot(o.n), o.i, 0);
+  }
+  bool operator()(const OpCheck& o) override {
+    return solve_ && Emit(Code::kCheck, o.i, Slot(o.a), Slot(o.b));
+  }
+
+  Plan* plan_;
+  std::vector<Plan::Inst>* code_ = nullptr;
+  bool solve_ = false;
+};
+
+namespace {
+// Merge the sorted dependencies of b into those of a.
+bool Join(std::vector<int>* a, const std::vector<int>& b) {
+  const size_t size = a->size();
+  std::vector<int> ret;
+  ret.reserve(size + b.size());
+  std::set_union(a->begin(), a->end(), b.begin(), b.end(),
+                 std::back_inserter(ret));
+  std::swap(*a, ret);
+  return a->size() != size;
+}
+
+Plan::Sparsity FindSparsity(const std::vector<Plan::Inst>& code, int slots) {
+  using Code = Plan::Code;
+  std::vector<std::vector<int>> deps(slots);
+
+  // Slots are normally only set once, after what they are set from, so
+  // this only takes a second pass to confirm.
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (const auto& i : code) {
+      switch (i.code) {
+        case Code::kAdd:
+        case Code::kSub:
+        case Code::kMul:
+        case Code::kDiv:
+          changed |= Join(&deps[i.r], deps[i.a]);
+          changed |= Join(&deps[i.r], deps[i.b]);
+          break;
+        case Code::kNeg:
+        case Code::kExp:
+        case Code::kAssign:
+          changed |= Join(&deps[i.r], deps[i.a]);
+          break;
+        case Code::kLoad:
+          changed |= Join(&deps[i.r], {i.a});
+          break;
+        case Code::kCheck:
+          break;
+      }
+    }
+  }
+
+  Plan::Sparsity ret;
+  for (const auto& d : deps) {
+    ret.start.push_back(ret.deps.size());
+    ret.deps.insert(ret.deps.end(), d.begin(), d.end());
+  }
+  ret.start.push_back(ret.deps.size());
+
+  for (const auto& i : code) {
+    if (i.code != Code::kCheck) continue;
+    std::vector<int> cols = deps[i.a];
+    Join(&cols, deps[i.b]);
+    for (int c : cols) {
+      ret.rows.push_back(i.r);
+      ret.cols.push_back(c);
+    }
+  }
+  return ret;
+}
+}  // namespace
+
+Plan::Plan(const std::vector<std::unique_ptr<OpI>>& direct,
+           const std::vector<std::unique_ptr<OpI>>& solve) {
+  CompilePlan compile(this);
+  CHECK(compile.Compile(direct, /*solve=*/false, &direct_))
+      << "Direct ops can't load or check guesses";
+  CHECK(compile.Compile(solve, /*solve=*/true, &solve_));
+  sparsity_ = FindSparsity(solve_, slots_.size());
+}
+
+int Plan::Slot(const SemanticDocument::Exp* e) const {
+  auto it = slot_.find(e);
+  return it == slot_.end() ? -1 : it->second;
+}
+
+std::vector<int> Plan::Inputs() const {
+  std::vector<int> ret;
+  for (size_t i = 0; i < index_.size(); i++) {
+    if (index_[i] >= 0 && !computed_[i]) ret.push_back(index_[i]);
+  }
+  return ret;
+}
+
+std::vector<int> Plan::Outputs() const {
+  std::vector<int> ret;
+  for (size_t i = 0; i < index_.size(); i++) {
+    if (index_[i] >= 0 && computed_[i]) ret.push_back(index_[i]);
+  }
+  return ret;
+}
+
+std::vector<int> Plan::Solved() const {
+  std::vector<int> ret;
+  for (const auto& inst : solve_) {
+    if (inst.code != Code::kCheck && index_[inst.r] >= 0) {
+      ret.push_back(index_[inst.r]);
+    }
+  }
+  return ret;
+}
+
+std::vector<double> Plan::Reload(const std::vector<double>& frame) const {
+  std::vector<double> ret = slots_;
+  for (size_t i = 0; i < ret.size(); i++) {
+    if (index_[i] >= 0 && !computed_[i]) ret[i] = frame[index_[i]];
+  }
+  return ret;
+}
+
+void Plan::Store(const std::vector<double>& slots,
+                 std::vector<double>* frame) const {
+  CHECK(slots.size() == index_.size())
+      << slots.size() << "!=" << index_.size();
+  for (size_t i = 0; i < slots.size(); i++) {
+    if (index_[i] >= 0) (*frame)[index_[i]] = slots[i];
+  }
+}
+
+void Plan::Run(const std::vector<Inst>& code, double* v, const double* in,
+               double* out) {
+  // As with DirectEvaluate, an op with an unknown (NaN) input is skipped
+  // and leaves its result as it was.
+  auto known = [v](int s) { return !std::isnan(v[s]); };
+  for (const Inst& i : code) {
+    switch (i.code) {
+      case Code::kAdd:
+        if (known(i.a) && known(i.b)) v[i.r] = v[i.a] + v[i.b];
+        break;
+      case Code::kSub:
+        if (known(i.a) && known(i.b)) v[i.r] = v[i.a] - v[i.b];
+        break;
+      case Code::kMul:
+        if (known(i.a) && known(i.b)) v[i.r] = v[i.a] * v[i.b];
+        break;
+      case Code::kDiv:
+        if (known(i.a) && known(i.b)) v[i.r] = v[i.a] / v[i.b];
+        break;
+      case Code::kNeg:
+        if (known(i.a)) v[i.r] = -v[i.a];
+        break;
+      case Code::kExp:
+        if (known(i.a)) v[i.r] = std::pow(v[i.a], v[i.b]);
+        break;
+      case Code::kAssign:
+        if (known(i.a)) v[i.r] = v[i.a];
+        break;
+      case Code::kLoad:
+        v[i.r] = in[i.a];
+        break;
+      case Code::kCheck:
+        if (known(i.a) && known(i.b)) out[i.r] = v[i.a] - v[i.b];
+        break;
+    }
+  }
+}
+
+void Plan::RunTangent(const std::vector<Inst>& code, int dim, double* v,
+                      double* t, const double* in, double* out, double* jac) {
+  auto known = [v](int s) { return !std::isnan(v[s]); };
+  for (const Inst& i : code) {
+    // Not every code uses all of these, so only form them as needed.
+    auto tr = [&] { return t + i.r * dim; };
+    auto ta = [&] { return t + i.a * dim; };
+    auto tb = [&] { return t + i.b * dim; };
+    switch (i.code) {
+      case Code::kAdd: {
+        if (!known(i.a) || !known(i.b)) break;
+        double *r = tr(), *a = ta(), *b = tb();
+        for (int k = 0; k < dim; k++) r[k] = a[k] + b[k];
+        v[i.r] = v[i.a] + v[i.b];
+        break;
+      }
+      case Code::kSub: {
+        if (!known(i.a) || !known(i.b)) break;
+        double *r = tr(), *a = ta(), *b = tb();
+        for (int k = 0; k < dim; k++) r[k] = a[k] - b[k];
+        v[i.r] = v[i.a] - v[i.b];
+        break;
+      }
+      case Code::kMul: {
+        if (!known(i.a) || !known(i.b)) break;
+        double *r = tr(), *a = ta(), *b = tb();
+        for (int k = 0; k < dim; k++) r[k] = a[k] * v[i.b] + v[i.a] * b[k];
+        v[i.r] = v[i.a] * v[i.b];
+        break;
+      }
+      case Code::kDiv: {
+        if (!known(i.a) || !known(i.b)) break;
+        double *r = tr(), *a = ta(), *b = tb();
+        double q = v[i.a] / v[i.b];
+        for (int k = 0; k < dim; k++) r[k] = (a[k] - q * b[k]) / v[i.b];
+        v[i.r] = q;
+        break;
+      }
+      case Code::kNeg: {
+        if (!known(i.a)) break;
+        double *r = tr(), *a = ta();
+        for (int k = 0; k < dim; k++) r[k] = -a[k];
+        v[i.r] = -v[i.a];
+        break;
+      }
+      case Code::kExp: {
+        if (!known(i.a)) break;
+        double *r = tr(), *a = ta();
+        // The exponent is a constant so: d(a^b) = b * a^(b-1) * da
+        double d = v[i.b] * std::pow(v[i.a], v[i.b] - 1);
+        for (int k = 0; k < dim; k++) r[k] = d * a[k];
+        v[i.r] = std::pow(v[i.a], v[i.b]);
+        break;
+      }
+      case Code::kAssign: {
+        if (!known(i.a)) break;
+        double *r = tr(), *a = ta();
+        for (int k = 0; k < dim; k++) r[k] = a[k];
+        v[i.r] = v[i.a];
+        break;
+      }
+      case Code::kLoad: {
+        double* r = tr();
+        for (int k = 0; k < dim; k++) r[k] = (k == i.a) ? 1 : 0;
+        v[i.r] = in[i.a];
+        break;
+      }
+      case Code::kCheck: {
+        if (!known(i.a) || !known(i.b)) break;
+        double *a = ta(), *b = tb();
+        for (int k = 0; k < dim; k++) jac[i.r + k * dim] = a[k] - b[k];
+        out[i.r] = v[i.a] - v[i.b];
+        break;
+      }
+    }
+  }
+}
+
+namespace {
+// Set each of the tangents of slot r to f(da, db) where da and db are the
+// matching tangents of slots a and b (or zero if they don't have one).
+template <class F>
+void Combine(const Plan::Sparsity& s, double* t, int r, int a, int b, F f) {
+  const int* deps = s.deps.data();
+  int ia = s.start[a], ea = s.start[a + 1];
+  int ib = s.start[b], eb = s.start[b + 1];
+  for (int j = s.start[r]; j < s.start[r + 1]; j++) {
+    const int c = deps[j];
+    while (ia < ea && deps[ia] < c) ia++;
+    while (ib < eb && deps[ib] < c) ib++;
+    const double da = (ia < ea && deps[ia] == c) ? t[ia] : 0;
+    const double db = (ib < eb && deps[ib] == c) ? t[ib] : 0;
+    t[j] = f(da, db);
+  }
+}
+}  // namespace
+
+void Plan::RunSparseTangent(const std::vector<Inst>& code,
+                            const Sparsity& sparsity, double* v, double* t,
+                            const double* in, double* out, double* jac) {
+  auto known = [v](int s) { return !std::isnan(v[s]); };
+  const int* deps = sparsity.deps.data();
+  const int* start = sparsity.start.data();
+  int k = 0;  // The next Jacobian entry.
+  for (const Inst& i : code) {
+    switch (i.code) {
+      case Code::kAdd:
+        if (!known(i.a) || !known(i.b)) break;
+        Combine(sparsity, t, i.r, i.a, i.b,
+                [](double a, double b) { return a + b; });
+        v[i.r] = v[i.a] + v[i.b];
+        break;
+      case Code::kSub:
+        if (!known(i.a) || !known(i.b)) break;
+        Combine(sparsity, t, i.r, i.a, i.b,
+                [](double a, double b) { return a - b; });
+        v[i.r] = v[i.a] - v[i.b];
+        break;
+      case Code::kMul: {
+        if (!known(i.a) || !known(i.b)) break;
+        const double va = v[i.a], vb = v[i.b];
+        Combine(sparsity, t, i.r, i.a, i.b,
+                [va, vb](double a, double b) { return a * vb + va * b; });
+        v[i.r] = va * vb;
+        break;
+      }
+      case Code::kDiv: {
+        if (!known(i.a) || !known(i.b)) break;
+        const double vb = v[i.b], q = v[i.a] / vb;
+        Combine(sparsity, t, i.r, i.a, i.b,
+                [vb, q](double a, double b) { return (a - q * b) / vb; });
+        v[i.r] = q;
+        break;
+      }
+      case Code::kNeg:
+        if (!known(i.a)) break;
+        Combine(sparsity, t, i.r, i.a, i.a,
+                [](double a, double) { return -a; });
+        v[i.r] = -v[i.a];
+        break;
+      case Code::kExp: {
+        if (!known(i.a)) break;
+        // The exponent is a constant so: d(a^b) = b * a^(b-1) * da
+        const double d = v[i.b] * std::pow(v[i.a], v[i.b] - 1);
+        Combine(sparsity, t, i.r, i.a, i.a,
+                [d](double a, double) { return d * a; });
+        v[i.r] = std::pow(v[i.a], v[i.b]);
+        break;
+      }
+      case Code::kAssign:
+        if (!known(i.a)) break;
+        Combine(sparsity, t, i.r, i.a, i.a,
+                [](double a, double) { return a; });
+        v[i.r] = v[i.a];
+        break;
+      case Code::kLoad:
+        for (int j = start[i.r]; j < start[i.r + 1]; j++) {
+          t[j] = (deps[j] == i.a) ? 1 : 0;
+        }
+        v[i.r] = in[i.a];
+        break;
+      case Code::kCheck: {
+        // The entries for a check are the union of its sides' dependencies.
+        const bool ok = known(i.a) && known(i.b);
+        int ia = start[i.a], ea = start[i.a + 1];
+        int ib = start[i.b], eb = start[i.b + 1];
+        while (ia < ea || ib < eb) {
+          const int c = (ib == eb || (ia < ea && deps[ia] < deps[ib]))
+                            ? deps[ia]
+                            : deps[ib];
+          const double da = (ia < ea && deps[ia] == c) ? t[ia++] : 0;
+          const double db = (ib < eb && deps[ib] == c) ? t[ib++] : 0;
+          jac[k++] = ok ? da - db : 0;
+        }
+        if (ok) out[i.r] = v[i.a] - v[i.b];
+        break;
+      }
+    }
+  }
+}
+
+std::vector<double> Plan::Lanes(int rows) const {
+  std::vector<double> lanes(slots_.size() * rows);
+  for (size_t s = 0; s < slots_.size(); s++) {
+    std::fill_n(lanes.begin() + s * rows, rows, slots_[s]);
+  }
+  return lanes;
+}
+
+std::vector<double> Plan::ReloadLanes(const std::vector<double>& frame,
+                                      int rows) const {
+  std::vector<double> lanes = Lanes(rows);
+  for (size_t s = 0; s < slots_.size(); s++) {
+    if (index_[s] < 0 || computed_[s]) continue;
+    std::copy_n(frame.begin() + static_cast<size_t>(index_[s]) * rows, rows,
+                lanes.begin() + s * rows);
+  }
+  return lanes;
+}
+
+void Plan::StoreLanes(const std::vector<double>& lanes, int rows,
+                      std::vector<double>* frame) const {
+  CHECK(lanes.size() == index_.size() * rows)
+      << lanes.size() << "!=" << index_.size() << "*" << rows;
+  for (size_t s = 0; s < slots_.size(); s++) {
+    if (index_[s] < 0) continue;
+    std::copy_n(lanes.begin() + s * rows, rows,
+                frame->begin() + static_cast<size_t>(index_[s]) * rows);
+  }
+}
+
+namespace {
+// NaN is the only value that is not equal to itself. Unlike std::isnan,
+// this doesn't get in the way of vectorizing the loops below.
+inline bool Known(double v) { return v == v; }
+
+// Apply an operation across lanes, skipping rows with unknown inputs. The
+// skip is a select rather than a branch so the loops still vectorize.
+template <class F>
+void Lanes1(int rows, double* r, const double* a, F f) {
+  for (int k = 0; k < rows; k++) r[k] = Known(a[k]) ? f(a[k]) : r[k];
+}
+
+template <class F>
+void Lanes2(int rows, double* r, const double* a, const double* b, F f) {
+  for (int k = 0; k < rows; k++) {
+    r[k] = (Known(a[k]) & Known(b[k])) ? f(a[k], b[k]) : r[k];
+  }
+}
+}  // namespace
+
+void Plan::RunBatch(int rows, double* lanes) const {
+  auto lane = [lanes, rows](int s) {
+    return lanes + static_cast<size_t>(s) * rows;
+  };
+  for (const Inst& i : direct_) {
+    switch (i.code) {
+      case Code::kAdd:
+        Lanes2(rows, lane(i.r), lane(i.a), lane(i.b),
+               [](double a, double b) { return a + b; });
+        break;
+      case Code::kSub:
+        Lanes2(rows, lane(i.r), lane(i.a), lane(i.b),
+               [](double a, double b) { return a - b; });
+        break;
+      case Code::kMul:
+        Lanes2(rows, lane(i.r), lane(i.a), lane(i.b),
+               [](double a, double b) { return a * b; });
+        break;
+      case Code::kDiv:
+        Lanes2(rows, lane(i.r), lane(i.a), lane(i.b),
+               [](double a, double b) { return a / b; });
+        break;
+      case Code::kNeg:
+        Lanes1(rows, lane(i.r), lane(i.a), [](double a) { return -a; });
+        break;
+      case Code::kExp: {
+        // The exponent is the same for every row.
+        double e = lane(i.b)[0];
+        Lanes1(rows, lane(i.r), lane(i.a),
+               [e](double a) { return std::pow(a, e); });
+        break;
+      }
+      case Code::kAssign:
+        Lanes1(rows, lane(i.r), lane(i.a), [](double a) { return a; });
+        break;
+      case Code::kLoad:
+      case Code::kCheck:
+        break;  // Not in direct code, see the constructor.
+    }
+  }
+}
+
+}  // namespace tbd
@@ -0,0 +1,159 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TBD_PLAN_H_
+#define TBD_PLAN_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "tbd/ops.h"
+#include "tbd/semantic.h"
+
+namespace tbd {
+
+// A compiled form of the ops for a stage.
+//
+// Every value the ops refer to is assigned a slot in a single array of
+// doubles and each op is flattened into a POD instruction that refers to
+// those slots by index. Running a plan is then a simple loop over a
+// contiguous array rather than a virtual dispatch per op.
+class Plan {
+ public:
+  enum class Code : uint8_t {
+    kAdd,     // r = a + b
+    kSub,     // r = a - b
+    kMul,     // r = a * b
+    kDiv,     // r = a / b
+    kNeg,     // r = -a
+    kExp,     // r = a ^ b
+    kAssign,  // r = a
+    kLoad,    // r = in[a]
+    kCheck,   // out[r] = a - b
+  };
+
+  struct Inst {
+    Code code;
+    int r, a, b;
+  };
+  static_assert(std::is_trivial<Inst>::value, "Inst should be POD");
+
+  // Which of the inputs the derivatives from the solve instructions can be
+  // non-zero for. Slot s only depends on deps[start[s]] to
+  // deps[start[s + 1] - 1], in increasing order, and the Jacobian is only
+  // non-zero at each (rows[k], cols[k]).
+  struct Sparsity {
+    std::vector<int> start, deps;
+    std::vector<int> rows, cols;
+  };
+
+  Plan() = default;
+  Plan(const std::vector<std::unique_ptr<OpI>>& direct,
+       const std::vector<std::unique_ptr<OpI>>& solve);
+
+  const std::vector<Inst>& direct() const { return direct_; }
+  const std::vector<Inst>& solve() const { return solve_; }
+  const Sparsity& sparsity() const { return sparsity_; }
+
+  // The initial value of every slot.
+  const std::vector<double>& slots() const { return slots_; }
+
+  // The initial value of every slot but with the ones the plan doesn't
+  // compute read from a frame of values (by SemanticDocument::Exp::index).
+  // This picks up whatever inputs the frame has.
+  std::vector<double> Reload(const std::vector<double>& frame) const;
+
+  // The slot for a value or -1 if the plan doesn't refer to it.
+  int Slot(const SemanticDocument::Exp* e) const;
+
+  // The values (by SemanticDocument::Exp::index) the plan reads from a
+  // frame, those it computes, and those the solve instructions compute.
+  std::vector<int> Inputs() const;
+  std::vector<int> Outputs() const;
+  std::vector<int> Solved() const;
+
+  // Copy slot values back into a frame.
+  void Store(const std::vector<double>& slots,
+             std::vector<double>* frame) const;
+
+  // Execute a sequence of instructions.
+  static void Run(const std::vector<Inst>& code, double* slots,
+                  const double* in, double* out);
+
+  // Execute a sequence of instructions while also carrying forward the
+  // derivatives of every slot with respect to each of the dim inputs.
+  //
+  // tangents holds dim values per slot (slot s at [s * dim, (s + 1) * dim))
+  // and should start as zeros. jac receives the dim x dim Jacobian of out
+  // with respect to in, in column-major order.
+  static void RunTangent(const std::vector<Inst>& code, int dim,
+                         double* slots, double* tangents, const double* in,
+                         double* out, double* jac);
+
+  // As RunTangent but only carrying the derivatives the sparsity allows.
+  // tangents holds one value for each of sparsity.deps and jac receives
+  // one for each of sparsity.rows (in the same orders).
+  static void RunSparseTangent(const std::vector<Inst>& code,
+                               const Sparsity& sparsity, double* slots,
+                               double* tangents, const double* in,
+                               double* out, double* jac);
+
+  // Make the lanes for running rows evaluations at once. The values are
+  // stored by slot (slot s at [s * rows, (s + 1) * rows)) and each starts
+  // out with the initial value of its slot.
+  std::vector<double> Lanes(int rows) const;
+
+  // As Lanes but, like Reload, with the ones the plan doesn't compute read
+  // from rows frames of values, laid out the same way by Exp::index.
+  std::vector<double> ReloadLanes(const std::vector<double>& frame,
+                                  int rows) const;
+
+  // Copy lanes back into rows frames of values, as Store.
+  void StoreLanes(const std::vector<double>& lanes, int rows,
+                  std::vector<double>* frame) const;
+
+  // Execute the direct instructions over each of rows sets of values. Only
+  // the solve instructions load and check guesses, so these never do.
+  void RunBatch(int rows, double* lanes) const;
+
+ private:
+  friend class CompilePlan;
+
+  std::vector<Inst> direct_, solve_;
+  Sparsity sparsity_;
+  std::vector<double> slots_;
+  std::vector<int> index_;  // The Exp::index of each slot, -1 for constants.
+  std::vector<bool> computed_;  // Is the slot set by some instruction.
+  std::map<const SemanticDocument::Exp*, int> slot_;
+};
+
+}  // namespace tbd
+
+#endif  // TBD_PLAN_H_
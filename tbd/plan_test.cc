@@ -0,0 +1,290 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tbd/plan.h"
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tbd/ops.h"
+#include "tbd/semantic.h"
+
+namespace tbd {
+namespace {
+
+using testing::DoubleEq;
+using testing::DoubleNear;
+using testing::ElementsAre;
+
+TEST(Plan, Direct) {
+  SemanticDocument doc;
+  auto& A = *doc.GetNode();
+  auto& B = *doc.GetNode();
+  auto& R1 = *doc.GetNode();
+  auto& R2 = *doc.GetNode();
+  auto& R3 = *doc.GetNode();
+  auto& R4 = *doc.GetNode();
+  auto& R5 = *doc.GetNode();
+  A.value = 3;
+  B.value = 4;
+
+  std::vector<std::unique_ptr<OpI>> direct, solve;
+  direct.emplace_back(absl::make_unique<OpAdd>(&R1, &A, &B));
+  direct.emplace_back(absl::make_unique<OpSub>(&R2, &R1, &A));
+  direct.emplace_back(absl::make_unique<OpMul>(&R3, &R2, &R1));
+  direct.emplace_back(absl::make_unique<OpDiv>(&R4, &R3, &B));
+  direct.emplace_back(absl::make_unique<OpExp>(&R5, &R4, 2));
+
+  Plan plan(direct, solve);
+  EXPECT_EQ(plan.direct().size(), direct.size());
+  EXPECT_TRUE(plan.solve().empty());
+
+  std::vector<double> slots = plan.slots();
+  Plan::Run(plan.direct(), slots.data(), nullptr, nullptr);
+  EXPECT_TRUE(std::isnan(R5.value));  // Nothing is stored until asked.
+
+  std::vector<double> frame = doc.Values();
+  plan.Store(slots, &frame);
+  EXPECT_EQ(frame[R1.index], 7);
+  EXPECT_EQ(frame[R2.index], 4);
+  EXPECT_EQ(frame[R3.index], 28);
+  EXPECT_EQ(frame[R4.index], 7);
+  EXPECT_EQ(frame[R5.index], 49);
+  EXPECT_EQ(frame[A.index], 3);
+  EXPECT_EQ(frame[B.index], 4);
+  EXPECT_TRUE(std::isnan(R5.value));  // Only the frame is changed.
+}
+
+TEST(Plan, Solve) {
+  SemanticDocument doc;
+  auto& A = *doc.GetNode();
+  auto& X = *doc.GetNode();
+  auto& Y = *doc.GetNode();
+  auto& N = *doc.GetNode();
+  auto& R = *doc.GetNode();
+  A.value = 10;
+
+  std::vector<std::unique_ptr<OpI>> direct, solve;
+  direct.emplace_back(absl::make_unique<OpNeg>(&N, &A));
+  solve.emplace_back(absl::make_unique<OpLoad>(&X, 1));
+  solve.emplace_back(absl::make_unique<OpLoad>(&Y, 0));
+  solve.emplace_back(absl::make_unique<OpAssign>(&R, &X));
+  solve.emplace_back(absl::make_unique<OpCheck>(0, &R, &N));
+  solve.emplace_back(absl::make_unique<OpCheck>(1, &Y, &A));
+
+  Plan plan(direct, solve);
+
+  std::vector<double> slots = plan.slots();
+  Plan::Run(plan.direct(), slots.data(), nullptr, nullptr);
+
+  // The same plan can be run repeatedly with different inputs.
+  double in[2] = {1, 2}, out[2] = {NAN, NAN};
+  Plan::Run(plan.solve(), slots.data(), in, out);
+  EXPECT_THAT(out, ElementsAre(DoubleEq(12), DoubleEq(-9)));
+
+  in[0] = 10;
+  in[1] = -10;
+  Plan::Run(plan.solve(), slots.data(), in, out);
+  EXPECT_THAT(out, ElementsAre(DoubleEq(0), DoubleEq(0)));
+
+  std::vector<double> frame = doc.Values();
+  plan.Store(slots, &frame);
+  EXPECT_EQ(frame[X.index], -10);
+  EXPECT_EQ(frame[Y.index], 10);
+  EXPECT_EQ(frame[R.index], -10);
+}
+
+TEST(Plan, SkipUnknown) {
+  SemanticDocument doc;
+  auto& A = *doc.GetNode();
+  auto& B = *doc.GetNode();
+  auto& R1 = *doc.GetNode();
+  auto& R2 = *doc.GetNode();
+  A.value = 3;
+  R1.value = 5;  // Left in place since B is not known.
+
+  std::vector<std::unique_ptr<OpI>> direct, solve;
+  direct.emplace_back(absl::make_unique<OpAdd>(&R1, &A, &B));
+  direct.emplace_back(absl::make_unique<OpNeg>(&R2, &R1));
+
+  Plan plan(direct, solve);
+  std::vector<double> slots = plan.slots();
+  Plan::Run(plan.direct(), slots.data(), nullptr, nullptr);
+  std::vector<double> frame = doc.Values();
+  plan.Store(slots, &frame);
+  EXPECT_TRUE(std::isnan(frame[B.index]));
+  EXPECT_EQ(frame[R1.index], 5);
+  EXPECT_EQ(frame[R2.index], -5);
+}
+
+TEST(Plan, Tangent) {
+  SemanticDocument doc;
+  auto& A = *doc.GetNode();
+  auto& X = *doc.GetNode();
+  auto& Y = *doc.GetNode();
+  auto& P = *doc.GetNode();
+  auto& Q = *doc.GetNode();
+  auto& R = *doc.GetNode();
+  auto& S = *doc.GetNode();
+  A.value = 3;
+
+  // out[0] = x * y - a, out[1] = x^2 / y + -x
+  std::vector<std::unique_ptr<OpI>> direct, solve;
+  solve.emplace_back(absl::make_unique<OpLoad>(&X, 0));
+  solve.emplace_back(absl::make_unique<OpLoad>(&Y, 1));
+  solve.emplace_back(absl::make_unique<OpMul>(&P, &X, &Y));
+  solve.emplace_back(absl::make_unique<OpCheck>(0, &P, &A));
+  solve.emplace_back(absl::make_unique<OpExp>(&Q, &X, 2));
+  solve.emplace_back(absl::make_unique<OpDiv>(&R, &Q, &Y));
+  solve.emplace_back(absl::make_unique<OpNeg>(&S, &X));
+  solve.emplace_back(absl::make_unique<OpCheck>(1, &R, &S));
+
+  Plan plan(direct, solve);
+  std::vector<double> slots = plan.slots();
+  std::vector<double> tangents(slots.size() * 2, 0.0);
+  double in[2] = {2, 5}, out[2], jac[4];
+  Plan::RunTangent(plan.solve(), 2, slots.data(), tangents.data(), in, out,
+                   jac);
+
+  EXPECT_THAT(out, ElementsAre(DoubleEq(7), DoubleEq(0.8 + 2)));
+  // Column-major: d0/dx, d1/dx, d0/dy, d1/dy
+  EXPECT_THAT(jac, ElementsAre(DoubleEq(5), DoubleEq(0.8 + 1),  //
+                               DoubleEq(2), DoubleEq(-0.16)));
+}
+
+TEST(Plan, SparseTangent) {
+  SemanticDocument doc;
+  auto& A = *doc.GetNode();
+  auto& X = *doc.GetNode();
+  auto& Y = *doc.GetNode();
+  auto& Z = *doc.GetNode();
+  auto& P = *doc.GetNode();
+  auto& Q = *doc.GetNode();
+  auto& R = *doc.GetNode();
+  A.value = 3;
+
+  // out[0] = x * y - a, out[1] = z^2 / y - a, out[2] = -z - a
+  std::vector<std::unique_ptr<OpI>> direct, solve;
+  solve.emplace_back(absl::make_unique<OpLoad>(&X, 0));
+  solve.emplace_back(absl::make_unique<OpLoad>(&Y, 1));
+  solve.emplace_back(absl::make_unique<OpLoad>(&Z, 2));
+  solve.emplace_back(absl::make_unique<OpMul>(&P, &X, &Y));
+  solve.emplace_back(absl::make_unique<OpCheck>(0, &P, &A));
+  solve.emplace_back(absl::make_unique<OpExp>(&Q, &Z, 2));
+  solve.emplace_back(absl::make_unique<OpDiv>(&R, &Q, &Y));
+  solve.emplace_back(absl::make_unique<OpCheck>(1, &R, &A));
+  solve.emplace_back(absl::make_unique<OpNeg>(&R, &Z));
+  solve.emplace_back(absl::make_unique<OpCheck>(2, &R, &A));
+
+  Plan plan(direct, solve);
+  const Plan::Sparsity& sparsity = plan.sparsity();
+  EXPECT_THAT(sparsity.rows, ElementsAre(0, 0, 1, 1, 2, 2));
+  EXPECT_THAT(sparsity.cols, ElementsAre(0, 1, 1, 2, 1, 2));
+
+  std::vector<double> slots = plan.slots();
+  std::vector<double> tangents(sparsity.deps.size(), 0.0);
+  double in[3] = {2, 5, 4}, out[3], jac[6];
+  Plan::RunSparseTangent(plan.solve(), sparsity, slots.data(),
+                         tangents.data(), in, out, jac);
+
+  EXPECT_THAT(out,
+              ElementsAre(DoubleEq(7), DoubleNear(0.2, 1e-12), DoubleEq(-7)));
+  // R is set twice so its last value picks up an explicit zero for y.
+  EXPECT_THAT(jac, ElementsAre(DoubleEq(5), DoubleEq(2),         //
+                               DoubleEq(-0.64), DoubleEq(1.6),  //
+                               DoubleEq(0), DoubleEq(-1)));
+
+  // The same as the dense form.
+  std::vector<double> dense_slots = plan.slots();
+  std::vector<double> dense_tangents(dense_slots.size() * 3, 0.0);
+  double dense_out[3], dense_jac[9] = {};
+  Plan::RunTangent(plan.solve(), 3, dense_slots.data(), dense_tangents.data(),
+                   in, dense_out, dense_jac);
+  for (size_t k = 0; k < sparsity.rows.size(); k++) {
+    EXPECT_EQ(jac[k], dense_jac[sparsity.rows[k] + 3 * sparsity.cols[k]]) << k;
+  }
+}
+
+TEST(Plan, Batch) {
+  SemanticDocument doc;
+  auto& A = *doc.GetNode();
+  auto& B = *doc.GetNode();
+  auto& R1 = *doc.GetNode();
+  auto& R2 = *doc.GetNode();
+  auto& R3 = *doc.GetNode();
+  auto& R4 = *doc.GetNode();
+  auto& R5 = *doc.GetNode();
+  auto& R6 = *doc.GetNode();
+  auto& R7 = *doc.GetNode();
+  A.value = 1;
+  B.value = 2;
+
+  std::vector<std::unique_ptr<OpI>> direct, solve;
+  direct.emplace_back(absl::make_unique<OpAdd>(&R1, &A, &B));
+  direct.emplace_back(absl::make_unique<OpSub>(&R2, &R1, &A));
+  direct.emplace_back(absl::make_unique<OpMul>(&R3, &R2, &R1));
+  direct.emplace_back(absl::make_unique<OpDiv>(&R4, &R3, &B));
+  direct.emplace_back(absl::make_unique<OpExp>(&R5, &R4, 0.5));
+  direct.emplace_back(absl::make_unique<OpNeg>(&R6, &R5));
+  direct.emplace_back(absl::make_unique<OpAssign>(&R7, &R6));
+  Plan plan(direct, solve);
+
+  // Vary the inputs by row, including some unknown ones.
+  constexpr int kRows = 37;
+  std::vector<double> lanes = plan.Lanes(kRows);
+  double* a = lanes.data() + plan.Slot(&A) * kRows;
+  double* b = lanes.data() + plan.Slot(&B) * kRows;
+  for (int k = 0; k < kRows; k++) {
+    a[k] = k;
+    b[k] = (k % 5 == 3) ? NAN : 1.5 + k;
+  }
+  plan.RunBatch(kRows, lanes.data());
+
+  // Each row should match running the same values one at a time.
+  for (int k = 0; k < kRows; k++) {
+    std::vector<double> slots = plan.slots();
+    slots[plan.Slot(&A)] = a[k];
+    slots[plan.Slot(&B)] = b[k];
+    Plan::Run(plan.direct(), slots.data(), nullptr, nullptr);
+    for (size_t s = 0; s < slots.size(); s++) {
+      double got = lanes[s * kRows + k];
+      if (std::isnan(slots[s])) {
+        EXPECT_TRUE(std::isnan(got)) << "row " << k << " slot " << s;
+      } else {
+        EXPECT_DOUBLE_EQ(got, slots[s]) << "row " << k << " slot " << s;
+      }
+    }
+  }
+  EXPECT_EQ(plan.Slot(&R7), static_cast<int>(plan.slots().size()) - 1);
+}
+
+}  // namespace
+}  // namespace tbd
@@ -0,0 +1,52 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tbd/preamble.h"
+
+#include "absl/log/check.h"
+#include "tbd/ast.h"
+#include "tbd/dimensions.h"
+#include "tbd/semantic.h"
+
+namespace tbd {
+
+void AddPreamble(SemanticDocument* sem, Document* doc) {
+  for (size_t i = 0; i < kPreambleUnitCount; i++) {
+    const auto& u = kPreambleUnits[i];
+    Dimension dim = pow(Dimension::L(), u.dim[0]) *
+                    pow(Dimension::M(), u.dim[1]) *
+                    pow(Dimension::T(), u.dim[2]) *
+                    pow(Dimension::I(), u.dim[3]) *
+                    pow(Dimension::K(), u.dim[4]) *
+                    pow(Dimension::N(), u.dim[5]) *
+                    pow(Dimension::J(), u.dim[6]);
+    CHECK(sem->AddUnit(u.name, Unit{u.scale, dim})) << u.name;
+  }
+  AddPreambleDefines(doc);
+}
+
+}  // namespace tbd
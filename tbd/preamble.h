@@ -0,0 +1,57 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TBD_PREAMBLE_H_
+#define TBD_PREAMBLE_H_
+
+#include <cstddef>
+
+#include "tbd/ast.h"
+#include "tbd/semantic.h"
+
+namespace tbd {
+
+// A unit from the preamble, already resolved to SI.
+struct PreambleUnit {
+  const char* name;
+  double scale;
+  int dim[7];  // Exponents of L, M, T, I, K, N and J.
+};
+
+// Generated from preamble.tbd by gen_preamble.
+extern const PreambleUnit kPreambleUnits[];
+extern const size_t kPreambleUnitCount;
+void AddPreambleDefines(Document* doc);
+
+// Seed a document with the preamble. The units go directly into the
+// SemanticDocument and the definitions into the Document, so nothing from
+// the preamble needs to be parsed or resolved at run time.
+void AddPreamble(SemanticDocument* sem, Document* doc);
+
+}  // namespace tbd
+
+#endif  // TBD_PREAMBLE_H_
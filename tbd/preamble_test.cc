@@ -0,0 +1,113 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tbd/preamble.h"
+
+#include <map>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tbd/ast.h"
+#include "tbd/parser.h"
+#include "tbd/preamble_emebed_data.h"
+#include "tbd/resolve_units.h"
+#include "tbd/semantic.h"
+#include "tbd/validate.h"
+
+namespace tbd {
+namespace {
+
+class MapSink : public UnitsOutput {
+ public:
+  void Output(const std::string& name, const Unit& unit) const override {
+    units.emplace(name, unit);
+  }
+
+  mutable std::map<std::string, Unit> units;
+};
+
+// Parse and resolve the preamble the slow way.
+class PreambleTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto outp = [](const std::string& e) { ADD_FAILURE() << e; };
+    ASSERT_EQ(Parse(kPreamble, ::tbd_preamble_tbd(), outp, &parsed_doc_), 0);
+    ASSERT_TRUE(parsed_doc_.VisitNode(Validate(&parsed_sem_, outp).as_ptr()));
+    ResolveUnits resolve(&parsed_sem_, outp);
+    ASSERT_TRUE(parsed_doc_.VisitNode(&resolve));
+    ASSERT_TRUE(resolve.ResolveAll());
+
+    AddPreamble(&sem_, &doc_);
+  }
+
+  Document parsed_doc_, doc_;
+  SemanticDocument parsed_sem_, sem_;
+};
+
+TEST_F(PreambleTest, Units) {
+  MapSink parsed, table;
+  parsed_sem_.LogUnits(parsed);
+  sem_.LogUnits(table);
+
+  ASSERT_EQ(parsed.units.size(), table.units.size());
+  for (const auto& u : parsed.units) {
+    auto i = table.units.find(u.first);
+    ASSERT_NE(i, table.units.end()) << u.first;
+    EXPECT_EQ(u.second.scale, i->second.scale) << u.first;
+    EXPECT_EQ(u.second.dim, i->second.dim) << u.first;
+  }
+}
+
+TEST_F(PreambleTest, Defines) {
+  const auto& parsed = parsed_doc_.defines();
+  const auto& table = doc_.defines();
+  ASSERT_EQ(parsed.size(), table.size());
+  for (size_t i = 0; i < parsed.size(); i++) {
+    const Define& p = *parsed[i];
+    const Define& t = *table[i];
+    EXPECT_EQ(p.name(), t.name());
+    EXPECT_EQ(p.value(), t.value()) << p.name();
+    EXPECT_EQ(p.location(), t.location()) << p.name();
+    EXPECT_EQ(p.unit().location(), t.unit().location()) << p.name();
+
+    const auto& pb = p.unit().bits();
+    const auto& tb = t.unit().bits();
+    ASSERT_EQ(pb.size(), tb.size()) << p.name();
+    for (size_t j = 0; j < pb.size(); j++) {
+      EXPECT_EQ(pb[j].id, tb[j].id) << p.name();
+      EXPECT_EQ(pb[j].exp, tb[j].exp) << p.name();
+      EXPECT_EQ(pb[j].loc, tb[j].loc) << p.name();
+    }
+  }
+  // Only the definitions are seeded; the preamble's unit definitions are
+  // already resolved into the SemanticDocument.
+  EXPECT_TRUE(doc_.unit_definition().empty());
+}
+
+}  // namespace
+}  // namespace tbd
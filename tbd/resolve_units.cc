@@ -28,427 +28,394 @@
 #include "tbd/resolve_units.h"
 
 #include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
 
-#include "absl/flags/flag.h"
 #include "absl/log/check.h"
-#include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/optional.h"
 #include "tbd/ast.h"
 #include "tbd/dimensions.h"
 #include "tbd/semantic.h"
 #include "tbd/util.h"
 
-ABSL_FLAG(int32_t, iteration_limit, 64, "");
-
 namespace tbd {
-
-bool ResolveUnits::operator()(const UnitExp& exp) {
-  for (const auto& bit : exp.bits()) {
-    if (const auto u = doc_->LookupUnit(bit.id)) {
-      unit_value_ = Unit{unit_value_.scale * std::pow(u->scale, bit.exp),
-                         unit_value_.dim * pow(u->dim, bit.exp)};
-      if (bit.exp < -1) {
-        absl::StrAppend(&unit_name_, "/", bit.id, "^", -bit.exp);
-      } else if (bit.exp == -1) {
-        absl::StrAppend(&unit_name_, "/", bit.id);
-      } else if (bit.exp == 1) {
-        absl::StrAppend(&unit_name_, "*", bit.id);
-      } else {
-        absl::StrAppend(&unit_name_, "*", bit.id, "^", bit.exp);
-      }
-    } else {
-      SYM_ERROR(bit.loc) << "Unit '" << bit.id << "' is not defined";
-      return false;
+namespace {
+
+// Finds the dimensions implied by the equations in one go. The additive
+// constraints (=, +, - and negation) join nodes into classes that must share
+// a dimension (union-find). The multiplicative ones (*, / and ^) are run from
+// a queue whenever one of their classes gets a dimension, which can then give
+// another class one. A conflict is noted at the node whose constraint would
+// join (or set) two different dimensions, and that constraint is dropped.
+class InferDimensions final : public VisitNodes {
+ public:
+  InferDimensions(const Document& doc, SemanticDocument* sem) : sem_(sem) {
+    const auto nodes = sem_->nodes();
+    parent_.resize(nodes.size());
+    dim_.resize(nodes.size());
+    ops_of_.resize(nodes.size());
+    for (const auto* exp : nodes) {
+      parent_[exp->index] = exp->index;
+      dim_[exp->index] = exp->meta->dim;
     }
-  }
 
-  if (!unit_name_.empty()) {
-    if (unit_name_[0] == '/') {
-      unit_name_ = absl::StrCat("1", unit_name_);
-    } else {
-      unit_name_ = unit_name_.substr(1);
+    for (auto e : doc.equality()) (void)e->VisitNode(this);
+    while (!queue_.empty()) {
+      const int o = queue_.back();
+      queue_.pop_back();
+      Run(ops_[o]);
     }
   }
 
-  return true;
-}
+  // Where two dimensions met: what the node says about them, and the two
+  // dimensions (the one already found first).
+  struct Conflict {
+    const char* what;
+    Dimension a, b;
+  };
 
-bool ResolveUnits::operator()(const UnitDef& unit) {
-  bool error = false;
-  if (doc_->LookupUnit(unit.name())) {
-    SYM_ERROR(unit) << "Unit '" << unit.name() << "' already defined at TODO";
-    error = true;
+  // The conflicts found, one per node, in source order.
+  const std::map<const NodeI*, Conflict, StableNodeCompare>& conflicts() const {
+    return conflicts_;
   }
 
-  unit_value_ = {unit.value(), Dimension::Dimensionless()};
-
-  if (!unit.unit().VisitNode(this)) return false;
-
-  if (error) return false;
-
-  CHECK(doc_->AddUnit(unit.name(), unit_value_));
-
-  return true;
-}
-
-bool ResolveUnits::operator()(const Equality& e) {
-  if (!e.left()->VisitNode(this) || !e.right()->VisitNode(this)) return false;
-
-  auto l = doc_->TryGetNode(e.left());
-  auto r = doc_->TryGetNode(e.right());
-  CHECK(l != nullptr) << e.left()->location();
-  CHECK(r != nullptr) << e.right()->location();
-
-  if (!l->dim.has_value() && !r->dim.has_value()) return true;
-
-  if (l->dim.has_value() && r->dim.has_value()) {
-    if (*l->dim != *r->dim) {
-      SYM_ERROR(e)
-          << "Equality expression's terms have different dimensionality: "
-          << *l->dim << " and " << *r->dim;
-      return false;
-    } else {
-      return true;
+  // Set the dimension of every node that one was found for.
+  void Store() {
+    for (auto* exp : sem_->nodes()) {
+      const auto& dim = dim_[Find(exp->index)];
+      if (dim.has_value()) exp->meta->dim = dim;
     }
   }
 
-  if (!down_) return true;
+ private:
+  // n = l * r, n = l / r or n = l ^ exp.
+  struct Op {
+    const NodeI* node;
+    enum { kMul, kDiv, kPow } kind;
+    int n, l, r;
+    int exp;
+  };
+
+  int Index(const ExpressionNode* n) {
+    auto exp = sem_->TryGetNode(n);
+    CHECK(exp != nullptr) << n->location();
+    return exp->index;
+  }
 
-  if (!l->dim.has_value() && r->dim.has_value()) {
-    l->dim = *r->dim;
-    progress_ = true;
-    LOG(INFO) << "=< " << e.location();
-  } else if (l->dim.has_value() && !r->dim.has_value()) {
-    r->dim = *l->dim;
-    progress_ = true;
-    LOG(INFO) << "=> " << e.location();
-  } else {
-    LOG(FATAL) << "Expected unreachable";
+  int Find(int x) {
+    while (parent_[x] != x) x = parent_[x] = parent_[parent_[x]];
+    return x;
   }
 
-  return true;
-}
+  void Report(const NodeI& n, const char* what, const Dimension& a,
+              const Dimension& b) {
+    conflicts_.emplace(&n, Conflict{what, a, b});
+  }
 
-bool ResolveUnits::operator()(const LiteralValue& l) {
-  auto val = doc_->TryGetNode(&l);
-  CHECK(val != nullptr);
-  if (!val->dim.has_value()) {
-    val->dim = Dimension::Dimensionless();
-    progress_ = true;
-  } else {
-    CHECK(val->dim == Dimension::Dimensionless())
-        << l.location() << ": literal value's dimensionality is not unitless";
+  // Note that something now knows the dimension of the class of x.
+  void Known(int x) {
+    for (int o : ops_of_[x]) queue_.push_back(o);
   }
-  return true;
-}
 
-bool ResolveUnits::operator()(const PowerExp& e) {
-  if (!e.base()->VisitNode(this)) return false;
-
-  auto b = doc_->TryGetNode(e.base());
-  auto exp = doc_->TryGetNode(&e);
-  CHECK(b != nullptr);
-  CHECK(exp != nullptr);
-
-  if (!b->dim.has_value() && !exp->dim.has_value()) return true;
-
-  if (b->dim.has_value()) {
-    auto dim = pow(*b->dim, e.exp());
-    if (!exp->dim.has_value()) {
-      exp->dim = dim;
-      progress_ = true;
-      return true;
-    } else if (*exp->dim != dim) {
-      SYM_ERROR(e)
-          << "Exponential expression's dimensionality is deduced as both "
-          << *exp->dim << " and " << dim;
-      return false;
+  void Set(const NodeI& n, const char* what, int x, const Dimension& dim) {
+    x = Find(x);
+    if (!dim_[x].has_value()) {
+      dim_[x] = dim;
+      Known(x);
+    } else if (*dim_[x] != dim) {
+      Report(n, what, *dim_[x], dim);
     }
-    return true;
   }
 
-  if (!down_) return true;
-
-  CHECK(exp->dim.has_value());
-  CHECK(!b->dim.has_value());
-  b->dim = root(*exp->dim, e.exp());
-  progress_ = true;
-  LOG(INFO) << "^. " << e.location();
+  void Union(const NodeI& n, const char* what, int a, int b) {
+    a = Find(a);
+    b = Find(b);
+    if (a == b) return;
+    if (dim_[a].has_value() && dim_[b].has_value() && *dim_[a] != *dim_[b]) {
+      Report(n, what, *dim_[a], *dim_[b]);
+      return;
+    }
+    if (ops_of_[a].size() < ops_of_[b].size()) std::swap(a, b);
+    parent_[b] = a;
+    if (dim_[a].has_value() != dim_[b].has_value()) {
+      Known(dim_[a].has_value() ? b : a);
+      if (!dim_[a].has_value()) dim_[a] = dim_[b];
+    }
+    ops_of_[a].insert(ops_of_[a].end(), ops_of_[b].begin(), ops_of_[b].end());
+    ops_of_[b].clear();
+    ops_of_[b].shrink_to_fit();
+  }
 
-  return true;
-}
+  void AddOp(Op op) {
+    const int o = ops_.size();
+    ops_.push_back(op);
+    for (int x : {op.n, op.l, op.r}) {
+      if (x >= 0) ops_of_[Find(x)].push_back(o);
+    }
+    queue_.push_back(o);
+  }
 
-bool ResolveUnits::operator()(const ProductExp& p) {
-  if (!p.left()->VisitNode(this) || !p.right()->VisitNode(this)) return false;
+  void Run(const Op& op) {
+    const auto& n = dim_[Find(op.n)];
+    const auto& l = dim_[Find(op.l)];
+    if (op.kind == Op::kPow) {
+      const char* what =
+          "Exponential expression's dimensionality is deduced as both ";
+      if (l.has_value()) {
+        Set(*op.node, what, op.n, pow(*l, op.exp));
+      } else if (n.has_value() && op.exp != 0) {
+        Set(*op.node, what, op.l, root(*n, op.exp));
+      }
+      return;
+    }
 
-  auto l = doc_->TryGetNode(p.left());
-  auto r = doc_->TryGetNode(p.right());
-  auto n = doc_->TryGetNode(&p);
-  CHECK(l != nullptr) << p.left()->location();
-  CHECK(r != nullptr) << p.right()->location();
-  CHECK(n != nullptr) << p.location();
+    const auto& r = dim_[Find(op.r)];
+    const bool mul = (op.kind == Op::kMul);
+    const char* what =
+        mul ? "Multiplication expression's dimensionality is deduced as both "
+            : "Division expression's dimensionality is deduced as both ";
+    if (l.has_value() && r.has_value()) {
+      Set(*op.node, what, op.n, mul ? *l * *r : *l / *r);
+    } else if (n.has_value() && l.has_value()) {
+      Set(*op.node, what, op.r, mul ? *n / *l : *l / *n);
+    } else if (n.has_value() && r.has_value()) {
+      Set(*op.node, what, op.l, mul ? *n / *r : *r * *n);
+    }
+  }
 
-  if (!n->dim.has_value() && !l->dim.has_value() && !r->dim.has_value())
+  bool operator()(const Equality& n) override {
+    (void)n.left()->VisitNode(this);
+    (void)n.right()->VisitNode(this);
+    Union(n, "Equality expression's terms have different dimensionality: ",
+          Index(n.left()), Index(n.right()));
     return true;
-
-  if (l->dim.has_value() && r->dim.has_value()) {
-    auto dim = *l->dim * *r->dim;
-    if (!n->dim.has_value()) {
-      n->dim = dim;
-      progress_ = true;
-      return true;
-    } else if (*n->dim != dim) {
-      SYM_ERROR(p)
-          << "Multiplication expression's dimensionality is deduced as both "
-          << *n->dim << " and " << dim;
-      return false;
-    }
+  }
+  bool operator()(const LiteralValue& n) override {
+    Set(n, "Literal value's dimensionality is deduced as both ", Index(&n),
+        Dimension::Dimensionless());
     return true;
   }
-
-  if (!n->dim.has_value()) return true;
-
-  CHECK(!l->dim.has_value() || !r->dim.has_value());
-
-  if (!down_) return true;
-
-  if (l->dim.has_value() && !r->dim.has_value()) {
-    r->dim = *n->dim / *l->dim;
-    progress_ = true;
-    LOG(INFO) << "*> " << p.location();
-  } else if (!l->dim.has_value() && r->dim.has_value()) {
-    l->dim = *n->dim / *r->dim;
-    progress_ = true;
-    LOG(INFO) << "*< " << p.location();
+  bool operator()(const NamedValue&) override { return true; }
+  bool operator()(const PowerExp& n) override {
+    (void)n.base()->VisitNode(this);
+    AddOp({&n, Op::kPow, Index(&n), Index(n.base()), -1, n.exp()});
+    return true;
   }
-
-  return true;
-}
-
-bool ResolveUnits::operator()(const QuotientExp& q) {
-  if (!q.left()->VisitNode(this) || !q.right()->VisitNode(this)) return false;
-
-  auto l = doc_->TryGetNode(q.left());
-  auto r = doc_->TryGetNode(q.right());
-  auto n = doc_->TryGetNode(&q);
-  CHECK(l != nullptr) << q.left()->location();
-  CHECK(r != nullptr) << q.right()->location();
-  CHECK(n != nullptr) << q.location();
-
-  if (!n->dim.has_value() && !l->dim.has_value() && !r->dim.has_value())
+  bool operator()(const ProductExp& n) override {
+    (void)n.left()->VisitNode(this);
+    (void)n.right()->VisitNode(this);
+    AddOp({&n, Op::kMul, Index(&n), Index(n.left()), Index(n.right()), 0});
     return true;
-
-  if (l->dim.has_value() && r->dim.has_value()) {
-    auto dim = *l->dim / *r->dim;
-    if (!n->dim.has_value()) {
-      n->dim = dim;
-      progress_ = true;
-      return true;
-    } else if (*n->dim != dim) {
-      SYM_ERROR(q) << "Division expression's dimensionality is deduced as both "
-                   << *n->dim << " and " << dim;
-      return false;
-    }
+  }
+  bool operator()(const QuotientExp& n) override {
+    (void)n.left()->VisitNode(this);
+    (void)n.right()->VisitNode(this);
+    AddOp({&n, Op::kDiv, Index(&n), Index(n.left()), Index(n.right()), 0});
+    return true;
+  }
+  bool operator()(const SumExp& n) override {
+    return Additive(
+        n, "Addition expression's terms have different dimensionality: ",
+        "Addition expression's dimensionality is deduced as both ");
+  }
+  bool operator()(const DifExp& n) override {
+    return Additive(
+        n, "Subtraction expression's terms have different dimensionality: ",
+        "Subtraction expression's dimensionality is deduced as both ");
+  }
+  bool operator()(const NegativeExp& n) override {
+    (void)n.value()->VisitNode(this);
+    Union(n, "Negation expression's dimensionality is deduced as both ",
+          Index(&n), Index(n.value()));
     return true;
   }
 
-  if (!n->dim.has_value()) return true;
-
-  CHECK(!l->dim.has_value() || !r->dim.has_value());
-
-  if (!down_) return true;
-
-  if (l->dim.has_value() && !r->dim.has_value()) {
-    r->dim = *l->dim / *n->dim;
-    progress_ = true;
-    LOG(INFO) << "/> " << q.location();
-  } else if (!l->dim.has_value() && r->dim.has_value()) {
-    l->dim = *r->dim * *n->dim;
-    progress_ = true;
-    LOG(INFO) << "/< " << q.location();
+  // Both terms and the result share a dimension.
+  bool Additive(const BinaryExpression& n, const char* terms,
+                const char* both) {
+    (void)n.left()->VisitNode(this);
+    (void)n.right()->VisitNode(this);
+    Union(n, terms, Index(n.left()), Index(n.right()));
+    Union(n, both, Index(&n), Index(n.left()));
+    return true;
   }
 
+  // Not part of an equation.
+  bool operator()(const UnitExp&) override { return false; }
+  bool operator()(const UnitDef&) override { return false; }
+  bool operator()(const Define&) override { return false; }
+  bool operator()(const Specification&) override { return false; }
+  bool operator()(const Hint&) override { return false; }
+  bool operator()(const Document&) override { return false; }
+
+  SemanticDocument* sem_;
+  std::vector<int> parent_;                     // By Exp::index.
+  std::vector<absl::optional<Dimension>> dim_;  // By class root.
+  std::vector<std::vector<int>> ops_of_;        // By class root.
+  std::vector<Op> ops_;
+  std::vector<int> queue_;
+  std::map<const NodeI*, Conflict, StableNodeCompare> conflicts_;
+};
+
+}  // namespace
+
+bool ResolveUnits::Product(const UnitExp& exp, Unit* unit) {
+  for (const auto& bit : exp.bits()) {
+    const auto u = FindUnit(bit);
+    if (u == nullptr) return false;
+    *unit = Unit{unit->scale * std::pow(u->scale, bit.exp),
+                 unit->dim * pow(u->dim, bit.exp)};
+  }
   return true;
 }
 
-bool ResolveUnits::operator()(const SumExp& s) {
-  if (!s.left()->VisitNode(this) || !s.right()->VisitNode(this)) return false;
-
-  auto l = doc_->TryGetNode(s.left());
-  auto r = doc_->TryGetNode(s.right());
-  auto n = doc_->TryGetNode(&s);
-  CHECK(l != nullptr) << s.left()->location();
-  CHECK(r != nullptr) << s.right()->location();
-  CHECK(n != nullptr) << s.location();
-
-  if (!n->dim.has_value() && !l->dim.has_value() && !r->dim.has_value())
-    return true;
-
-  if (l->dim.has_value() && r->dim.has_value()) {
-    if (*l->dim != *r->dim) {
-      SYM_ERROR(s)
-          << "Addition expression's terms have different dimensionality: "
-          << *l->dim << " and " << *r->dim;
-      return false;
-    }
-  }
-  if (l->dim.has_value() || r->dim.has_value()) {
-    auto dim = l->dim.has_value() ? *l->dim : *r->dim;
-    if (!n->dim.has_value()) {
-      n->dim = dim;
-      progress_ = true;
-    } else if (*n->dim != dim) {
-      SYM_ERROR(s) << "Addition expression's dimensionality is deduced as both "
-                   << *n->dim << " and " << dim;
-      return false;
+bool ResolveUnits::operator()(const UnitExp& exp) {
+  // The name of the expression is its key in the table.
+  unit_name_.clear();
+  for (const auto& bit : exp.bits()) {
+    const char* sep = unit_name_.empty() ? "" : "*";
+    if (bit.exp < 0) sep = unit_name_.empty() ? "1/" : "/";
+    if (bit.exp == 1 || bit.exp == -1) {
+      absl::StrAppend(&unit_name_, sep, bit.id);
+    } else {
+      absl::StrAppend(&unit_name_, sep, bit.id, "^", std::abs(bit.exp));
     }
   }
 
-  CHECK(n->dim.has_value()) << "Expected unreachable";
-  if (l->dim.has_value() && r->dim.has_value()) return true;
-
-  if (!down_) return true;
-
-  if (!l->dim.has_value()) {
-    l->dim = *n->dim;
-    progress_ = true;
-    LOG(INFO) << "+< " << s.location();
-  } else {
-    CHECK(*l->dim == *n->dim) << "Expected unreachable";
-  }
-
-  if (!r->dim.has_value()) {
-    r->dim = *n->dim;
-    progress_ = true;
-    LOG(INFO) << "+> " << s.location();
-  } else {
-    CHECK(*r->dim == *n->dim) << "Expected unreachable";
-  }
+  unit_ = doc_->LookupUnitExpression(unit_name_);
+  if (unit_ != nullptr) return true;
 
+  Unit value = Unit::value();
+  if (!Product(exp, &value)) return false;
+  unit_ = doc_->AddUnitExpression(unit_name_, value);
   return true;
 }
 
-bool ResolveUnits::operator()(const DifExp& d) {
-  if (!d.left()->VisitNode(this) || !d.right()->VisitNode(this)) return false;
-
-  auto l = doc_->TryGetNode(d.left());
-  auto r = doc_->TryGetNode(d.right());
-  auto n = doc_->TryGetNode(&d);
-  CHECK(l != nullptr) << d.left()->location();
-  CHECK(r != nullptr) << d.right()->location();
-  CHECK(n != nullptr) << d.location();
+const Unit* ResolveUnits::FindUnit(const UnitExp::UnitT& bit) {
+  if (const auto u = doc_->LookupUnit(bit.id)) return u;
 
-  if (!n->dim.has_value() && !l->dim.has_value() && !r->dim.has_value())
-    return true;
-
-  if (l->dim.has_value() && r->dim.has_value()) {
-    if (*l->dim != *r->dim) {
-      SYM_ERROR(d)
-          << "Subtraction expression's terms have different dimensionality: "
-          << *l->dim << " and " << *r->dim;
-      return false;
+  const auto def = doc_->LookupUnitDef(bit.id);
+  if (def == nullptr) {
+    // A prefix on a unit that hasn't been resolved yet.
+    std::string base;
+    if (doc_->SplitPrefix(bit.id, &base) != 0) {
+      if (!FindUnit(UnitExp::UnitT{base, 1, bit.loc})) return nullptr;
+      return doc_->LookupUnit(bit.id);
     }
+    SYM_ERROR(bit.loc) << "Unit '" << bit.id << "' is not defined";
+    return nullptr;
   }
-  if (l->dim.has_value() || r->dim.has_value()) {
-    auto dim = l->dim.has_value() ? *l->dim : *r->dim;
-    if (!n->dim.has_value()) {
-      n->dim = dim;
-      progress_ = true;
-    } else if (*n->dim != dim) {
-      SYM_ERROR(d)
-          << "Subtraction expression's dimensionality is deduced as both "
-          << *n->dim << " and " << dim;
-      return false;
-    }
+  if (failed_.count(def)) return nullptr;
+  if (!resolving_.insert(def).second) {
+    SYM_ERROR(*def) << "Unit '" << def->name()
+                    << "' is defined in terms of itself";
+    failed_.insert(def);
+    return nullptr;
   }
 
-  CHECK(n->dim.has_value()) << "Expected unreachable";
-  if (l->dim.has_value() && r->dim.has_value()) return true;
-
-  if (!down_) return true;
-
-  if (!l->dim.has_value()) {
-    l->dim = *n->dim;
-    progress_ = true;
-    LOG(INFO) << "-< " << d.location();
-  } else {
-    CHECK(*l->dim == *n->dim) << "Expected unreachable";
+  bool ok = def->VisitNode(this);
+  resolving_.erase(def);
+  if (!ok) {
+    failed_.insert(def);
+    return nullptr;
   }
+  return doc_->LookupUnit(bit.id);
+}
 
-  if (!r->dim.has_value()) {
-    r->dim = *n->dim;
-    progress_ = true;
-    LOG(INFO) << "-> " << d.location();
-  } else {
-    CHECK(*r->dim == *n->dim) << "Expected unreachable";
+bool ResolveUnits::CheckUnused(const UnitDef* def) {
+  if (failed_.count(def)) return false;
+  if (checked_.count(def)) return true;
+  if (!resolving_.insert(def).second) {
+    SYM_ERROR(*def) << "Unit '" << def->name()
+                    << "' is defined in terms of itself";
+    failed_.insert(def);
+    return false;
   }
 
-  return true;
-}
+  bool ok = true;
+  for (const auto& bit : def->unit().bits()) {
+    if (doc_->LookupUnit(bit.id)) continue;
 
-bool ResolveUnits::operator()(const NegativeExp& n) {
-  if (!n.value()->VisitNode(this)) return false;
-
-  auto b = doc_->TryGetNode(n.value());
-  auto exp = doc_->TryGetNode(&n);
-  CHECK(b != nullptr);
-  CHECK(exp != nullptr);
-
-  if (!b->dim.has_value() && !exp->dim.has_value()) return true;
-
-  if (b->dim.has_value()) {
-    if (!exp->dim.has_value()) {
-      exp->dim = *b->dim;
-      progress_ = true;
-      return true;
-    } else if (*exp->dim != *b->dim) {
-      SYM_ERROR(n) << "Negation expression's dimensionality is deduced as both "
-                   << *exp->dim << " and " << *b->dim;
-      return false;
+    // Only the names matter, so follow them rather than resolving them.
+    auto dep = doc_->LookupUnitDef(bit.id);
+    std::string base;
+    if (dep == nullptr && doc_->SplitPrefix(bit.id, &base) != 0) {
+      dep = doc_->LookupUnitDef(base);
+    }
+    if (dep == nullptr) {
+      SYM_ERROR(bit.loc) << "Unit '" << bit.id << "' is not defined";
+      ok = false;
+    } else if (!CheckUnused(dep)) {
+      ok = false;
     }
-    return true;
   }
+  resolving_.erase(def);
 
-  if (!down_) return true;
-
-  CHECK(exp->dim.has_value());
-  CHECK(!b->dim.has_value());
-  b->dim = *exp->dim;
-  progress_ = true;
-  LOG(INFO) << "-. " << n.location();
+  if (!ok) failed_.insert(def);
+  checked_.insert(def);
+  return ok;
+}
 
+bool ResolveUnits::operator()(const UnitDef& unit) {
+  // Not from the table, the scale starts from the value.
+  Unit value = {unit.value(), Dimension::Dimensionless()};
+  if (!Product(unit.unit(), &value)) return false;
+  CHECK(doc_->AddUnit(unit.name(), value));
   return true;
 }
 
+bool ResolveUnits::ResolveAll() {
+  bool error = false;
+  for (const auto& def : doc_->unit_defs()) {
+    if (!FindUnit({def.first, 1, def.second->location()})) error = true;
+  }
+  return !error;
+}
+
 bool ResolveUnits::operator()(const Define& d) {
-  unit_value_ = {1.0, Dimension::Dimensionless()};
-  unit_name_ = "";
   if (!d.unit().VisitNode(this)) return false;
 
-  auto node = doc_->TryGetNamedNode(d.name());
-  node->dim = unit_value_.dim;
-  node->unit = unit_value_;
-  node->unit_name = unit_name_;
+  auto node = doc_->TryGetNamedNode(d.name())->meta;
+  node->dim = unit_->dim;
+  node->unit = unit_;
   return true;
 }
 
 bool ResolveUnits::operator()(const Specification& s) {
-  unit_value_ = {1.0, Dimension::Dimensionless()};
-  unit_name_ = "";
   if (!s.unit().VisitNode(this)) return false;
 
-  auto node = doc_->TryGetNamedNode(s.name());
-  node->dim = unit_value_.dim;
-  node->unit = unit_value_;
-  node->unit_name = unit_name_;
+  auto node = doc_->TryGetNamedNode(s.name())->meta;
+  node->dim = unit_->dim;
+  node->unit = unit_;
+  return true;
+}
+
+bool ResolveUnits::operator()(const Hint& h) {
+  if (!h.unit().VisitNode(this)) return false;
+
+  // Hints don't add to what is known about the dimensions, they only need
+  // to agree with it.
+  auto node = doc_->TryGetNamedNode(h.name())->meta;
+  if (node->dim.has_value() && *node->dim != unit_->dim) {
+    SYM_ERROR(h) << "Hint for '" << h.name() << "' has dimensionality "
+                 << unit_->dim << " but it is " << *node->dim;
+    return false;
+  }
+  node->start = h.value() * unit_->scale;
   return true;
 }
 
 bool ResolveUnits::operator()(const Document& doc) {
-  // Collect the set of units.
+  // Collect the set of units. They get resolved when first used.
   bool error = false;
-  for (auto ud : doc.unit_definition())
-    if (!ud->VisitNode(this)) error = true;
+  for (auto ud : doc.unit_definition()) {
+    if (!doc_->AddUnitDef(ud)) {
+      SYM_ERROR(*ud) << "Unit '" << ud->name() << "' already defined at TODO";
+      error = true;
+    }
+  }
 
   if (error) return false;
 
@@ -463,19 +430,25 @@ bool ResolveUnits::operator()(const Document& doc) {
   if (error) return false;
 
   // Assign units to everything else.
-  progress_ = true;
-  auto iteration_limit = absl::GetFlag(FLAGS_iteration_limit);
-  for (int pass = 0; (pass < iteration_limit && progress_); pass++) {
-    down_ = (pass > 0);
-    LOG(INFO) << (down_ ? "==== UP PASS ====" : "==== DOWN PASS ====");
-    progress_ = (pass <= 1);  // At least 2 passes;
-    for (auto e : doc.equality()) {
-      if (!e->VisitNode(this)) error = true;
-    }
-    if (error) return false;
-    // Loop as long as progress is being made.
+  InferDimensions infer(doc, doc_);
+  for (const auto& c : infer.conflicts()) {
+    SYM_ERROR(*c.first) << c.second.what << c.second.a << " and "
+                        << c.second.b;
+  }
+  if (!infer.conflicts().empty()) return false;
+  infer.Store();
+
+  // Check the hints against what was found.
+  for (auto h : doc.hints())
+    if (!h->VisitNode(this)) error = true;
+
+  // Definitions that were never used are not resolved, but still need to
+  // refer to units that exist, and not to themselves.
+  for (auto ud : doc.unit_definition()) {
+    if (doc_->LookupUnit(ud->name()) || failed_.count(ud)) continue;
+    if (!CheckUnused(ud)) error = true;
   }
-  LOG(INFO) << "==== DONE ====";
+  if (error) return false;
 
   return true;
 }
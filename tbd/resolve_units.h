@@ -28,7 +28,9 @@
 #ifndef TBD_RESOLVE_UNITS_H_
 #define TBD_RESOLVE_UNITS_H_
 
+#include <set>
 #include <string>
+#include <vector>
 
 #include "tbd/ast.h"
 #include "tbd/semantic.h"
@@ -41,29 +43,47 @@ class ResolveUnits final : public VisitNodesWithErrors {
   ResolveUnits(SemanticDocument* doc, ErrorSink e)
       : VisitNodesWithErrors(e), doc_(doc) {}
 
+  // Unit definitions are only resolved once they are used. This resolves
+  // the rest of them, e.g. to list every defined unit.
+  ABSL_MUST_USE_RESULT bool ResolveAll();
+
  private:
+  // Multiply the units of an expression into unit.
+  bool Product(const UnitExp& exp, Unit* unit);
+
+  // Look up a unit, resolving its definition on first use.
+  const Unit* FindUnit(const UnitExp::UnitT& bit);
+
+  // Check a definition that was never used, and so never resolved, for
+  // missing units and cycles.
+  bool CheckUnused(const UnitDef* def);
+
   bool operator()(const UnitExp&) override;
   bool operator()(const UnitDef&) override;
-  bool operator()(const Equality&) override;
-  bool operator()(const LiteralValue&) override;
-  bool operator()(const NamedValue&) override { return true; }
-  bool operator()(const PowerExp&) override;
-  bool operator()(const ProductExp&) override;
-  bool operator()(const QuotientExp&) override;
-  bool operator()(const SumExp&) override;
-  bool operator()(const DifExp&) override;
-  bool operator()(const NegativeExp&) override;
+  // The dimensions of expressions are inferred all at once, from the
+  // Document.
+  bool operator()(const Equality&) override { return false; }
+  bool operator()(const LiteralValue&) override { return false; }
+  bool operator()(const NamedValue&) override { return false; }
+  bool operator()(const PowerExp&) override { return false; }
+  bool operator()(const ProductExp&) override { return false; }
+  bool operator()(const QuotientExp&) override { return false; }
+  bool operator()(const SumExp&) override { return false; }
+  bool operator()(const DifExp&) override { return false; }
+  bool operator()(const NegativeExp&) override { return false; }
   bool operator()(const Define&) override;
   bool operator()(const Specification&) override;
+  bool operator()(const Hint&) override;
   bool operator()(const Document&) override;
 
   SemanticDocument* doc_;
-  bool down_ = false;      // propagate units downward;
-  bool progress_ = false;  // Set when a expressions unit it deduced.
 
   // Working data
-  Unit unit_value_ = Unit{0.0, Dimension::Dimensionless()};
+  const SemanticDocument::ResolvedUnit* unit_ = nullptr;  // Of a UnitExp.
   std::string unit_name_;
+  std::set<const UnitDef*> resolving_;  // To detect cycles.
+  std::set<const UnitDef*> failed_;     // Already reported.
+  std::set<const UnitDef*> checked_;    // Unused, but checked.
 };
 
 }  // namespace tbd
@@ -30,21 +30,20 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "tbd/ast.h"
+#include "tbd/parser.h"
 #include "tbd/semantic.h"
+#include "tbd/validate.h"
 
 namespace tbd {
 
-class ResolveUnitsTest : public ::testing::Test {
- public:
-  static std::unique_ptr<std::string> str(std::string s) {
-    return absl::make_unique<std::string>(std::move(s));
-  }
-};
+class ResolveUnitsTest : public ::testing::Test {};
 
 namespace {
 
@@ -59,22 +58,25 @@ TEST_F(ResolveUnitsTest, Smoke) {
   ResolveUnits ru(&sem, ResolveUnits::DefaultSink);
 
   Loc l;
-  doc.AddUnitDefinition(absl::make_unique<UnitDef>(
-      l, str("w"), absl::make_unique<LiteralValue>(l, 3),
-      absl::make_unique<UnitExp>(l)));
+  doc.AddUnitDefinition(doc.New<UnitDef>(l, "w", doc.New<LiteralValue>(l, 3),
+                                          doc.New<UnitExp>(l)));
 
-  auto ue = absl::make_unique<UnitExp>(l);
+  auto ue = doc.New<UnitExp>(l);
   ue->Mul(absl::WrapUnique(new UnitExp::UnitT{"w", 1, l}));
-  doc.AddUnitDefinition(absl::make_unique<UnitDef>(
-      l, str("x"), absl::make_unique<LiteralValue>(l, 5), std::move(ue)));
+  doc.AddUnitDefinition(
+      doc.New<UnitDef>(l, "x", doc.New<LiteralValue>(l, 5), ue));
 
-  ue = absl::make_unique<UnitExp>(l);
+  ue = doc.New<UnitExp>(l);
   ue->Mul(absl::WrapUnique(new UnitExp::UnitT{"w", 2, l}));
-  doc.AddUnitDefinition(absl::make_unique<UnitDef>(
-      l, str("y"), absl::make_unique<LiteralValue>(l, 7), std::move(ue)));
+  doc.AddUnitDefinition(
+      doc.New<UnitDef>(l, "y", doc.New<LiteralValue>(l, 7), ue));
 
   ASSERT_TRUE(doc.VisitNode(&ru));
 
+  // Nothing used them, so they haven't been resolved yet.
+  EXPECT_EQ(sem.LookupUnit("x"), nullptr);
+  ASSERT_TRUE(ru.ResolveAll());
+
   auto w = sem.LookupUnit("w");
   auto x = sem.LookupUnit("x");
   auto y = sem.LookupUnit("y");
@@ -90,5 +92,211 @@ TEST_F(ResolveUnitsTest, Smoke) {
   EXPECT_EQ(y->scale, 3 * 3 * 7);
 }
 
+UnitExp* Use(Document* doc, const std::string& id, int exp = 1) {
+  Loc l;
+  auto ue = doc->New<UnitExp>(l);
+  ue->Mul(absl::WrapUnique(new UnitExp::UnitT{id, exp, l}));
+  return ue;
+}
+
+TEST_F(ResolveUnitsTest, Lazy) {
+  Document doc;
+  SemanticDocument sem;
+  ResolveUnits ru(&sem, ResolveUnits::DefaultSink);
+
+  // Definitions can refer forward; only the used ones get resolved.
+  Loc l;
+  doc.AddUnitDefinition(doc.New<UnitDef>(l, "a", doc.New<LiteralValue>(l, 2),
+                                          Use(&doc, "b")));
+  doc.AddUnitDefinition(doc.New<UnitDef>(l, "b", doc.New<LiteralValue>(l, 3),
+                                          Use(&doc, "m")));
+  doc.AddUnitDefinition(doc.New<UnitDef>(l, "c", doc.New<LiteralValue>(l, 5),
+                                          Use(&doc, "m")));
+  ASSERT_TRUE(doc.VisitNode(&ru));
+  EXPECT_EQ(sem.LookupUnit("a"), nullptr);
+  EXPECT_EQ(sem.LookupUnit("b"), nullptr);
+
+  ASSERT_TRUE(Use(&doc, "a", 2)->VisitNode(&ru));
+  auto a = sem.LookupUnit("a");
+  auto b = sem.LookupUnit("b");
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+  EXPECT_EQ(a->scale, 2 * 3);
+  EXPECT_EQ(b->scale, 3);
+  EXPECT_EQ(a->dim, Dimension::L());
+  EXPECT_EQ(sem.LookupUnit("c"), nullptr);
+}
+
+TEST_F(ResolveUnitsTest, Prefix) {
+  using testing::ElementsAre;
+  using testing::HasSubstr;
+
+  std::vector<std::string> errors;
+  auto sink = [&errors](const std::string& e) { errors.push_back(e); };
+
+  Document doc;
+  SemanticDocument sem;
+  ResolveUnits ru(&sem, sink);
+
+  // A prefix on a definition that is yet to be resolved.
+  Loc l;
+  doc.AddUnitDefinition(doc.New<UnitDef>(l, "a", doc.New<LiteralValue>(l, 2),
+                                          Use(&doc, "kN")));
+  doc.AddUnitDefinition(doc.New<UnitDef>(l, "N", doc.New<LiteralValue>(l, 3),
+                                          Use(&doc, "m")));
+  ASSERT_TRUE(doc.VisitNode(&ru));
+  EXPECT_EQ(sem.LookupUnit("kN"), nullptr);
+
+  ASSERT_TRUE(Use(&doc, "a")->VisitNode(&ru));
+  auto kN = sem.LookupUnit("kN");
+  ASSERT_NE(kN, nullptr);
+  EXPECT_EQ(kN->scale, 3000);
+  EXPECT_EQ(sem.LookupUnit("a")->scale, 6000);
+  EXPECT_THAT(errors, testing::IsEmpty());
+
+  // Unknown names are still errors.
+  EXPECT_FALSE(Use(&doc, "kc")->VisitNode(&ru));
+  EXPECT_THAT(errors, ElementsAre(HasSubstr("Unit 'kc' is not defined")));
+
+  // As is a prefix on kg or a unit that isn't SI.
+  errors.clear();
+  EXPECT_FALSE(Use(&doc, "mkg")->VisitNode(&ru));
+  EXPECT_FALSE(Use(&doc, "ka")->VisitNode(&ru));
+  EXPECT_THAT(errors, ElementsAre(HasSubstr("Unit 'mkg' is not defined"),
+                                  HasSubstr("Unit 'ka' is not defined")));
+}
+
+TEST_F(ResolveUnitsTest, Cycle) {
+  using testing::ElementsAre;
+  using testing::HasSubstr;
+
+  Document doc;
+  SemanticDocument sem;
+  std::vector<std::string> errors;
+  ResolveUnits ru(&sem, [&errors](const std::string& e) {
+    errors.push_back(e);
+  });
+
+  Loc l;
+  doc.AddUnitDefinition(doc.New<UnitDef>(l, "a", doc.New<LiteralValue>(l, 2),
+                                          Use(&doc, "b")));
+  doc.AddUnitDefinition(doc.New<UnitDef>(l, "b", doc.New<LiteralValue>(l, 3),
+                                          Use(&doc, "a")));
+  // Found even though nothing uses them.
+  EXPECT_FALSE(doc.VisitNode(&ru));
+
+  EXPECT_FALSE(Use(&doc, "a")->VisitNode(&ru));
+  EXPECT_FALSE(ru.ResolveAll());
+  EXPECT_EQ(sem.LookupUnit("a"), nullptr);
+  EXPECT_EQ(sem.LookupUnit("b"), nullptr);
+
+  // Reported once, not for each use.
+  EXPECT_THAT(errors, ElementsAre(HasSubstr(
+                          "Unit 'a' is defined in terms of itself")));
+}
+
+// Each equation can only be resolved from the one after it.
+std::string Chain(int n) {
+  std::string ret = "v0 := 1 [m];\n";
+  for (int i = n; i > 0; i--) {
+    absl::StrAppend(&ret, "v", i, " = v", i - 1, " * 2;\n");
+  }
+  return ret;
+}
+
+TEST_F(ResolveUnitsTest, Chain) {
+  std::vector<std::string> errors;
+  auto sink = [&errors](const std::string& e) { errors.push_back(e); };
+
+  Document doc;
+  SemanticDocument sem;
+  ASSERT_EQ(Parse("chain", Chain(20), sink, &doc), 0);
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, sink).as_ptr()));
+  ASSERT_TRUE(doc.VisitNode(ResolveUnits(&sem, sink).as_ptr()));
+  EXPECT_THAT(errors, testing::IsEmpty());
+
+  for (int i = 0; i <= 20; i++) {
+    auto exp = sem.TryGetNamedNode(absl::StrCat("v", i));
+    ASSERT_NE(exp, nullptr) << i;
+    ASSERT_TRUE(exp->meta->dim.has_value()) << i;
+    EXPECT_EQ(*exp->meta->dim, Dimension::L()) << i;
+  }
+}
+
+TEST_F(ResolveUnitsTest, LongChain) {
+  auto sink = [](const std::string& e) { ADD_FAILURE() << e; };
+
+  Document doc;
+  SemanticDocument sem;
+  ASSERT_EQ(Parse("chain", Chain(200), sink, &doc), 0);
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, sink).as_ptr()));
+  ASSERT_TRUE(doc.VisitNode(ResolveUnits(&sem, sink).as_ptr()));
+
+  EXPECT_EQ(*sem.TryGetNamedNode("v200")->meta->dim, Dimension::L());
+}
+
+TEST_F(ResolveUnitsTest, Conflicts) {
+  using testing::AllOf;
+  using testing::ElementsAre;
+  using testing::HasSubstr;
+
+  std::vector<std::string> errors;
+  auto sink = [&errors](const std::string& e) { errors.push_back(e); };
+
+  // Each conflict is reported once, where the two dimensions meet.
+  Document doc;
+  SemanticDocument sem;
+  ASSERT_EQ(Parse("conflicts", R"(m := 1 [m];
+    s := 1 [s];
+    m = a * 2;
+    a = s;
+    b = m + s;
+    c = b;
+  )", sink, &doc), 0);
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, sink).as_ptr()));
+  EXPECT_FALSE(doc.VisitNode(ResolveUnits(&sem, sink).as_ptr()));
+
+  EXPECT_THAT(
+      errors,
+      ElementsAre(
+          AllOf(HasSubstr("conflicts:3:"),
+                HasSubstr("Multiplication expression's dimensionality is "
+                          "deduced as both [m] and [s]")),
+          AllOf(HasSubstr("conflicts:5:"),
+                HasSubstr("Addition expression's terms have different "
+                          "dimensionality: [m] and [s]"))));
+}
+
+TEST_F(ResolveUnitsTest, SharedExpressions) {
+  auto sink = [](const std::string& e) { ADD_FAILURE() << e; };
+
+  Document doc;
+  SemanticDocument sem;
+  ASSERT_EQ(Parse("shared", R"(
+    a := 1 [m/s^2];
+    b := 2 [m/s^2];
+    c := 3 [s^-1];
+    d := 4 [m*s^-1];
+    e := [1/s];
+    e = a * b * c * d / (a * b * d);
+  )", sink, &doc), 0);
+  ASSERT_TRUE(doc.VisitNode(Validate(&sem, sink).as_ptr()));
+  ASSERT_TRUE(doc.VisitNode(ResolveUnits(&sem, sink).as_ptr()));
+
+  auto unit = [&sem](const std::string& name) {
+    return sem.TryGetNamedNode(name)->meta->unit;
+  };
+  ASSERT_NE(unit("a"), nullptr);
+  EXPECT_EQ(unit("a"), unit("b"));
+  EXPECT_EQ(unit("c"), unit("e"));
+  EXPECT_NE(unit("a"), unit("d"));
+
+  EXPECT_EQ(unit("a")->name, "m/s^2");
+  EXPECT_EQ(unit("c")->name, "1/s");
+  EXPECT_EQ(unit("d")->name, "m/s");
+  EXPECT_EQ(sem.LookupUnitExpression("m/s^2"), unit("a"));
+  EXPECT_EQ(unit("a")->dim, Dimension::L() / pow(Dimension::T(), 2));
+}
+
 }  // namespace
 }  // namespace tbd
@@ -42,6 +42,7 @@ def gen_tbd(
         name = None,
         srcs = None,
         cpp = None,
+        hdr = None,
         dot = None,
         out = None,
         warnings_as_errors = False):
@@ -51,6 +52,8 @@ def gen_tbd(
       name: The target name.
       srcs: The input file.
       cpp: If set, generate a C++ implementation at the give location.
+      hdr: If set (along with cpp), generate the C++ declarations as a header
+        at the give location. It must be in the same package as cpp.
       dot: If set, generate a graphviz depiction at the give location.
       out: Output the resolved values at the give location.
       warnings_as_errors: Fail on warnings.
@@ -73,6 +76,12 @@ def gen_tbd(
         cmd += " --cpp_output=$(location " + cpp + ")"
         outs.append(cpp)
 
+    if hdr:
+        if not cpp:
+            fail("hdr requires cpp")
+        cmd += " --h_output=$(location " + hdr + ")"
+        outs.append(hdr)
+
     if dot:
         cmd += " --graphviz_output=$(location " + dot + ")"
         outs.append(dot)
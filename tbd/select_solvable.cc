@@ -27,9 +27,12 @@
 
 #include "tbd/select_solvable.h"
 
+#include <algorithm>
+#include <limits>
 #include <map>
 #include <queue>
 #include <set>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -38,22 +41,15 @@
 
 namespace tbd {
 
-bool FindSolution(std::map<int, std::set<int>>& from_to,  //
-                  std::set<int>* from, std::set<int>* to) {
-  // Validate inputs
-  {
-    std::set<int> e, v;
-    for (const auto &i : from_to) {
-      CHECK(!i.second.empty());
-      e.insert(i.first);
-      v.insert(i.second.begin(), i.second.end());
-    }
-    // Inputs are compact
-    CHECK(*e.begin() == 0) << *e.begin();
-    CHECK(*v.begin() == 0) << *v.begin();
-    CHECK(*e.rbegin() == (int)e.size() - 1) << *e.rbegin() << "!=" << e.size();
-    CHECK(*v.rbegin() == (int)v.size() - 1) << *e.rbegin() << "!=" << v.size();
-  }
+namespace {
+
+// Inputs bigger than this are not given to the exhaustive search.
+constexpr size_t kSearchLimit = 16;
+
+// The original exhaustive search. This finds the best solution but its cost
+// grows exponentially with the number of equations.
+bool SearchSolution(std::map<int, std::set<int>>& from_to,  //
+                    std::set<int>* from, std::set<int>* to) {
   auto working = from_to;
 
   // Step zero look for size 1 results.
@@ -71,9 +67,13 @@ bool FindSolution(std::map<int, std::set<int>>& from_to,  //
   // This needs to run iteratively becasue an equation with >2 variables, to
   // start with, can have that reduced by intial passes.
 
-  // Set up identity mapping
+  // Set up identity mapping (indexed by variable, not equation).
+  int vars = 0;
+  for (const auto& eq : from_to) {
+    vars = std::max(vars, *eq.second.rbegin() + 1);
+  }
   std::vector<int> equ_mapping;
-  equ_mapping.resize(from_to.size());
+  equ_mapping.resize(vars);
   for (size_t i = 0; i < equ_mapping.size(); i++) equ_mapping[i] = i;
 
   // As long as we find things to do, keep looping.
@@ -167,4 +167,371 @@ bool FindSolution(std::map<int, std::set<int>>& from_to,  //
 
   return false;
 }
+
+// A maximum matching between equations and variables (Hopcroft-Karp).
+// Unmatched equations and variables are paired with -1.
+class Matching {
+ public:
+  Matching(const std::vector<std::vector<int>>& uses, int vars)
+      : uses_(uses),
+        eq_var_(uses.size(), -1),
+        var_eq_(vars, -1),
+        dist_(uses.size()) {
+    while (Layer()) {
+      for (size_t e = 0; e < uses_.size(); e++) {
+        if (eq_var_[e] == -1) (void)Augment(e);
+      }
+    }
+  }
+
+  const std::vector<int>& eq_var() const { return eq_var_; }
+  const std::vector<int>& var_eq() const { return var_eq_; }
+
+ private:
+  static constexpr int kInf = std::numeric_limits<int>::max();
+
+  // Find the length of the shortest augmenting paths, labeling each
+  // equation with its distance from an unmatched equation.
+  bool Layer() {
+    std::queue<int> q;
+    for (size_t e = 0; e < uses_.size(); e++) {
+      dist_[e] = (eq_var_[e] == -1) ? 0 : kInf;
+      if (eq_var_[e] == -1) q.push(e);
+    }
+    bool found = false;
+    while (!q.empty()) {
+      int e = q.front();
+      q.pop();
+      for (int v : uses_[e]) {
+        int next = var_eq_[v];
+        if (next == -1) {
+          found = true;
+        } else if (dist_[next] == kInf) {
+          dist_[next] = dist_[e] + 1;
+          q.push(next);
+        }
+      }
+    }
+    return found;
+  }
+
+  // Follow the layers to a free variable and flip the path. The search
+  // keeps its own stack as paths can be as long as the system is large.
+  bool Augment(int root) {
+    path_.assign(1, {root, 0});
+    while (!path_.empty()) {
+      const int e = path_.back().first;
+      size_t& i = path_.back().second;
+      if (i == uses_[e].size()) {
+        dist_[e] = kInf;  // Dead end, don't come back.
+        path_.pop_back();
+        if (!path_.empty()) path_.back().second++;
+        continue;
+      }
+      const int next = var_eq_[uses_[e][i]];
+      if (next == -1) {
+        for (const auto& step : path_) {
+          const int v = uses_[step.first][step.second];
+          eq_var_[step.first] = v;
+          var_eq_[v] = step.first;
+        }
+        return true;
+      }
+      if (dist_[next] == dist_[e] + 1) {
+        path_.emplace_back(next, 0);
+      } else {
+        i++;
+      }
+    }
+    return false;
+  }
+
+  const std::vector<std::vector<int>>& uses_;
+  std::vector<int> eq_var_, var_eq_, dist_;
+  std::vector<std::pair<int, size_t>> path_;  // (equation, use) for Augment.
+};
+
+// Find the strongly connected components of a graph (Tarjan's algorithm).
+// Components are numbered in the order they are completed so a component
+// only has edges to components with lower numbers.
+std::vector<int> StronglyConnected(const std::vector<std::vector<int>>& edges,
+                                   int* count) {
+  const int n = edges.size();
+  std::vector<int> index(n, -1), low(n, 0), comp(n, -1), stack;
+  std::vector<std::pair<int, size_t>> call;
+  int next = 0;
+  *count = 0;
+  for (int root = 0; root < n; root++) {
+    if (index[root] != -1) continue;
+    call.emplace_back(root, 0);
+    index[root] = low[root] = next++;
+    stack.push_back(root);
+    while (!call.empty()) {
+      int v = call.back().first;
+      size_t& i = call.back().second;
+      if (i < edges[v].size()) {
+        int w = edges[v][i++];
+        if (index[w] == -1) {
+          index[w] = low[w] = next++;
+          stack.push_back(w);
+          call.emplace_back(w, 0);
+        } else if (comp[w] == -1) {
+          low[v] = std::min(low[v], index[w]);
+        }
+        continue;
+      }
+      call.pop_back();
+      if (!call.empty()) {
+        int p = call.back().first;
+        low[p] = std::min(low[p], low[v]);
+      }
+      if (low[v] == index[v]) {
+        int w;
+        do {
+          w = stack.back();
+          stack.pop_back();
+          comp[w] = *count;
+        } while (w != v);
+        ++*count;
+      }
+    }
+  }
+  return comp;
+}
+
+// The block-lower-triangular decomposition of a system.
+struct Blocks {
+  std::vector<std::vector<int>> uses;   // The variables of each equation.
+  std::vector<int> eq_var;              // The matched variable (or -1).
+  std::vector<int> comp;                // The block of each equation.
+  std::vector<std::vector<int>> eqs;    // The equations in each block.
+  std::vector<std::vector<int>> needs;  // The other blocks each depends on.
+  std::vector<bool> bad;                // Is the block over/under constrained.
+  std::vector<bool> ok;                 // Is the block solvable on its own.
+};
+
+Blocks Decompose(const std::map<int, std::set<int>>& from_to) {
+  Blocks ret;
+  const int eqs = from_to.size();
+  int vars = 0;
+  ret.uses.resize(eqs);
+  for (const auto& i : from_to) {
+    CHECK(i.first >= 0 && i.first < eqs) << i.first;
+    ret.uses[i.first].assign(i.second.begin(), i.second.end());
+    if (!i.second.empty()) vars = std::max(vars, *i.second.rbegin() + 1);
+  }
+
+  Matching matching(ret.uses, vars);
+  ret.eq_var = matching.eq_var();
+  const auto& var_eq = matching.var_eq();
+
+  // Equation a depends on b if a uses the variable matched to b.
+  // Anything that is unmatched or uses an unmatched variable is excluded.
+  std::vector<bool> bad(eqs, false);
+  std::vector<std::vector<int>> deps(eqs);
+  for (int e = 0; e < eqs; e++) {
+    if (ret.eq_var[e] == -1) bad[e] = true;
+    for (int v : ret.uses[e]) {
+      if (var_eq[v] == -1) {
+        bad[e] = true;
+      } else if (var_eq[v] != e) {
+        deps[e].push_back(var_eq[v]);
+      }
+    }
+  }
+
+  int count;
+  ret.comp = StronglyConnected(deps, &count);
+
+  ret.eqs.resize(count);
+  ret.needs.resize(count);
+  ret.bad.assign(count, false);
+  for (int e = 0; e < eqs; e++) {
+    const int c = ret.comp[e];
+    ret.eqs[c].push_back(e);
+    if (bad[e]) ret.bad[c] = true;
+    for (int d : deps[e]) {
+      if (ret.comp[d] != c) ret.needs[c].push_back(ret.comp[d]);
+    }
+  }
+
+  // Find the components that can be solved on their own.
+  ret.ok.resize(count);
+  for (int c = 0; c < count; c++) {
+    auto& needs = ret.needs[c];
+    std::sort(needs.begin(), needs.end());
+    needs.erase(std::unique(needs.begin(), needs.end()), needs.end());
+    ret.ok[c] = !ret.bad[c] && needs.empty();
+  }
+  return ret;
+}
+
+// Estimate how many variables need to be guessed (torn) to evaluate a
+// block. Whenever no equation has exactly one unknown left, the variable
+// used by the most equations is torn.
+int CountTears(const Blocks& blocks, int block) {
+  std::map<int, std::vector<int>> var_eqs;
+  std::map<int, int> unknown;  // Unknown count for each pending equation.
+  for (int e : blocks.eqs[block]) {
+    unknown[e] = blocks.uses[e].size();
+    for (int v : blocks.uses[e]) var_eqs[v].push_back(e);
+  }
+
+  std::set<int> known;
+  std::vector<int> ready;
+  auto learn = [&](int v) {
+    if (!known.insert(v).second) return;
+    for (int e : var_eqs[v]) {
+      auto it = unknown.find(e);
+      if (it != unknown.end() && --it->second == 1) ready.push_back(e);
+    }
+  };
+
+  int tears = 0;
+  for (;;) {
+    while (!ready.empty()) {
+      int e = ready.back();
+      ready.pop_back();
+      auto it = unknown.find(e);
+      if (it == unknown.end() || it->second != 1) continue;
+      unknown.erase(it);
+      for (int v : blocks.uses[e]) learn(v);
+    }
+    if (known.size() == var_eqs.size()) return tears;
+
+    int pick = -1, most = -1;
+    for (const auto& v : var_eqs) {
+      if (known.count(v.first)) continue;
+      int n = 0;
+      for (int e : v.second) n += unknown.count(e);
+      if (n > most) pick = v.first, most = n;
+    }
+    tears++;
+    learn(pick);
+  }
+}
+
+// Select the block that needs the fewest torn variables, preferring the
+// smaller of blocks that need the same number. Returns -1 if no block can
+// be solved on its own.
+int BestBlock(const Blocks& blocks, int* best_tears) {
+  int best = -1;
+  for (size_t c = 0; c < blocks.eqs.size(); c++) {
+    if (!blocks.ok[c]) continue;
+    int tears = CountTears(blocks, c);
+    if (best == -1 || tears < *best_tears ||
+        (tears == *best_tears &&
+         blocks.eqs[c].size() < blocks.eqs[best].size())) {
+      best = c;
+      *best_tears = tears;
+    }
+  }
+  return best;
+}
+
+void ExtractBlock(const Blocks& blocks, int block,  //
+                  std::set<int>* from, std::set<int>* to) {
+  for (int e : blocks.eqs[block]) {
+    from->insert(e);
+    to->insert(blocks.eq_var[e]);
+  }
+}
+
+// Select a block with a minimum of torn variables. Unlike the exhaustive
+// search, this only ever considers single (irreducible) blocks.
+bool MatchSolution(const std::map<int, std::set<int>>& from_to,  //
+                   std::set<int>* from, std::set<int>* to) {
+  Blocks blocks = Decompose(from_to);
+
+  int tears = 0;
+  int best = BestBlock(blocks, &tears);
+  if (best == -1) return false;
+
+  ExtractBlock(blocks, best, from, to);
+  LOG(INFO) << "free variables: " << tears;
+  return true;
+}
+
+}  // namespace
+
+bool FindSolution(std::map<int, std::set<int>>& from_to,  //
+                  std::set<int>* from, std::set<int>* to) {
+  if (from_to.empty()) return false;
+
+  // Validate inputs
+  {
+    std::set<int> e, v;
+    for (const auto &i : from_to) {
+      CHECK(!i.second.empty());
+      e.insert(i.first);
+      v.insert(i.second.begin(), i.second.end());
+    }
+    // Inputs are compact
+    CHECK(*e.begin() == 0) << *e.begin();
+    CHECK(*v.begin() == 0) << *v.begin();
+    CHECK(*e.rbegin() == (int)e.size() - 1) << *e.rbegin() << "!=" << e.size();
+    CHECK(*v.rbegin() == (int)v.size() - 1) << *e.rbegin() << "!=" << v.size();
+  }
+
+  if (from_to.size() <= kSearchLimit) return SearchSolution(from_to, from, to);
+  return MatchSolution(from_to, from, to);
+}
+
+bool FindBlock(std::map<int, std::set<int>>& from_to,  //
+               std::set<int>* from, std::set<int>* to) {
+  Blocks blocks = Decompose(from_to);
+
+  int tears = 0;
+  int best = BestBlock(blocks, &tears);
+  if (best == -1) return false;
+
+  ExtractBlock(blocks, best, from, to);
+  LOG(INFO) << "Found a block of " << blocks.eqs[best].size() << " from "
+            << blocks.eqs.size() << " needing " << tears << " torn variables";
+  return true;
+}
+
+bool OrderBlocks(std::map<int, std::set<int>>& from_to,  //
+                 std::vector<std::set<int>>* from,
+                 std::vector<std::set<int>>* to) {
+  Blocks blocks = Decompose(from_to);
+  const int count = blocks.eqs.size();
+
+  // Blocks only depend on ones with lower numbers, so whatever depends on
+  // a block that can't be solved is found in one pass.
+  std::vector<bool> bad = blocks.bad;
+  std::vector<int> waiting(count, 0);  // The count of unsolved needs.
+  std::vector<std::vector<int>> users(count);
+  for (int c = 0; c < count; c++) {
+    for (int n : blocks.needs[c]) {
+      if (bad[n]) bad[c] = true;
+      users[n].push_back(c);
+      waiting[c]++;
+    }
+  }
+
+  // (tears, size, block) of the blocks with nothing left to wait on.
+  using Ready = std::tuple<int, int, int>;
+  std::priority_queue<Ready, std::vector<Ready>, std::greater<Ready>> ready;
+  auto push = [&](int c) {
+    if (!bad[c]) ready.emplace(CountTears(blocks, c), blocks.eqs[c].size(), c);
+  };
+  for (int c = 0; c < count; c++) {
+    if (waiting[c] == 0) push(c);
+  }
+
+  while (!ready.empty()) {
+    const int c = std::get<2>(ready.top());
+    ready.pop();
+    from->emplace_back();
+    to->emplace_back();
+    ExtractBlock(blocks, c, &from->back(), &to->back());
+    for (int u : users[c]) {
+      if (--waiting[u] == 0) push(u);
+    }
+  }
+  LOG(INFO) << "Ordered " << from->size() << " blocks from " << count;
+  return !from->empty();
+}
+
 }  // namespace tbd
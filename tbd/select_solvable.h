@@ -28,8 +28,11 @@
 #ifndef TBD_SELECT_SOLVABLE_H_
 #define TBD_SELECT_SOLVABLE_H_
 
+#include <cstddef>
 #include <map>
 #include <set>
+#include <type_traits>
+#include <vector>
 
 namespace tbd {
 /////////////////////////////////////////////////////////////
@@ -50,42 +53,118 @@ namespace tbd {
 /////////////////////////////////////////////////////////////
 
 // The non-templated abstract version.
+//
+// Small inputs are searched exhaustively. Larger ones, where that would be
+// too slow, are decomposed into blocks and selected as by FindBlock.
 bool FindSolution(std::map<int, std::set<int>>& from_to,  //
                   std::set<int>* from, std::set<int>* to);
 
-// A templated version that maps a generic
-// problem to and from an abstract version.
-template <class M, class FS, class TS>
-bool FindSolution(const M& from_to, FS* from, TS* to) {
-  using F = typename FS::value_type;
-  using T = typename TS::value_type;
-  static_assert(std::is_same<typename M::key_type, F>::value,
-                "Type mis-match for 'From'");
-  static_assert(std::is_same<typename M::mapped_type::value_type, T>::value,
-                "Type mis-match for 'To'");
-
-  std::map<int, F> mf;
-  std::map<int, T> mt;
-  std::map<T, int> tm;
-  std::map<int, std::set<int>> inner_from_to;
-
-  for (const auto& i : from_to) {
-    mf.emplace(inner_from_to.size(), i.first);
-    auto& it = inner_from_to[inner_from_to.size()];
-
-    for (const auto& j : i.second) {
-      int n = tm.emplace(j, tm.size()).first->second;
-      it.insert(n);
-      mt.emplace(n, j);
+// Find the first block of a block-lower-triangular (BLT) decomposition.
+//
+// Each equation is matched with a distinct variable and the equations are
+// then grouped into strongly connected components; where equation A uses
+// the variable matched to equation B, A depends on B. A component that
+// depends on nothing outside of itself can be solved in insolation and,
+// because the components are irreducible, is as small as such a system
+// can be. Of those, the one that needs the fewest torn (guessed) variables
+// is selected, with ties going to the one with the fewest equations.
+//
+// Equations that are not matched or that use variables that are not
+// matched (the over and under constrained parts) are never selected.
+bool FindBlock(std::map<int, std::set<int>>& from_to,  //
+               std::set<int>* from, std::set<int>* to);
+
+// Order every block of the BLT decomposition (see FindBlock) so that each
+// comes after all the blocks it depends on. Of the blocks that are ready
+// at each point, the one FindBlock would select goes next. Blocks that
+// can't be solved, or that depend on one that can't, are left out.
+bool OrderBlocks(std::map<int, std::set<int>>& from_to,  //
+                 std::vector<std::set<int>>* from,
+                 std::vector<std::set<int>>* to);
+
+namespace internal {
+using AbstractFind = bool (*)(std::map<int, std::set<int>>&,  //
+                              std::set<int>*, std::set<int>*);
+
+// Map a generic problem to and from an abstract version.
+template <class M>
+class AbstractMap {
+ public:
+  using F = typename M::key_type;
+  using T = typename M::mapped_type::value_type;
+
+  explicit AbstractMap(const M& from_to) {
+    std::map<T, int> tm;
+    for (const auto& i : from_to) {
+      mf_.emplace(from_to_.size(), i.first);
+      auto& it = from_to_[from_to_.size()];
+
+      for (const auto& j : i.second) {
+        int n = tm.emplace(j, tm.size()).first->second;
+        it.insert(n);
+        mt_.emplace(n, j);
+      }
     }
   }
 
+  std::map<int, std::set<int>>& from_to() { return from_to_; }
+
+  template <class FS>
+  void From(const std::set<int>& inner, FS* from) const {
+    static_assert(std::is_same<typename FS::value_type, F>::value,
+                  "Type mis-match for 'From'");
+    for (const int i : inner) from->insert(mf_.at(i));
+  }
+  template <class TS>
+  void To(const std::set<int>& inner, TS* to) const {
+    static_assert(std::is_same<typename TS::value_type, T>::value,
+                  "Type mis-match for 'To'");
+    for (const int i : inner) to->insert(mt_.at(i));
+  }
+
+ private:
+  std::map<int, F> mf_;
+  std::map<int, T> mt_;
+  std::map<int, std::set<int>> from_to_;
+};
+
+template <class M, class FS, class TS>
+bool MapFind(AbstractFind find, const M& from_to, FS* from, TS* to) {
+  AbstractMap<M> map(from_to);
   std::set<int> inner_from, inner_to;
-  if (!FindSolution(inner_from_to, &inner_from, &inner_to)) return false;
+  if (!find(map.from_to(), &inner_from, &inner_to)) return false;
 
-  for (const int i : inner_from) from->insert(mf.at(i));
-  for (const int i : inner_to) to->insert(mt.at(i));
+  map.From(inner_from, from);
+  map.To(inner_to, to);
+  return true;
+}
+}  // namespace internal
 
+// Templated versions that maps a generic
+// problem to and from an abstract version.
+template <class M, class FS, class TS>
+bool FindSolution(const M& from_to, FS* from, TS* to) {
+  return internal::MapFind(&FindSolution, from_to, from, to);
+}
+
+template <class M, class FS, class TS>
+bool FindBlock(const M& from_to, FS* from, TS* to) {
+  return internal::MapFind(&FindBlock, from_to, from, to);
+}
+
+template <class M, class FS, class TS>
+bool OrderBlocks(const M& from_to, std::vector<FS>* from,
+                 std::vector<TS>* to) {
+  internal::AbstractMap<M> map(from_to);
+  std::vector<std::set<int>> inner_from, inner_to;
+  if (!OrderBlocks(map.from_to(), &inner_from, &inner_to)) return false;
+
+  from->resize(inner_from.size());
+  to->resize(inner_to.size());
+  for (std::size_t i = 0; i < inner_from.size(); i++) {
+    map.From(inner_from[i], &(*from)[i]);
+    map.To(inner_to[i], &(*to)[i]);
+  }
   return true;
 }
 
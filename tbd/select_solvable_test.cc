@@ -27,6 +27,11 @@
 
 #include "tbd/select_solvable.h"
 
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
@@ -47,11 +52,13 @@ void StripEnds(absl::string_view* data) {
 
 using SSV = std::pair<int, const char*>;
 using testing::Values;
-class SelectSolvable : public testing::TestWithParam<SSV> {};
 
-TEST_P(SelectSolvable, FindCase) {
-  int size_found = GetParam().first;
-  absl::string_view data = GetParam().second;
+// Parse a test case into a (shuffled) from-to mapping and the
+// expected results.
+void ParseCase(const SSV& param, std::map<int, std::set<int>>* from_to,
+               std::set<int>* r_exp, std::set<int>* c_exp) {
+  int size_found = param.first;
+  absl::string_view data = param.second;
   // Extract the mapping.
   StripEnds(&data);
 
@@ -77,24 +84,30 @@ TEST_P(SelectSolvable, FindCase) {
   }
 
   // Populate the from-to mapping using the shuffle
-  std::map<int, std::set<int>> from_to;
   for (std::size_t i = 0; i < rows.size(); i++) {
-    auto& to = from_to[r_shuf[i]];
+    auto& to = (*from_to)[r_shuf[i]];
     for (std::size_t j = 0; j < rows[i].length(); j++) {
       if (rows[i][j] == '1') to.insert(c_shuf[j]);
     }
   }
 
   // Compute the expected set of rows and columns
-  std::set<int> r_exp, c_exp;
   for (int i = 0; i < size_found; i++) {
-    r_exp.insert(r_shuf[i]);
-    c_exp.insert(c_shuf[i]);
+    r_exp->insert(r_shuf[i]);
+    c_exp->insert(c_shuf[i]);
   }
+}
+
+class SelectSolvable : public testing::TestWithParam<SSV> {};
+
+TEST_P(SelectSolvable, FindCase) {
+  std::map<int, std::set<int>> from_to;
+  std::set<int> r_exp, c_exp;
+  ASSERT_NO_FATAL_FAILURE(ParseCase(GetParam(), &from_to, &r_exp, &c_exp));
 
   std::set<int> r_result, c_result;
 
-  const bool success = (size_found > 0);
+  const bool success = (GetParam().first > 0);
   EXPECT_EQ(success, FindSolution<>(from_to, &r_result, &c_result));
 
   EXPECT_THAT(r_result, testing::ElementsAreArray(r_exp));
@@ -195,6 +208,14 @@ INSTANTIATE_TEST_SUITE_P(MutipleUnsolvable, SelectSolvable,
     0011
   )")));
 
+INSTANTIATE_TEST_SUITE_P(MoreVariables, SelectSolvable,
+  // Many more variables than equations.
+  Values(SSV(0, R"(
+    110000
+    001100
+    000011
+  )")));
+
 INSTANTIATE_TEST_SUITE_P(ComplexUnsolvable, SelectSolvable,
   // A two un-sovable equations.
   Values(SSV(0, R"(
@@ -203,5 +224,203 @@ INSTANTIATE_TEST_SUITE_P(ComplexUnsolvable, SelectSolvable,
     0011
   )")));
 
+TEST(SelectSolvable, LargeMinTearing) {
+  // 50 blocks of 3 equations that each use all 3 of their variables
+  // (needing 2 guesses) and one ring of 100 equations, each using the
+  // next variable around the ring (needing only 1 guess).
+  std::map<int, std::set<int>> from_to;
+  int n = 0;
+  for (int b = 0; b < 50; b++, n += 3) {
+    for (int i = 0; i < 3; i++) from_to[n + i] = {n, n + 1, n + 2};
+  }
+  const int ring = n;
+  for (int i = 0; i < 100; i++) {
+    from_to[ring + i] = {ring + i, ring + (i + 1) % 100};
+  }
+
+  std::set<int> r_result, c_result;
+  ASSERT_TRUE(FindSolution<>(from_to, &r_result, &c_result));
+  EXPECT_EQ(r_result.size(), 100);
+  EXPECT_EQ(*r_result.begin(), ring);
+  EXPECT_EQ(r_result, c_result);
+}
+
+TEST(SelectSolvable, LargeCoupled) {
+  // 400 equations that are all coupled together.
+  constexpr int kSize = 400;
+  std::map<int, std::set<int>> from_to;
+  for (int i = 0; i < kSize; i++) {
+    from_to[i] = {i, (i + 1) % kSize, (i * 7 + 3) % kSize};
+  }
+
+  std::set<int> r_result, c_result;
+  ASSERT_TRUE(FindSolution<>(from_to, &r_result, &c_result));
+  EXPECT_EQ(r_result.size(), kSize);
+  EXPECT_EQ(c_result.size(), kSize);
+}
+
+TEST(SelectSolvable, LargeUnsolvable) {
+  // Hundreds of equations with more variables than equations.
+  std::map<int, std::set<int>> from_to;
+  for (int i = 0; i < 300; i++) from_to[i] = {i, i + 1};
+
+  std::set<int> r_result, c_result;
+  EXPECT_FALSE(FindSolution<>(from_to, &r_result, &c_result));
+  EXPECT_TRUE(r_result.empty());
+  EXPECT_TRUE(c_result.empty());
+}
+
+class SelectBlock : public testing::TestWithParam<SSV> {};
+
+TEST_P(SelectBlock, FindCase) {
+  std::map<int, std::set<int>> from_to;
+  std::set<int> r_exp, c_exp;
+  ASSERT_NO_FATAL_FAILURE(ParseCase(GetParam(), &from_to, &r_exp, &c_exp));
+
+  std::set<int> r_result, c_result;
+
+  const bool success = (GetParam().first > 0);
+  EXPECT_EQ(success, FindBlock<>(from_to, &r_result, &c_result));
+
+  EXPECT_THAT(r_result, testing::ElementsAreArray(r_exp));
+  EXPECT_THAT(c_result, testing::ElementsAreArray(c_exp));
+}
+
+INSTANTIATE_TEST_SUITE_P(Single, SelectBlock,
+  // An equation with one unknown is a block on it's own.
+  Values(SSV(1, R"(
+    100
+    111
+    011
+  )")));
+
+INSTANTIATE_TEST_SUITE_P(Pair, SelectBlock,
+  // The smallest block.
+  Values(SSV(2, R"(
+    11
+    11
+  )")));
+
+INSTANTIATE_TEST_SUITE_P(Chained, SelectBlock,
+  // A block the rest of the system depends on.
+  Values(SSV(2, R"(
+    11000
+    11000
+    10110
+    01011
+    00111
+  )")));
+
+INSTANTIATE_TEST_SUITE_P(Smallest, SelectBlock,
+  // Two independent blocks, return the one needing fewer guesses.
+  Values(SSV(2, R"(
+    11000
+    11000
+    00111
+    00111
+    00111
+  )")));
+
+INSTANTIATE_TEST_SUITE_P(FewestTears, SelectBlock,
+  // A ring needing one guess is preferred to a smaller block needing two.
+  Values(SSV(4, R"(
+    1100000
+    0110000
+    0011000
+    1001000
+    0000111
+    0000111
+    0000111
+  )")));
+
+INSTANTIATE_TEST_SUITE_P(Cycle, SelectBlock,
+  // Equations that only close as a cycle.
+  Values(SSV(4, R"(
+    1100
+    0110
+    0011
+    1001
+  )")));
+
+INSTANTIATE_TEST_SUITE_P(UnderConstrained, SelectBlock,
+  // A block that is solvable next to an under constrained part.
+  Values(SSV(2, R"(
+    110000
+    110000
+    001110
+    000111
+  )")));
+
+INSTANTIATE_TEST_SUITE_P(Unsolvable, SelectBlock,
+  // Nothing is fully constrained.
+  Values(SSV(0, R"(
+    1100
+    0110
+    0011
+  )")));
+
+TEST(SelectBlock, Large) {
+  // A long chain of small blocks, each depending on the one before it.
+  constexpr int kBlocks = 500;
+  std::map<int, std::set<int>> from_to;
+  for (int i = 0; i < kBlocks; i++) {
+    std::set<int> vars = {2 * i, 2 * i + 1};
+    if (i > 0) vars.insert(2 * i - 1);
+    from_to[2 * i] = vars;
+    from_to[2 * i + 1] = vars;
+  }
+
+  std::set<int> r_result, c_result;
+  ASSERT_TRUE(FindBlock<>(from_to, &r_result, &c_result));
+  EXPECT_THAT(r_result, testing::ElementsAre(0, 1));
+  EXPECT_THAT(c_result, testing::ElementsAre(0, 1));
+}
+
+TEST(OrderBlocks, Order) {
+  std::map<std::string, std::set<std::string>> from_to = {
+      // Three equations that all use the same three variables.
+      {"a1", {"a", "b", "c"}},
+      {"a2", {"a", "b", "c"}},
+      {"a3", {"a", "b", "c"}},
+      // A pair and what depends on it.
+      {"p1", {"p", "q"}},
+      {"p2", {"p", "q"}},
+      {"r1", {"q", "r"}},
+      // Something that can't be solved and what depends on it.
+      {"u1", {"u", "v"}},
+      {"w1", {"u", "w"}},
+  };
+
+  // The pair needs fewer guesses than the triple and once it's solved
+  // what depends on it needs none.
+  using Set = std::set<std::string>;
+  std::vector<Set> from, to;
+  ASSERT_TRUE(OrderBlocks<>(from_to, &from, &to));
+  EXPECT_THAT(from, testing::ElementsAre(Set{"p1", "p2"}, Set{"r1"},
+                                         Set{"a1", "a2", "a3"}));
+  EXPECT_THAT(to, testing::ElementsAre(Set{"p", "q"}, Set{"r"},
+                                       Set{"a", "b", "c"}));
+}
+
+TEST(OrderBlocks, Large) {
+  // A long chain of small blocks, given in reverse.
+  constexpr int kBlocks = 2000;
+  std::map<int, std::set<int>> from_to;
+  for (int b = 0; b < kBlocks; b++) {
+    const int n = 2 * (kBlocks - b - 1);
+    from_to[n] = {n, n + 1};
+    from_to[n + 1] = {n, n + 1, n + 2};
+  }
+  from_to[2 * kBlocks - 1].erase(2 * kBlocks);
+
+  std::vector<std::set<int>> from, to;
+  ASSERT_TRUE(OrderBlocks<>(from_to, &from, &to));
+  ASSERT_EQ(from.size(), kBlocks);
+  for (int b = 0; b < kBlocks; b++) {
+    const int n = 2 * (kBlocks - b - 1);
+    EXPECT_THAT(from[b], testing::ElementsAre(n, n + 1)) << b;
+  }
+}
+
 }  // namespace
 }  // namespace tbd
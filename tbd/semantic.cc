@@ -27,17 +27,48 @@
 
 #include "tbd/semantic.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <set>
+#include <sstream>
 #include <string>
 #include <utility>
 
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
 #include "tbd/ast.h"
 #include "tbd/dimensions.h"
 
 namespace tbd {
+namespace {
+
+// Longest first so that "da" is tried before "d".
+const struct {
+  const char* name;
+  double scale;
+} kPrefixes[] = {
+    {"da", 1e1},  {"Q", 1e30},  {"R", 1e27},  {"Y", 1e24},  {"Z", 1e21},
+    {"E", 1e18},  {"P", 1e15},  {"T", 1e12},  {"G", 1e9},   {"M", 1e6},
+    {"k", 1e3},   {"h", 1e2},   {"d", 1e-1},  {"c", 1e-2},  {"m", 1e-3},
+    {"u", 1e-6},  {"n", 1e-9},  {"p", 1e-12}, {"f", 1e-15}, {"a", 1e-18},
+    {"z", 1e-21}, {"y", 1e-24}, {"r", 1e-27}, {"q", 1e-30},
+};
+
+// The units that take a prefix: the SI base units (with g in place of kg),
+// the derived units, and L and eV. Not "Tin" or "mmi".
+const std::set<absl::string_view>& Prefixable() {
+  static const auto* const kUnits = new std::set<absl::string_view>{
+      "m", "g",  "s",  "A", "K",  "mol", "cd", "Hz", "N", "Pa", "J",
+      "W", "C",  "V",  "F", "Ohm", "S",  "Wb", "T",  "H", "L",  "eV",
+  };
+  return *kUnits;
+}
+
+}  // namespace
+
 SemanticDocument::SemanticDocument()
     : units_{
           // Pre-populate with the base SI units.
@@ -52,10 +83,75 @@ bool SemanticDocument::AddUnit(const std::string& name, Unit unit) {
 
 const Unit* SemanticDocument::LookupUnit(const std::string& name) const {
   auto i = units_.find(name);
-  if (i == units_.end()) return nullptr;
+  if (i != units_.end()) return &i->second;
+
+  auto p = prefixed_.find(name);
+  if (p != prefixed_.end()) return &p->second;
+
+  // A definition by this name is resolved when first used.
+  if (unit_defs_.count(name)) return nullptr;
+
+  std::string base;
+  double scale = SplitPrefix(name, &base);
+  if (scale == 0) return nullptr;
+  auto b = units_.find(base);
+  if (b == units_.end()) return nullptr;  // Not resolved yet.
+
+  Unit u{scale * b->second.scale, b->second.dim};
+  return &prefixed_.emplace(name, u).first->second;
+}
+
+double SemanticDocument::SplitPrefix(const std::string& name,
+                                     std::string* base) const {
+  for (const auto& p : kPrefixes) {
+    absl::string_view rest = name;
+    if (!absl::ConsumePrefix(&rest, p.name) || rest.empty()) continue;
+    // Only one prefix, so "kkm" isn't a unit.
+    std::string b(rest);
+    if (!Prefixable().count(b)) continue;
+    if (!units_.count(b) && !unit_defs_.count(b)) continue;
+    *base = std::move(b);
+    return p.scale;
+  }
+  return 0;
+}
+
+bool SemanticDocument::AddUnitDef(const UnitDef* def) {
+  if (units_.count(def->name())) return false;
+  return unit_defs_.insert({def->name(), def}).second;
+}
+
+const UnitDef* SemanticDocument::LookupUnitDef(const std::string& name) const {
+  auto i = unit_defs_.find(name);
+  if (i == unit_defs_.end()) return nullptr;
+  return i->second;
+}
+
+const SemanticDocument::ResolvedUnit* SemanticDocument::LookupUnitExpression(
+    absl::string_view name) const {
+  auto i = unit_exps_.find(name);
+  if (i == unit_exps_.end()) return nullptr;
   return &i->second;
 }
 
+const SemanticDocument::ResolvedUnit* SemanticDocument::AddUnitExpression(
+    absl::string_view name, Unit u) {
+  auto i = unit_exps_.emplace(std::string(name), ResolvedUnit{u, ""});
+  CHECK(i.second) << name;
+  i.first->second.name = i.first->first;
+  return &i.first->second;
+}
+
+std::string SemanticDocument::Meta::units() const {
+  std::stringstream out(std::ios_base::out);
+  if (unit) {
+    out << "[" << unit->name << "]";
+  } else if (dim.has_value()) {
+    out << *dim;
+  }
+  return out.str();
+}
+
 void SemanticDocument::LogUnits(const UnitsOutput& out) const {
   for (const auto& unit : units_) {
     out.Output(unit.first, unit.second);
@@ -74,66 +170,72 @@ Exp* SemanticDocument::GetNodeForName(std::string name) {
   CHECK(add_name.second);
 
   // Unknown node name, create a new object.
-  auto n = absl::make_unique<Exp>();
-  n->name = name;
-  add_name.first->second = n.get();
-  ret = n.get();
-  nodes_.emplace_back(std::move(n));
+  ret = NewExp();
+  ret->meta->name = name;
+  add_name.first->second = ret;
 
   return ret;
 }
 
+Exp*& SemanticDocument::IdNode(const ExpressionNode* node) {
+  CHECK(node->id() >= 0) << "Not from Document::New: " << node->location();
+  const size_t id = node->id();
+  if (id >= id_nodes_.size()) {
+    id_nodes_.resize(std::max(id + 1, id_nodes_.size() * 2), nullptr);
+  }
+  return id_nodes_[id];
+}
+
 Exp* SemanticDocument::RefernceNamedNode(const NamedValue* node) {
   auto* ret = GetNodeForName(node->name());
-  if (ret->node == nullptr) ret->node = node;
-  auto add_node = id_nodes_.emplace(node, ret);
-  CHECK(add_node.first->second == ret);
+  if (ret->meta->node == nullptr) ret->meta->node = node;
+  auto& id_node = IdNode(node);
+  if (id_node == nullptr) id_node = ret;
+  CHECK(id_node == ret);
   ret->referenced = true;
   return ret;
 }
 
 Exp* SemanticDocument::GetNamedNode(const Define* node) {
-  auto add_node = id_nodes_.emplace(node, nullptr);
-  if (!add_node.second) {
-    return add_node.first->second;
-  }
+  auto& id_node = IdNode(node);
+  if (id_node != nullptr) return id_node;
 
   auto* ret = GetNodeForName(node->name());
-  add_node.first->second = ret;
+  id_node = ret;
 
-  if (ret->def == nullptr) ret->def = node;
-  if (ret->node == nullptr) ret->node = node;
+  if (ret->meta->def == nullptr) ret->meta->def = node;
+  if (ret->meta->node == nullptr) ret->meta->node = node;
 
   return ret;
 }
 
 Exp* SemanticDocument::GetUnnamedNode(const ExpressionNode* node) {
-  auto add_node = id_nodes_.emplace(node, nullptr);
-  if (!add_node.second) {
+  auto& id_node = IdNode(node);
+  if (id_node != nullptr) {
     LOG(ERROR) << "added duplicate node";
-    return add_node.first->second;
+    return id_node;
   }
 
-  auto n = absl::make_unique<Exp>();
-  n->node = node;
-  add_node.first->second = n.get();
-  auto* ret = n.get();
-  nodes_.emplace_back(std::move(n));
+  auto* ret = NewExp();
+  ret->meta->node = node;
+  id_node = ret;
 
   return ret;
 }
 
-Exp* SemanticDocument::GetNode() {
-  auto n = absl::make_unique<Exp>();
-  auto* ret = n.get();
-  nodes_.emplace_back(std::move(n));
-  return ret;
+Exp* SemanticDocument::NewExp() {
+  nodes_.emplace_back();
+  metas_.emplace_back();
+  nodes_.back().index = nodes_.size() - 1;
+  nodes_.back().meta = &metas_.back();
+  return &nodes_.back();
 }
 
+Exp* SemanticDocument::GetNode() { return NewExp(); }
+
 Exp* SemanticDocument::TryGetNode(ExpressionNode const* n) {
-  auto it = id_nodes_.find(n);
-  if (it == id_nodes_.end()) return nullptr;
-  return it->second;
+  const size_t id = n->id();
+  return id < id_nodes_.size() ? id_nodes_[id] : nullptr;
 }
 
 Exp* SemanticDocument::TryGetNamedNode(std::string name) {
@@ -145,33 +247,45 @@ Exp* SemanticDocument::TryGetNamedNode(std::string name) {
 std::vector<const Exp*> SemanticDocument::nodes() const {
   std::vector<const Exp*> ret;
   ret.reserve(nodes_.size());
-  for (const auto& n : nodes_) ret.push_back(n.get());
+  for (const auto& n : nodes_) ret.push_back(&n);
   return ret;
 }
 
+std::vector<double> SemanticDocument::Values() const {
+  std::vector<double> ret;
+  ret.reserve(nodes_.size());
+  for (const auto& n : nodes_) ret.push_back(n.value);
+  return ret;
+}
+
+void SemanticDocument::SetValues(const std::vector<double>& values) {
+  CHECK(values.size() == nodes_.size())
+      << values.size() << "!=" << nodes_.size();
+  for (auto& n : nodes_) n.value = values[n.index];
+}
+
 std::ostream& operator<<(std::ostream& out, const SemanticDocument::Exp& node) {
-  if (node.name.empty()) return out;
+  const auto& meta = *node.meta;
+  if (meta.name.empty()) return out;
 
-  out << node.name;
+  out << meta.name;
   if (!std::isnan(node.value)) {
     double v = node.value;
-    if (node.unit.has_value()) v /= node.unit->scale;
+    if (meta.unit) v /= meta.unit->scale;
     out << " = " << v;
   }
 
   out << ";";
   const char* x = "\t//";
 
-  if (node.unit.has_value()) {
-    out << x << " [" << node.unit_name << "]";
-    x = "";
-  } else if (node.dim.has_value()) {
-    out << x << " " << *node.dim;
+  const std::string units = meta.units();
+  if (!units.empty()) {
+    out << x << " " << units;
     x = "";
   }
 
-  if (node.node != nullptr) {
-    out << x << " " << node.node->location().line();
+  if (meta.node != nullptr) {
+    out << x << " " << meta.node->location().line();
     x = "";
   }
 
@@ -181,4 +295,9 @@ std::ostream& operator<<(std::ostream& out, const SemanticDocument::Exp& node) {
 
 const char* kPreamble = "<<preamble>>";
 
+bool InPreamble(const Loc& loc) {
+  static const int kFile = InternFileName(kPreamble);
+  return loc.file == kFile;
+}
+
 }  // namespace tbd
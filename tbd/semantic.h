@@ -28,12 +28,14 @@
 #ifndef TBD_SEMANTIC_H_
 #define TBD_SEMANTIC_H_
 
+#include <deque>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "tbd/ast.h"
 #include "tbd/dimensions.h"
@@ -50,26 +52,66 @@ class SemanticDocument final {
   SemanticDocument();
 
   bool AddUnit(const std::string& name, Unit u);
+  // Failing an exact match, a name made of an SI prefix and an added SI
+  // unit (e.g. "kPa") is found as a scaled copy of that unit.
   const Unit* LookupUnit(const std::string& name) const;
   void LogUnits(const UnitsOutput&) const;
 
-  struct Exp {
+  // Split an SI prefix off name, leaving the name of an SI unit that was
+  // added or has a definition in base. Returns the scale of the prefix, or 0 if none fits.
+  double SplitPrefix(const std::string& name, std::string* base) const;
+
+  // Unit definitions waiting to be resolved (by ResolveUnits) when first
+  // used. A name can't be both a defined unit and a unit definition.
+  bool AddUnitDef(const UnitDef* def);
+  const UnitDef* LookupUnitDef(const std::string& name) const;
+  const std::map<std::string, const UnitDef*>& unit_defs() const {
+    return unit_defs_;
+  }
+
+  // A unit expression (e.g. "m/s^2") and its value. Every node with the same
+  // units shares one of these.
+  struct ResolvedUnit : Unit {
+    std::string name;
+  };
+  const ResolvedUnit* LookupUnitExpression(absl::string_view name) const;
+  const ResolvedUnit* AddUnitExpression(absl::string_view name, Unit u);
+
+  // The descriptive part of a value. Mostly used while setting things up
+  // and for output.
+  struct Meta {
     std::string name;
 
     absl::optional<Dimension> dim = absl::nullopt;
-    absl::optional<Unit> unit = absl::nullopt;
-    std::string unit_name = "?";
+    const ResolvedUnit* unit = nullptr;
+    // As output: the units (e.g. "[m/s]"), or else the dimensions if they
+    // are known.
+    std::string units() const;
+
+    const Define* def = nullptr;
+    const Specification* spec = nullptr;
+    const Hint* hint = nullptr;
+    const ExpressionNode* node = nullptr;
+
+    // The starting guess, from the hint, when solving for this.
+    double start = 0;
+
+    // The expressions that need to be re-evaluated when this gets resolved.
+    std::vector<const ExpressionNode*> users;
+  };
+
+  // The state of a value. This is what evaluation works with so it's kept
+  // small and the document stores them together, apart from the Meta.
+  struct Exp {
+    double value = NAN;
 
     bool resolved = false;       // A way to solve for this has been found.
     bool equ_processed = false;  // This equation has been used.
     bool is_literal = false;     // This 'equation' is just a literal value.
-    double value = NAN;
-
     bool referenced = false;
 
-    const Define* def = nullptr;
-    const Specification* spec = nullptr;
-    const ExpressionNode* node = nullptr;
+    int index = -1;  // The position in the document, and so in a frame.
+    Meta* meta = nullptr;
   };
 
   Exp* GetNodeForName(std::string name);
@@ -85,13 +127,33 @@ class SemanticDocument final {
   // Get a named/unnamed node or null.
   Exp* TryGetNamedNode(std::string name);
   Exp* TryGetNode(const ExpressionNode* name);
+  Meta* TryGetMeta(const ExpressionNode* name) {
+    auto* ret = TryGetNode(name);
+    return ret ? ret->meta : nullptr;
+  }
   std::vector<const Exp*> nodes() const;
+  size_t node_count() const { return nodes_.size(); }
+
+  // The value of every node, by Exp::index. An evaluation frame starts
+  // from this.
+  std::vector<double> Values() const;
+  void SetValues(const std::vector<double>& values);
 
  private:
+  // The slot for a node in id_nodes_.
+  Exp*& IdNode(const ExpressionNode* node);
+
   std::map<std::string, Unit> units_;
+  mutable std::map<std::string, Unit> prefixed_;  // Found by LookupUnit.
+  std::map<std::string, const UnitDef*> unit_defs_;
+  std::map<std::string, ResolvedUnit, std::less<>> unit_exps_;
 
-  std::vector<std::unique_ptr<Exp>> nodes_;
-  std::map<const ExpressionNode*, Exp*> id_nodes_;
+  // Allocate a new Exp with its Meta.
+  Exp* NewExp();
+
+  std::deque<Exp> nodes_;  // Doesn't move things as it grows.
+  std::deque<Meta> metas_;
+  std::vector<Exp*> id_nodes_;  // By NodeI::id().
   std::map<std::string, Exp*> named_nodes_;
 };
 
@@ -100,6 +162,9 @@ std::ostream& operator<<(std::ostream&, const SemanticDocument::Exp&);
 // The source name used when parsing the preamble
 extern const char* kPreamble;
 
+// Is a location in the preamble? This compares file ids, not names.
+bool InPreamble(const Loc& loc);
+
 }  // namespace tbd
 
 #endif  // TBD_SEMANTIC_H_
@@ -72,6 +72,54 @@ TEST(SemanticDocument, Basic) {
   EXPECT_NE(doc.LookupUnit("foo"), nullptr);
 }
 
+TEST(SemanticDocument, Prefix) {
+  SemanticDocument doc;
+
+  auto km = doc.LookupUnit("km");
+  ASSERT_NE(km, nullptr);
+  EXPECT_EQ(km->scale, 1000);
+  EXPECT_EQ(km->dim, Dimension::L());
+  EXPECT_EQ(doc.LookupUnit("km"), km);  // Found once, then kept.
+
+  auto dam = doc.LookupUnit("dam");
+  ASSERT_NE(dam, nullptr);
+  EXPECT_EQ(dam->scale, 10);
+
+  // Not on kg, only on g.
+  EXPECT_EQ(doc.LookupUnit("mkg"), nullptr);
+  EXPECT_EQ(doc.LookupUnit("Mg"), nullptr);
+  EXPECT_TRUE(doc.AddUnit("g", Unit{0.001, Dimension::M()}));
+  auto Mg = doc.LookupUnit("Mg");
+  ASSERT_NE(Mg, nullptr);
+  EXPECT_EQ(Mg->scale, 1000);
+  EXPECT_EQ(Mg->dim, Dimension::M());
+
+  // Exact names win, and only one prefix is allowed.
+  EXPECT_EQ(doc.LookupUnit("cd")->dim, Dimension::J());
+  EXPECT_EQ(doc.LookupUnit("kkm"), nullptr);
+  EXPECT_EQ(doc.LookupUnit("k"), nullptr);
+  EXPECT_EQ(doc.LookupUnit("kN"), nullptr);
+
+  EXPECT_TRUE(doc.AddUnit("N", Unit{1, Dimension::M() * Dimension::L() /
+                                           pow(Dimension::T(), 2)}));
+  auto kN = doc.LookupUnit("kN");
+  ASSERT_NE(kN, nullptr);
+  EXPECT_EQ(kN->scale, 1000);
+
+  // Only SI units take a prefix.
+  EXPECT_TRUE(doc.AddUnit("in", Unit{0.0254, Dimension::L()}));
+  EXPECT_TRUE(doc.AddUnit("foo", Unit{3, Dimension::T()}));
+  EXPECT_EQ(doc.LookupUnit("Tin"), nullptr);
+  EXPECT_EQ(doc.LookupUnit("kfoo"), nullptr);
+
+  std::string base;
+  EXPECT_EQ(doc.SplitPrefix("MN", &base), 1e6);
+  EXPECT_EQ(base, "N");
+  EXPECT_EQ(doc.SplitPrefix("cm", &base), 0.01);
+  EXPECT_EQ(doc.SplitPrefix("Xm", &base), 0);
+  EXPECT_EQ(doc.SplitPrefix("Mfoo", &base), 0);
+}
+
 TEST(SemanticDocument, Dump) {
   using testing::HasSubstr;
 
@@ -91,17 +139,19 @@ TEST(SemanticDocument, Dump) {
 TEST(SemanticDocument, Unnamed) {
   SemanticDocument doc;
 
-  LiteralValue v1(Loc{}, 0), v2(Loc{}, 0);
+  Document ast;
+  auto &v1 = *ast.New<LiteralValue>(Loc{}, 0),
+       &v2 = *ast.New<LiteralValue>(Loc{}, 0);
 
   EXPECT_EQ(doc.TryGetNode(&v1), nullptr);  // Not yet added
 
   auto* e1 = doc.GetUnnamedNode(&v1);
   ASSERT_NE(e1, nullptr);
-  EXPECT_EQ(&v1, e1->node);
+  EXPECT_EQ(&v1, e1->meta->node);
 
   auto* e = doc.GetUnnamedNode(&v1);
   ASSERT_NE(e, nullptr);
-  EXPECT_EQ(&v1, e->node);  // Adding a second time just return the first.
+  EXPECT_EQ(&v1, e->meta->node);  // Adding a second time just return the first.
 
   EXPECT_EQ(e1, doc.TryGetNode(&v1));
 
@@ -109,7 +159,7 @@ TEST(SemanticDocument, Unnamed) {
 
   auto* e2 = doc.GetUnnamedNode(&v2);
   ASSERT_NE(e2, nullptr);
-  EXPECT_EQ(&v2, e2->node);
+  EXPECT_EQ(&v2, e2->meta->node);
 
   EXPECT_EQ(e2, doc.TryGetNode(&v2));
   EXPECT_EQ(e1, doc.TryGetNode(&v1));
@@ -118,18 +168,19 @@ TEST(SemanticDocument, Unnamed) {
 TEST(SemanticDocument, Named) {
   SemanticDocument doc;
 
-  Define v1(Loc{}, "n1", 1);
-  Define v2(Loc{}, "n2", 2);
+  Document ast;
+  auto& v1 = *ast.New<Define>(Loc{}, "n1", 1);
+  auto& v2 = *ast.New<Define>(Loc{}, "n2", 2);
 
   EXPECT_EQ(doc.TryGetNode(&v1), nullptr);  // Not yet added
 
   auto* e1 = doc.GetNamedNode(&v1);
   ASSERT_NE(e1, nullptr);
-  EXPECT_EQ(&v1, e1->node);
+  EXPECT_EQ(&v1, e1->meta->node);
 
   auto* e = doc.GetNamedNode(&v1);
   EXPECT_EQ(e, e1);
-  EXPECT_EQ(&v1, e->node);  // Adding a second time fails
+  EXPECT_EQ(&v1, e->meta->node);  // Adding a second time fails
 
   EXPECT_EQ(e1, doc.TryGetNode(&v1));
 
@@ -137,7 +188,7 @@ TEST(SemanticDocument, Named) {
 
   auto* e2 = doc.GetNamedNode(&v2);
   ASSERT_NE(e2, nullptr);
-  EXPECT_EQ(&v2, e2->node);
+  EXPECT_EQ(&v2, e2->meta->node);
 
   EXPECT_EQ(e1, doc.TryGetNode(&v1));
   EXPECT_EQ(e2, doc.TryGetNode(&v2));
@@ -145,8 +196,8 @@ TEST(SemanticDocument, Named) {
   EXPECT_EQ(e2, doc.TryGetNamedNode("n2"));
 
   // Now try with adding references
-  NamedValue n1(Loc{}, "n1");
-  NamedValue n3(Loc{}, "n3");
+  auto& n1 = *ast.New<NamedValue>(Loc{}, "n1");
+  auto& n3 = *ast.New<NamedValue>(Loc{}, "n3");
 
   EXPECT_EQ(doc.TryGetNamedNode("n3"), nullptr);
 
@@ -159,5 +210,14 @@ TEST(SemanticDocument, Named) {
   EXPECT_EQ(e3, doc.TryGetNamedNode("n3"));
 }
 
+TEST(SemanticDocument, InPreamble) {
+  Loc loc;
+  EXPECT_FALSE(InPreamble(loc));
+  loc.file = InternFileName(kPreamble);
+  EXPECT_TRUE(InPreamble(loc));
+  loc.file = InternFileName("other.tbd");
+  EXPECT_FALSE(InPreamble(loc));
+}
+
 }  // namespace
 }  // namespace tbd
\ No newline at end of file
@@ -27,16 +27,18 @@
 
 #include "tbd/tbd.h"
 
+#include <cerrno>
 #include <cstring>
-#include <fstream>
 #include <iostream>
-#include <iterator>
 #include <string>
+#include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/log/initialize.h"
 #include "absl/log/log.h"
+#include "tbd/mapped_file.h"
+#include "tbd/parser.h"
 
 ABSL_FLAG(std::string, src, "", "The file to read from");
 
@@ -44,9 +46,20 @@ ABSL_FLAG(std::string, graphviz_output, "",
           "Output the sysyem of equations in GraphVis format. "
           "Mostly for debugging");
 ABSL_FLAG(std::string, cpp_output, "",
-          "Output the sequnce of operation for solving for the unknowns as "
-          "C++ assignment expressions.");
+          "Output C++ code that computes the unknowns from the defined "
+          "values.");
+ABSL_FLAG(std::string, h_output, "",
+          "Output the declarations for --cpp_output as a C++ header.");
 ABSL_FLAG(bool, dump_units, false, "Dump the set of know units to stdout");
+ABSL_FLAG(std::string, solver, "newton",
+          "The solver to use for systems of equations: newton or broyden.");
+ABSL_FLAG(int, parse_threads, 0,
+          "The number of threads to parse large files with, 0 for one per "
+          "core. Files that get split are parsed from copies of the chunks "
+          "rather than in place.");
+ABSL_FLAG(std::string, sweep, "",
+          "NAME=start:stop:count; Evaluate over a range of values for a "
+          "defined value, outputting a row per point. Repeat for a grid.");
 
 class StreamSink : public tbd::ProcessOutput, public tbd::UnitsOutput {
  public:
@@ -64,6 +77,16 @@ class StreamSink : public tbd::ProcessOutput, public tbd::UnitsOutput {
 };
 
 int main(int argc, char** argv) {
+  std::vector<tbd::Sweep> sweeps;
+  for (const auto& s : tbd::GetSweeps(argc, argv)) {
+    sweeps.emplace_back();
+    if (!tbd::ParseSweep(s, &sweeps.back())) {
+      std::cerr << "Bad --sweep '" << s
+                << "', expected NAME=start:stop:count\n";
+      return 1;
+    }
+  }
+
   auto args = absl::ParseCommandLine(argc, argv);
   absl::InitializeLog();
 
@@ -73,20 +96,37 @@ int main(int argc, char** argv) {
   }
   LOG(INFO) << absl::GetFlag(FLAGS_src);
 
-  std::ifstream in;
-  in.open(absl::GetFlag(FLAGS_src), std::ios::in);
-  if (in.fail()) {
+  tbd::Solver solver;
+  if (absl::GetFlag(FLAGS_solver) == "newton") {
+    solver = tbd::Solver::kNewton;
+  } else if (absl::GetFlag(FLAGS_solver) == "broyden") {
+    solver = tbd::Solver::kBroyden;
+  } else {
+    LOG(ERROR) << "Unknown --solver '" << absl::GetFlag(FLAGS_solver) << "'";
+    return 1;
+  }
+
+  // Map the file and parse it where it is rather than copying it.
+  auto file = tbd::MappedFile::Open(absl::GetFlag(FLAGS_src));
+  if (!file) {
     LOG(ERROR) << "'" << absl::GetFlag(FLAGS_src)
                << "': " << std::strerror(errno);
     return 1;
   }
-  std::string file_string(std::istreambuf_iterator<char>(in), {});
-  in.close();
 
   StreamSink out(std::cerr);
 
-  auto processed = tbd::ProcessInput(absl::GetFlag(FLAGS_src), file_string, out);
+  // Parsing in place is done on one thread, so only parse from copies of
+  // the chunks when the file is big enough to be parsed in parallel.
+  const int parse_threads = absl::GetFlag(FLAGS_parse_threads);
+  auto processed =
+      tbd::ChunkCount(file->contents().size(), parse_threads) == 1
+          ? tbd::ProcessInput(absl::GetFlag(FLAGS_src), file->buffer(), out,
+                              solver)
+          : tbd::ProcessInput(absl::GetFlag(FLAGS_src), file->contents(), out,
+                              solver, parse_threads);
   if (!processed) return 1;
+  file.reset();
 
   if (absl::GetFlag(FLAGS_dump_units)) processed->sem.LogUnits(out);
 
@@ -97,11 +137,16 @@ int main(int argc, char** argv) {
   }
 
   if (!absl::GetFlag(FLAGS_cpp_output).empty() &&
-      !RenderCpp(absl::GetFlag(FLAGS_cpp_output), *processed)) {
+      !RenderCpp(absl::GetFlag(FLAGS_cpp_output),
+                 absl::GetFlag(FLAGS_h_output), *processed)) {
     LOG(ERROR) << "Failed to render '" << absl::GetFlag(FLAGS_src)
                << "' as C++";
   }
 
+  if (!sweeps.empty()) {
+    return tbd::RunSweep(*processed, sweeps, out, std::cout) ? 0 : 1;
+  }
+
   for (const auto& l : tbd::GetValues(*processed)) {
     std::cout << l;
   }
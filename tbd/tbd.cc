@@ -28,37 +28,51 @@
 #include "tbd/tbd.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "absl/types/span.h"
 #include "tbd/ast.h"
 #include "tbd/evaluate.h"
 #include "tbd/gen_code.h"
 #include "tbd/graphviz.h"
 #include "tbd/parser.h"
-#include "tbd/preamble_emebed_data.h"
+#include "tbd/preamble.h"
 #include "tbd/resolve_units.h"
 #include "tbd/validate.h"
 
 
 namespace tbd {
 
-std::unique_ptr<FullDocument> ProcessInput(const std::string& src,
-                                           const std::string& file_string,
-                                           const ProcessOutput& out) {
+namespace {
+// Parse the input into the document, reporting errors to the sink.
+using ParseFn = std::function<int(std::function<void(const std::string&)>,
+                                  Document*)>;
+
+std::unique_ptr<FullDocument> Process(const std::string& src,
+                                      const ParseFn& parse,
+                                      const ProcessOutput& out,
+                                      Solver solver) {
   auto outp = [&out](const std::string &s) { out.Error(s); };
   auto ret = absl::make_unique<FullDocument>(outp);
+  ret->eva.set_solver(solver);
 
-  CHECK(Parse(kPreamble, ::tbd_preamble_tbd(), outp, &ret->doc) == 0);
+  AddPreamble(&ret->sem, &ret->doc);
 
-  if (int rc = Parse(src, file_string, outp, &ret->doc)) {
+  if (int rc = parse(outp, &ret->doc)) {
     out.Error("Parse failed with rc=", rc);
     return nullptr;
   }
@@ -79,6 +93,31 @@ std::unique_ptr<FullDocument> ProcessInput(const std::string& src,
   }
   return ret;
 }
+}  // namespace
+
+std::unique_ptr<FullDocument> ProcessInput(const std::string& src,
+                                           absl::string_view file_string,
+                                           const ProcessOutput& out,
+                                           Solver solver, int parse_threads) {
+  return Process(
+      src,
+      [&](std::function<void(const std::string&)> outp, Document* doc) {
+        return Parse(src, file_string, outp, doc, parse_threads);
+      },
+      out, solver);
+}
+
+std::unique_ptr<FullDocument> ProcessInput(const std::string& src,
+                                           absl::Span<char> buffer,
+                                           const ProcessOutput& out,
+                                           Solver solver) {
+  return Process(
+      src,
+      [&](std::function<void(const std::string&)> outp, Document* doc) {
+        return ParseBuffer(src, buffer, outp, doc);
+      },
+      out, solver);
+}
 
 bool RenderGraphViz(const std::string& sink, FullDocument &full) {
   std::ofstream out;
@@ -91,7 +130,8 @@ bool RenderGraphViz(const std::string& sink, FullDocument &full) {
 std::vector<std::string> GetValues(FullDocument &full) {
   std::vector<std::string> lines;
   for (const auto* node : full.sem.nodes()) {
-    if (node->node && node->node->location().filename == kPreamble) continue;
+    const auto* src = node->meta->node;
+    if (src && InPreamble(src->location())) continue;
     std::stringstream out(std::ios_base::out);
     out << *node;
     lines.emplace_back(out.str());
@@ -100,33 +140,174 @@ std::vector<std::string> GetValues(FullDocument &full) {
   return lines;
 }
 
-bool RenderCpp(const std::string &sink, FullDocument &full) {
-  std::ofstream out;
-  out.open(sink, std::ios::out);
-  CHECK(!out.fail()) << sink << ": " << std::strerror(errno);
+bool RenderCpp(const std::string &src, const std::string &hdr,
+               FullDocument &full) {
+  std::ofstream src_out;
+  src_out.open(src, std::ios::out);
+  CHECK(!src_out.fail()) << src << ": " << std::strerror(errno);
 
-  bool success = true;
-  CodeEvaluate code(out);
-  for (const auto s : full.eva.GetStages()) {
-    out << "// Simple\n";
-    for (const auto& op : s->direct_ops) {
-      if (!op->VisitOp(&code)) {
-        LOG(ERROR) << "Error generateding C++ for opertion at "
-                   << op->location();
-        success = false;
-      }
+  std::ofstream hdr_out;
+  absl::string_view header_name = hdr;
+  if (!hdr.empty()) {
+    hdr_out.open(hdr, std::ios::out);
+    CHECK(!hdr_out.fail()) << hdr << ": " << std::strerror(errno);
+    // The header is expected to end up next to the source.
+    header_name = header_name.substr(header_name.find_last_of('/') + 1);
+  }
+
+  // Name the namespace after the file.
+  absl::string_view name = src;
+  name = name.substr(name.find_last_of('/') + 1);
+  name = name.substr(0, name.find('.'));
+
+  return RenderCppModel(full.sem, full.eva.GetStages(), name, src_out,
+                        hdr.empty() ? nullptr : &hdr_out, header_name);
+}
+
+bool ParseSweep(const std::string &spec, Sweep *sweep) {
+  std::vector<std::string> name_range = absl::StrSplit(spec, '=');
+  if (name_range.size() != 2 || name_range[0].empty()) return false;
+  std::vector<std::string> range = absl::StrSplit(name_range[1], ':');
+  if (range.size() != 3) return false;
+
+  sweep->name = name_range[0];
+  return absl::SimpleAtod(range[0], &sweep->start) &&
+         absl::SimpleAtod(range[1], &sweep->stop) &&
+         absl::SimpleAtoi(range[2], &sweep->count) && sweep->count >= 1;
+}
+
+std::vector<std::string> GetSweeps(int argc, char **argv) {
+  std::vector<std::string> ret;
+  for (int i = 1; i < argc; i++) {
+    absl::string_view arg = argv[i];
+    if (arg == "--") break;
+    if (!absl::ConsumePrefix(&arg, "--sweep") &&
+        !absl::ConsumePrefix(&arg, "-sweep")) {
+      continue;
     }
-    out << "// system\n";
-    for (const auto& op : s->solve_ops) {
-      if (!op->VisitOp(&code)) {
-        LOG(ERROR) << "Error generateding C++ for opertion at "
-                   << op->location();
-        success = false;
-      }
+    if (absl::ConsumePrefix(&arg, "=")) {
+      ret.emplace_back(arg);
+    } else if (arg.empty() && i + 1 < argc) {
+      ret.emplace_back(argv[++i]);
     }
   }
+  return ret;
+}
 
-  return success;
+bool RunSweep(FullDocument &full, const std::vector<Sweep> &sweeps,
+              const ProcessOutput &out, std::ostream &rows) {
+  std::vector<const SemanticDocument::Exp *> swept;
+  for (const auto &s : sweeps) {
+    auto *node = full.sem.TryGetNamedNode(s.name);
+    if (node == nullptr || node->meta->def == nullptr) {
+      out.Error("Only defined values can be swept, not '", s.name, "'");
+      return false;
+    }
+    swept.push_back(node);
+  }
+
+  // Output every named value, by name.
+  std::vector<const SemanticDocument::Exp *> cols;
+  for (const auto *node : full.sem.nodes()) {
+    if (node->meta->name.empty()) continue;
+    const auto* src = node->meta->node;
+    if (src && InPreamble(src->location())) continue;
+    cols.push_back(node);
+  }
+  std::sort(cols.begin(), cols.end(),
+            [](const SemanticDocument::Exp *a, const SemanticDocument::Exp *b) {
+              return a->meta->name < b->meta->name;
+            });
+
+  const char *sep = "";
+  for (const auto *c : cols) {
+    const std::string units = c->meta->units();
+    rows << sep << c->meta->name << (units.empty() ? "" : " ") << units;
+    sep = "\t";
+  }
+  rows << "\n";
+
+  // What each stage reads and computes, to find what a failed solve spoils.
+  const auto stages = full.eva.GetStages();
+  std::vector<std::vector<int>> inputs, outputs, solved;
+  for (const auto *stage : stages) {
+    inputs.push_back(stage->plan.Inputs());
+    outputs.push_back(stage->plan.Outputs());
+    solved.push_back(stage->plan.Solved());
+  }
+
+  // Work in a frame of our own so the document keeps its values.
+  Evaluate::Frame frame = full.eva.NewFrame();
+  std::vector<bool> unsolved(frame.values.size(), false);
+  bool ok = true;
+  std::vector<int> at(sweeps.size(), 0);
+  for (bool more = true; more;) {
+    for (size_t i = 0; i < sweeps.size(); i++) {
+      const auto &s = sweeps[i];
+      double v = s.start;
+      if (s.count > 1) v += (s.stop - s.start) * at[i] / (s.count - 1);
+      if (swept[i]->meta->unit) v *= swept[i]->meta->unit->scale;
+      frame.values[swept[i]->index] = v;
+    }
+
+    full.eva.Run(&frame);
+
+    // Whatever a failed solve left behind isn't an answer, and neither is
+    // anything computed from it. Those stages start over at the next point.
+    bool failed = false;
+    for (size_t i = 0; i < stages.size(); i++) {
+      const auto &stage = *stages[i];
+      if (!stage.solve_ops.empty() && !frame.stats[i].converged) {
+        std::stringstream error;
+        error << stage.solve_ops.front()->location()
+              << ": Failed to solve the system of " << stage.count
+              << " equations starting here for";
+        for (size_t j = 0; j < sweeps.size(); j++) {
+          double v = frame.values[swept[j]->index];
+          if (swept[j]->meta->unit) v /= swept[j]->meta->unit->scale;
+          error << (j ? ", " : " ") << sweeps[j].name << "=" << v;
+        }
+        error << ": " << frame.stats[i];
+        out.Error(error.str());
+
+        // The direct part doesn't depend on the solution.
+        failed = true;
+        for (int s : solved[i]) unsolved[s] = true;
+        continue;
+      }
+
+      bool bad = false;
+      for (size_t k = 0; failed && !bad && k < inputs[i].size(); k++) {
+        bad = unsolved[inputs[i][k]];
+      }
+      if (!bad) continue;
+      for (int o : outputs[i]) unsolved[o] = true;
+      frame.solutions[i] = VXd{};
+    }
+
+    sep = "";
+    for (const auto *c : cols) {
+      double v = frame.values[c->index];
+      if (c->meta->unit) v /= c->meta->unit->scale;
+      if (unsolved[c->index]) v = std::nan("");
+      rows << sep << v;
+      sep = "\t";
+    }
+    rows << std::endl;
+
+    if (failed) {
+      ok = false;
+      std::fill(unsolved.begin(), unsolved.end(), false);
+    }
+
+    // Step to the next point.
+    more = false;
+    for (int i = sweeps.size() - 1; i >= 0 && !more; i--) {
+      more = (++at[i] < sweeps[i].count);
+      if (!more) at[i] = 0;
+    }
+  }
+  return ok;
 }
 
 }  // namespace tbd
\ No newline at end of file
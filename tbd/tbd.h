@@ -29,8 +29,12 @@
 #define TBD_TBD_H_
 
 #include <memory>
+#include <ostream>
 #include <string>
+#include <vector>
 
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "tbd/ast.h"
 #include "tbd/evaluate.h"
 #include "tbd/semantic.h"
@@ -54,15 +58,50 @@ class ProcessOutput {
   virtual void Error(const std::string &str) const = 0;
 };
 
+// Parse and evaluate a document. See Parse() for parse_threads.
 std::unique_ptr<FullDocument> ProcessInput(const std::string &src,
-                                           const std::string &file_string,
-                                           const ProcessOutput& out);
+                                           absl::string_view file_string,
+                                           const ProcessOutput& out,
+                                           Solver solver = Solver::kNewton,
+                                           int parse_threads = 1);
+// As above, but parse the input in place (on one thread). See ParseBuffer().
+std::unique_ptr<FullDocument> ProcessInput(const std::string &src,
+                                           absl::Span<char> buffer,
+                                           const ProcessOutput& out,
+                                           Solver solver = Solver::kNewton);
 
 bool RenderGraphViz(const std::string& sink, FullDocument &full);
-bool RenderCpp(const std::string &src, FullDocument &full);
+// Render the document as C++ source at src. If hdr is not empty, put the
+// declarations in a header there.
+bool RenderCpp(const std::string &src, const std::string &hdr,
+               FullDocument &full);
 
 std::vector<std::string> GetValues(FullDocument &full);
 
+// A range of values to sweep a defined value over.
+struct Sweep {
+  std::string name;
+  double start = 0, stop = 0;
+  int count = 0;
+};
+
+// Parse a sweep from "NAME=start:stop:count".
+bool ParseSweep(const std::string &spec, Sweep *sweep);
+
+// Collect the value of every --sweep (or -sweep) in a command line, in
+// order. Flags only keep the last value given.
+std::vector<std::string> GetSweeps(int argc, char **argv);
+
+// Evaluate the document at every point of the grid formed by the sweeps
+// (the last one varying fastest) and write the values for each as a row of
+// tab separated values. The evaluation plan is reused and each solve starts
+// from the solution for the point before it. The values in the document are
+// left as they were. If a system fails to solve, what it would have found,
+// and anything computed from that, is NaN in that row and an error names
+// the system; the rest of the points are still run, but false is returned.
+bool RunSweep(FullDocument &full, const std::vector<Sweep> &sweeps,
+              const ProcessOutput &out, std::ostream &rows);
+
 }  // namespace tbd
 
 #endif  // TBD_TBD_H_
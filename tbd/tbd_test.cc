@@ -0,0 +1,182 @@
+// Copyright (c) 2018, Benjamin Shropshire,
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+//    may be used to endorse or promote products derived from this software
+//    without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tbd/tbd.h"
+
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_split.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace tbd {
+namespace {
+
+using testing::AllOf;
+using testing::DoubleNear;
+using testing::ElementsAre;
+using testing::HasSubstr;
+using testing::IsEmpty;
+
+class Errors : public ProcessOutput {
+ public:
+  void Error(const std::string &str) const override { errors.push_back(str); }
+  mutable std::vector<std::string> errors;
+};
+
+// The rows of tab separated values, as lines of cells.
+std::vector<std::vector<std::string>> Cells(const std::string &rows) {
+  std::vector<std::vector<std::string>> ret;
+  for (absl::string_view line : absl::StrSplit(rows, '\n')) {
+    if (!line.empty()) ret.push_back(absl::StrSplit(line, '\t'));
+  }
+  return ret;
+}
+
+// The cells of a row as numbers.
+std::vector<double> Values(const std::vector<std::string> &cells) {
+  std::vector<double> ret;
+  for (const auto &c : cells) ret.push_back(std::stod(c));
+  return ret;
+}
+
+testing::Matcher<double> Near(double v) { return DoubleNear(v, 1e-3); }
+
+TEST(ParseSweep, Good) {
+  Sweep sweep;
+  ASSERT_TRUE(ParseSweep("x=1:2.5:4", &sweep));
+  EXPECT_EQ(sweep.name, "x");
+  EXPECT_EQ(sweep.start, 1);
+  EXPECT_EQ(sweep.stop, 2.5);
+  EXPECT_EQ(sweep.count, 4);
+}
+
+TEST(ParseSweep, Bad) {
+  Sweep sweep;
+  EXPECT_FALSE(ParseSweep("x1:2:3", &sweep));     // No '='.
+  EXPECT_FALSE(ParseSweep("=1:2:3", &sweep));     // No name.
+  EXPECT_FALSE(ParseSweep("x=1:2", &sweep));      // No count.
+  EXPECT_FALSE(ParseSweep("x=1:2:3:4", &sweep));  // Too much.
+  EXPECT_FALSE(ParseSweep("x=a:2:3", &sweep));    // Bad start.
+  EXPECT_FALSE(ParseSweep("x=1:2:c", &sweep));    // Bad count.
+  EXPECT_FALSE(ParseSweep("x=1:2:2.5", &sweep));  // Count isn't whole.
+  EXPECT_FALSE(ParseSweep("x=1:2:0", &sweep));    // No points.
+  EXPECT_FALSE(ParseSweep("x=1:2:-1", &sweep));
+}
+
+TEST(GetSweeps, Args) {
+  const char *args[] = {"tbd",    "--sweep=a=1:2:3", "--src=x.tbd",
+                        "-sweep", "b=4:5:6",         "--sweeper=c",
+                        "--",     "--sweep=d=7:8:9"};
+  EXPECT_THAT(GetSweeps(8, const_cast<char **>(args)),
+              ElementsAre("a=1:2:3", "b=4:5:6"));
+
+  // A trailing --sweep has no value.
+  const char *trailing[] = {"tbd", "--sweep=a=1:2:3", "--sweep"};
+  EXPECT_THAT(GetSweeps(3, const_cast<char **>(trailing)),
+              ElementsAre("a=1:2:3"));
+}
+
+TEST(RunSweep, OnlyDefined) {
+  Errors out;
+  auto full = ProcessInput("test", "a := 2 [m]; b = a * 3;", out);
+  ASSERT_NE(full, nullptr);
+  ASSERT_THAT(out.errors, IsEmpty());
+
+  std::stringstream rows;
+  EXPECT_FALSE(RunSweep(*full, {Sweep{"b", 1, 2, 2}}, out, rows));
+  EXPECT_FALSE(RunSweep(*full, {Sweep{"c", 1, 2, 2}}, out, rows));
+  EXPECT_THAT(
+      out.errors,
+      ElementsAre(HasSubstr("Only defined values can be swept, not 'b'"),
+                  HasSubstr("Only defined values can be swept, not 'c'")));
+}
+
+TEST(RunSweep, Grid) {
+  Errors out;
+  auto full = ProcessInput("test", R"(
+    a := 1 [km];
+    b := 1 [s];
+    c = a * b;
+    d = c * 2;
+  )", out);
+  ASSERT_NE(full, nullptr);
+  ASSERT_THAT(out.errors, IsEmpty());
+
+  // The last sweep varies fastest, and both are in the value's own units.
+  std::stringstream rows;
+  ASSERT_TRUE(RunSweep(*full, {Sweep{"a", 1, 2, 2}, Sweep{"b", 3, 5, 3}},
+                       out, rows));
+  EXPECT_THAT(out.errors, IsEmpty());
+  EXPECT_THAT(
+      Cells(rows.str()),
+      ElementsAre(ElementsAre("a [km]", "b [s]", "c [m,s]", "d [m,s]"),
+                  ElementsAre("1", "3", "3000", "6000"),
+                  ElementsAre("1", "4", "4000", "8000"),
+                  ElementsAre("1", "5", "5000", "10000"),
+                  ElementsAre("2", "3", "6000", "12000"),
+                  ElementsAre("2", "4", "8000", "16000"),
+                  ElementsAre("2", "5", "10000", "20000")));
+
+  // The document keeps its own values.
+  EXPECT_EQ(full->sem.TryGetNamedNode("c")->value, 1000);
+}
+
+TEST(RunSweep, Unsolved) {
+  Errors out;
+  auto full = ProcessInput("test", R"(
+    a := 4;
+    x * x = a;
+    x ~= 1;
+    y = x + 1;
+    z = a * 2;
+  )", out);
+  ASSERT_NE(full, nullptr);
+  ASSERT_THAT(out.errors, IsEmpty());
+
+  // Nothing squared is -1, but the next point still starts from the hint.
+  std::stringstream rows;
+  EXPECT_FALSE(RunSweep(*full, {Sweep{"a", -1, 9, 3}}, out, rows));
+  EXPECT_THAT(
+      out.errors,
+      ElementsAre(AllOf(HasSubstr("test:3:"),
+                        HasSubstr("Failed to solve the system of 1 equations "
+                                  "starting here for a=-1"))));
+
+  auto cells = Cells(rows.str());
+  ASSERT_EQ(cells.size(), 4);
+  EXPECT_THAT(cells[0], ElementsAre("a []", "x []", "y []", "z []"));
+  EXPECT_THAT(cells[1], ElementsAre("-1", "nan", "nan", "-2"));
+  EXPECT_THAT(Values(cells[2]), ElementsAre(4, Near(2), Near(3), 8));
+  EXPECT_THAT(Values(cells[3]), ElementsAre(9, Near(3), Near(4), 18));
+}
+
+}  // namespace
+}  // namespace tbd
@@ -27,6 +27,8 @@
 
 #include "tbd/validate.h"
 
+#include <initializer_list>
+
 #include "absl/flags/flag.h"
 #include "absl/log/check.h"
 #include "tbd/ast.h"
@@ -36,31 +38,46 @@ ABSL_FLAG(bool, warnings_as_errors, false, "");
 
 namespace tbd {
 
+void Validate::Uses(const ExpressionNode& user,
+                    std::initializer_list<const ExpressionNode*> values) {
+  for (const auto* v : values) {
+    auto* exp = doc_->TryGetNode(v);
+    CHECK(exp != nullptr) << v->location();
+    exp->meta->users.push_back(&user);
+  }
+}
+
 bool Validate::Process(const BinaryExpression& e) {
   doc_->GetUnnamedNode(&e);
   if (!e.left()->VisitNode(this) || !e.right()->VisitNode(this)) return false;
+  Uses(e, {&e, e.left(), e.right()});
   return true;
 }
 
 bool Validate::operator()(const Equality& e) {
   doc_->GetUnnamedNode(&e);
   if (!e.left()->VisitNode(this) || !e.right()->VisitNode(this)) return false;
+  Uses(e, {&e, e.left(), e.right()});
   return true;
 }
 
 bool Validate::operator()(const LiteralValue& v) {
   doc_->GetUnnamedNode(&v)->is_literal = true;
+  Uses(v, {&v});
   return true;
 }
 
 bool Validate::operator()(const NamedValue& n) {
   doc_->RefernceNamedNode(&n);
+  Uses(n, {&n});
   return true;
 }
 
 bool Validate::operator()(const PowerExp& e) {
   doc_->GetUnnamedNode(&e);
-  return e.base()->VisitNode(this);
+  if (!e.base()->VisitNode(this)) return false;
+  Uses(e, {&e, e.base()});
+  return true;
 }
 
 bool Validate::operator()(const ProductExp& p) { return Process(p); }
@@ -70,16 +87,18 @@ bool Validate::operator()(const DifExp& d) { return Process(d); }
 
 bool Validate::operator()(const NegativeExp& n) {
   doc_->GetUnnamedNode(&n);
-  return n.value()->VisitNode(this);
+  if (!n.value()->VisitNode(this)) return false;
+  Uses(n, {&n, n.value()});
+  return true;
 }
 
 bool Validate::operator()(const Define& d) {
   bool error = false;
   SemanticDocument::Exp* e = doc_->GetNamedNode(&d);
   CHECK(e != nullptr);
-  if (&d != e->node) {
+  if (&d != e->meta->node) {
     SYM_ERROR(d) << "duplicate definition for '" << d.name()
-                 << "'. Prior definition at " << e->def->location();
+                 << "'. Prior definition at " << e->meta->def->location();
     error = true;
   }
   return !error;
@@ -88,17 +107,34 @@ bool Validate::operator()(const Define& d) {
 bool Validate::operator()(const Specification& s) {
   SemanticDocument::Exp* e = doc_->GetNodeForName(s.name());
   CHECK(e != nullptr);
-  if (e->def != nullptr) {
+  if (e->meta->def != nullptr) {
     SYM_ERROR(s) << "duplicate specification for '" << s.name()
-                 << "'. Prior definition at " << e->def->location();
+                 << "'. Prior definition at " << e->meta->def->location();
     return false;
   }
-  if (e->spec != nullptr) {
+  if (e->meta->spec != nullptr) {
     SYM_ERROR(s) << "duplicate specification for '" << s.name()
-                 << "'. Prior specification at " << e->spec->location();
+                 << "'. Prior specification at " << e->meta->spec->location();
+    return false;
+  }
+  e->meta->spec = &s;
+  return true;
+}
+
+bool Validate::operator()(const Hint& h) {
+  SemanticDocument::Exp* e = doc_->GetNodeForName(h.name());
+  CHECK(e != nullptr);
+  if (e->meta->def != nullptr) {
+    SYM_ERROR(h) << "hint for '" << h.name() << "', which is defined at "
+                 << e->meta->def->location();
     return false;
   }
-  e->spec = &s;
+  if (e->meta->hint != nullptr) {
+    SYM_ERROR(h) << "duplicate hint for '" << h.name() << "'. Prior hint at "
+                 << e->meta->hint->location();
+    return false;
+  }
+  e->meta->hint = &h;
   return true;
 }
 
@@ -108,16 +144,24 @@ bool Validate::operator()(const Document& doc) {
     if (!d->VisitNode(this)) error = true;
   for (auto d : doc.specs())
     if (!d->VisitNode(this)) error = true;
+  for (auto h : doc.hints())
+    if (!h->VisitNode(this)) error = true;
   for (auto e : doc.equality())
     if (!e->VisitNode(this)) error = true;
 
   bool warning = false;
   for (const auto& i : doc_->nodes()) {
-    if (i->def == nullptr) continue;
-    if (i->def->location().filename == kPreamble) continue;
+    if (i->meta->def == nullptr) continue;
+    if (InPreamble(i->meta->def->location())) continue;
     if (i->referenced) continue;
 
-    SYM_ERROR(*i->def) << "Unused definition for '" << i->def->name() << "'.";
+    SYM_ERROR(*i->meta->def)
+        << "Unused definition for '" << i->meta->def->name() << "'.";
+    warning = true;
+  }
+  for (auto h : doc.hints()) {
+    if (doc_->TryGetNamedNode(h->name())->referenced) continue;
+    SYM_ERROR(*h) << "Hint for unused value '" << h->name() << "'.";
     warning = true;
   }
 
@@ -28,6 +28,8 @@
 #ifndef TBD_VALIDATE_H_
 #define TBD_VALIDATE_H_
 
+#include <initializer_list>
+
 #include "tbd/ast.h"
 #include "tbd/semantic.h"
 
@@ -39,6 +41,9 @@ class Validate final : public VisitNodesWithErrors {
       : VisitNodesWithErrors(e), doc_(doc) {}
 
  private:
+  // Record that evaluating `user` depends on the given values.
+  void Uses(const ExpressionNode& user,
+            std::initializer_list<const ExpressionNode*> values);
   bool Process(const BinaryExpression&);
 
   bool operator()(const UnitExp&) override { return false; }
@@ -54,6 +59,7 @@ class Validate final : public VisitNodesWithErrors {
   bool operator()(const NegativeExp&) override;
   bool operator()(const Define&) override;
   bool operator()(const Specification&) override;
+  bool operator()(const Hint&) override;
   bool operator()(const Document&) override;
 
   SemanticDocument* doc_;
@@ -27,34 +27,33 @@
 
 #include "tbd/validate.h"
 
-#include "absl/memory/memory.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 namespace tbd {
 namespace {
 
-std::unique_ptr<LiteralValue> Make(float l) {
-  return absl::make_unique<LiteralValue>(Loc{}, l);
-}
 
 TEST(Validate, TODO) {
   Loc l{};
   double e = 2.7182, p = 3.1415;
 
-  Equality equ{Loc{}, Make(e), Make(p)};
-  PowerExp pow{Loc{}, Make(e), 3};
-  ProductExp mul{Make(e), Make(p)};
-  QuotientExp div{Make(e), Make(p)};
-  SumExp add{Make(e), Make(p)};
-  DifExp sub{Make(e), Make(p)};
-  NegativeExp neg{Loc{}, Make(e)};
+  Document ast;
+  auto Make = [&ast](float l) { return ast.New<LiteralValue>(Loc{}, l); };
+
+  const ExpressionNode* all[] = {
+      ast.New<Equality>(Loc{}, Make(e), Make(p)),
+      ast.New<PowerExp>(Loc{}, Make(e), 3),
+      ast.New<ProductExp>(Make(e), Make(p)),
+      ast.New<QuotientExp>(Make(e), Make(p)),
+      ast.New<SumExp>(Make(e), Make(p)),
+      ast.New<DifExp>(Make(e), Make(p)),
+      ast.New<NegativeExp>(Loc{}, Make(e)),
+  };
 
   SemanticDocument doc;
   Validate val{&doc, &Validate::DefaultSink};
 
-  const ExpressionNode* all[] = {&equ, &pow, &mul, &div, &add, &sub, &neg};
-
   // Validate everything
   for (const ExpressionNode* exp : all) {
     (void)exp->VisitNode(&val);
@@ -1,5 +1,89 @@
-// Simple
-// system
-a = @src[0];
-b = (((19 + 0) - (a * 5)) / 7);
-@des[0] = (((8 + 0) - (a * 2)) - (b * 3));
+// Generated by tbd. Do not edit.
+#include "abstract_d2_lin.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace abstract_d2_lin {
+namespace {
+
+[[maybe_unused]] constexpr double e = 2.718281828459045;
+[[maybe_unused]] constexpr double g0 = 9.80665;
+[[maybe_unused]] constexpr double pi = 3.141592653589793;
+
+// Solve residual(x) = 0 by Newton's method, starting from x.
+template <int N, class F>
+bool tbd_solve(F residual, double (&x)[N]) {
+  constexpr double kTolerance = 1e-9;
+  double y[N], x_d[N], y_d[N], jac[N][N];
+  for (int cycle = 0; cycle < 50; cycle++) {
+    residual(x, y);
+    double err = 0;
+    for (int i = 0; i < N; i++) err = std::fmax(err, std::fabs(y[i]));
+    if (err < kTolerance) return true;
+
+    // Find the Jacobian by finite differences.
+    for (int j = 0; j < N; j++) {
+      for (int i = 0; i < N; i++) x_d[i] = x[i];
+      const double h = 1e-7 * std::fmax(1.0, std::fabs(x[j]));
+      x_d[j] += h;
+      residual(x_d, y_d);
+      for (int i = 0; i < N; i++) jac[i][j] = (y_d[i] - y[i]) / h;
+    }
+
+    // Solve jac * d = y by Gaussian elimination with partial pivoting.
+    for (int k = 0; k < N; k++) {
+      int p = k;
+      for (int i = k + 1; i < N; i++) {
+        if (std::fabs(jac[i][k]) > std::fabs(jac[p][k])) p = i;
+      }
+      if (!(std::fabs(jac[p][k]) > 0)) break;
+      for (int j = 0; j < N; j++) std::swap(jac[k][j], jac[p][j]);
+      std::swap(y[k], y[p]);
+      for (int i = k + 1; i < N; i++) {
+        const double f = jac[i][k] / jac[k][k];
+        for (int j = k; j < N; j++) jac[i][j] -= f * jac[k][j];
+        y[i] -= f * y[k];
+      }
+    }
+    for (int k = N - 1; k >= 0; k--) {
+      for (int j = k + 1; j < N; j++) y[k] -= jac[k][j] * y[j];
+      y[k] /= jac[k][k];
+    }
+    for (int i = 0; i < N; i++) x[i] -= y[i];
+  }
+
+  // Leave the values as computed from the final guess.
+  residual(x, y);
+  double err = 0;
+  for (int i = 0; i < N; i++) err = std::fmax(err, std::fabs(y[i]));
+  return err < kTolerance;
+}
+
+}  // namespace
+
+bool Evaluate([[maybe_unused]] const Inputs& tbd_in,
+              [[maybe_unused]] Outputs* tbd_out) {
+  bool tbd_ok = true;
+
+  double a = std::numeric_limits<double>::quiet_NaN();
+  double b = std::numeric_limits<double>::quiet_NaN();
+
+  // Stage 0
+  {
+    auto tbd_residual = [&](const double (&tbd_src)[1], double (&tbd_des)[1]) {
+      a = tbd_src[0];
+      b = (((19.0 + 0.0) - (a * 5.0)) / 7.0);
+      tbd_des[0] = (((8.0 + 0.0) - (a * 2.0)) - (b * 3.0));
+    };
+    double tbd_x[1] = {};
+    tbd_ok = tbd_solve(tbd_residual, tbd_x) && tbd_ok;
+  }
+
+  tbd_out->a = a;
+  tbd_out->b = b;
+  return tbd_ok;
+}
+
+}  // namespace abstract_d2_lin
@@ -0,0 +1,25 @@
+// Generated by tbd. Do not edit.
+#ifndef ABSTRACT_D2_NONLIN_1_H_
+#define ABSTRACT_D2_NONLIN_1_H_
+
+#include <limits>
+
+namespace abstract_d2_nonlin_1 {
+
+// The defined values.
+struct Inputs {
+};
+
+// The computed values. Anything that can't be found is NaN.
+struct Outputs {
+  double a = std::numeric_limits<double>::quiet_NaN();  // []
+  double b = std::numeric_limits<double>::quiet_NaN();  // []
+};
+
+// Compute the outputs from the inputs. Returns false if a system
+// of equations did not converge.
+bool Evaluate(const Inputs& tbd_in, Outputs* tbd_out);
+
+}  // namespace abstract_d2_nonlin_1
+
+#endif  // ABSTRACT_D2_NONLIN_1_H_
@@ -0,0 +1,28 @@
+// Generated by tbd. Do not edit.
+#ifndef ABSTRACT_D5_LIN_H_
+#define ABSTRACT_D5_LIN_H_
+
+#include <limits>
+
+namespace abstract_d5_lin {
+
+// The defined values.
+struct Inputs {
+};
+
+// The computed values. Anything that can't be found is NaN.
+struct Outputs {
+  double a = std::numeric_limits<double>::quiet_NaN();  // []
+  double b = std::numeric_limits<double>::quiet_NaN();  // []
+  double c = std::numeric_limits<double>::quiet_NaN();  // []
+  double d = std::numeric_limits<double>::quiet_NaN();  // []
+  double f = std::numeric_limits<double>::quiet_NaN();  // []
+};
+
+// Compute the outputs from the inputs. Returns false if a system
+// of equations did not converge.
+bool Evaluate(const Inputs& tbd_in, Outputs* tbd_out);
+
+}  // namespace abstract_d5_lin
+
+#endif  // ABSTRACT_D5_LIN_H_
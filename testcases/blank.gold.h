@@ -0,0 +1,23 @@
+// Generated by tbd. Do not edit.
+#ifndef BLANK_H_
+#define BLANK_H_
+
+#include <limits>
+
+namespace blank {
+
+// The defined values.
+struct Inputs {
+};
+
+// The computed values. Anything that can't be found is NaN.
+struct Outputs {
+};
+
+// Compute the outputs from the inputs. Returns false if a system
+// of equations did not converge.
+bool Evaluate(const Inputs& tbd_in, Outputs* tbd_out);
+
+}  // namespace blank
+
+#endif  // BLANK_H_
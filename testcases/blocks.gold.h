@@ -0,0 +1,28 @@
+// Generated by tbd. Do not edit.
+#ifndef BLOCKS_H_
+#define BLOCKS_H_
+
+#include <limits>
+
+namespace blocks {
+
+// The defined values.
+struct Inputs {
+};
+
+// The computed values. Anything that can't be found is NaN.
+struct Outputs {
+  double a = std::numeric_limits<double>::quiet_NaN();  // []
+  double b = std::numeric_limits<double>::quiet_NaN();  // []
+  double c = std::numeric_limits<double>::quiet_NaN();  // []
+  double d = std::numeric_limits<double>::quiet_NaN();  // []
+  double f = std::numeric_limits<double>::quiet_NaN();  // []
+};
+
+// Compute the outputs from the inputs. Returns false if a system
+// of equations did not converge.
+bool Evaluate(const Inputs& tbd_in, Outputs* tbd_out);
+
+}  // namespace blocks
+
+#endif  // BLOCKS_H_
@@ -0,0 +1,25 @@
+// Generated by tbd. Do not edit.
+#ifndef HINT_H_
+#define HINT_H_
+
+#include <limits>
+
+namespace hint {
+
+// The defined values.
+struct Inputs {
+  double area = 4.0;  // [m^2]
+};
+
+// The computed values. Anything that can't be found is NaN.
+struct Outputs {
+  double side = std::numeric_limits<double>::quiet_NaN();
+};
+
+// Compute the outputs from the inputs. Returns false if a system
+// of equations did not converge.
+bool Evaluate(const Inputs& tbd_in, Outputs* tbd_out);
+
+}  // namespace hint
+
+#endif  // HINT_H_
@@ -0,0 +1,100 @@
+// Generated by tbd. Do not edit.
+#include "reserved_names.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace reserved_names {
+namespace {
+
+[[maybe_unused]] constexpr double e = 2.718281828459045;
+[[maybe_unused]] constexpr double g0 = 9.80665;
+[[maybe_unused]] constexpr double pi = 3.141592653589793;
+
+// Solve residual(x) = 0 by Newton's method, starting from x.
+template <int N, class F>
+bool tbd_solve(F residual, double (&x)[N]) {
+  constexpr double kTolerance = 1e-9;
+  double y[N], x_d[N], y_d[N], jac[N][N];
+  for (int cycle = 0; cycle < 50; cycle++) {
+    residual(x, y);
+    double err = 0;
+    for (int i = 0; i < N; i++) err = std::fmax(err, std::fabs(y[i]));
+    if (err < kTolerance) return true;
+
+    // Find the Jacobian by finite differences.
+    for (int j = 0; j < N; j++) {
+      for (int i = 0; i < N; i++) x_d[i] = x[i];
+      const double h = 1e-7 * std::fmax(1.0, std::fabs(x[j]));
+      x_d[j] += h;
+      residual(x_d, y_d);
+      for (int i = 0; i < N; i++) jac[i][j] = (y_d[i] - y[i]) / h;
+    }
+
+    // Solve jac * d = y by Gaussian elimination with partial pivoting.
+    for (int k = 0; k < N; k++) {
+      int p = k;
+      for (int i = k + 1; i < N; i++) {
+        if (std::fabs(jac[i][k]) > std::fabs(jac[p][k])) p = i;
+      }
+      if (!(std::fabs(jac[p][k]) > 0)) break;
+      for (int j = 0; j < N; j++) std::swap(jac[k][j], jac[p][j]);
+      std::swap(y[k], y[p]);
+      for (int i = k + 1; i < N; i++) {
+        const double f = jac[i][k] / jac[k][k];
+        for (int j = k; j < N; j++) jac[i][j] -= f * jac[k][j];
+        y[i] -= f * y[k];
+      }
+    }
+    for (int k = N - 1; k >= 0; k--) {
+      for (int j = k + 1; j < N; j++) y[k] -= jac[k][j] * y[j];
+      y[k] /= jac[k][k];
+    }
+    for (int i = 0; i < N; i++) x[i] -= y[i];
+  }
+
+  // Leave the values as computed from the final guess.
+  residual(x, y);
+  double err = 0;
+  for (int i = 0; i < N; i++) err = std::fmax(err, std::fabs(y[i]));
+  return err < kTolerance;
+}
+
+}  // namespace
+
+bool Evaluate([[maybe_unused]] const Inputs& tbd_in,
+              [[maybe_unused]] Outputs* tbd_out) {
+  bool tbd_ok = true;
+
+  [[maybe_unused]] const double Inputs_ = tbd_in.Inputs_;
+  [[maybe_unused]] const double area = tbd_in.area;
+  [[maybe_unused]] const double tbd_x_ = tbd_in.tbd_x_;
+  double Evaluate_ = std::numeric_limits<double>::quiet_NaN();
+  double Outputs_ = std::numeric_limits<double>::quiet_NaN();
+  double std_ = std::numeric_limits<double>::quiet_NaN();
+  double tbd_x__ = std::numeric_limits<double>::quiet_NaN();
+
+  // Stage 0
+  {
+    auto tbd_residual = [&](const double (&tbd_src)[1], double (&tbd_des)[1]) {
+      Evaluate_ = tbd_src[0];
+      Outputs_ = ((Evaluate_ / Inputs_) + tbd_x_);
+      tbd_des[0] = ((area - Evaluate_) - (Outputs_ * Outputs_));
+    };
+    double tbd_x[1] = {};
+    tbd_ok = tbd_solve(tbd_residual, tbd_x) && tbd_ok;
+  }
+
+  // Stage 1
+  std_ = (Outputs_ + tbd_x_);
+  tbd_x__ = (std_ * 2.0);
+
+  tbd_out->Evaluate_ = Evaluate_;
+  tbd_out->Outputs_ = Outputs_;
+  tbd_out->std_ = std_;
+  tbd_out->tbd_x__ = tbd_x__;
+  return tbd_ok;
+}
+
+}  // namespace reserved_names
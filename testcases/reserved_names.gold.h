@@ -0,0 +1,30 @@
+// Generated by tbd. Do not edit.
+#ifndef RESERVED_NAMES_H_
+#define RESERVED_NAMES_H_
+
+#include <limits>
+
+namespace reserved_names {
+
+// The defined values.
+struct Inputs {
+  double Inputs_ = 2.0;  // [m]
+  double area = 10.0;  // [m^2]
+  double tbd_x_ = 3.0;  // [m]
+};
+
+// The computed values. Anything that can't be found is NaN.
+struct Outputs {
+  double Evaluate_ = std::numeric_limits<double>::quiet_NaN();  // [m^2]
+  double Outputs_ = std::numeric_limits<double>::quiet_NaN();  // [m]
+  double std_ = std::numeric_limits<double>::quiet_NaN();  // [m]
+  double tbd_x__ = std::numeric_limits<double>::quiet_NaN();  // [m]
+};
+
+// Compute the outputs from the inputs. Returns false if a system
+// of equations did not converge.
+bool Evaluate(const Inputs& tbd_in, Outputs* tbd_out);
+
+}  // namespace reserved_names
+
+#endif  // RESERVED_NAMES_H_
@@ -0,0 +1,26 @@
+// Generated by tbd. Do not edit.
+#ifndef SIMPLE_H_
+#define SIMPLE_H_
+
+#include <limits>
+
+namespace simple {
+
+// The defined values.
+struct Inputs {
+  double a = 5.0;  // [in]
+};
+
+// The computed values. Anything that can't be found is NaN.
+struct Outputs {
+  double b = std::numeric_limits<double>::quiet_NaN();  // [m]
+  double c = std::numeric_limits<double>::quiet_NaN();  // [m]
+};
+
+// Compute the outputs from the inputs. Returns false if a system
+// of equations did not converge.
+bool Evaluate(const Inputs& tbd_in, Outputs* tbd_out);
+
+}  // namespace simple
+
+#endif  // SIMPLE_H_
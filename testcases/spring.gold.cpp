@@ -1,14 +1,125 @@
-// Simple
-large_vel = ((small_mass * small_vel) / (large_mass + small_mass));
-MD = (WD + ID);
-OD = (MD + WD);
-L_max = (L_min + stroke);
-L_solid = (WD * (N + 1));
-large_energy = (((large_mass + small_mass) * std::pow(large_vel, 2)) / 2);
-spring_index = (MD / WD);
-K = ((std::pow(WD, 4) * Gs) / ((8 * std::pow(MD, 3)) * N));
-// system
-F_max = @src[0];
-F_min = (((large_energy / stroke) * 2) - F_max);
-L_free = ((F_max / K) - (-L_min));
-@des[0] = (F_min - ((L_free + (-L_max)) * K));
+// Generated by tbd. Do not edit.
+#include "spring.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace spring {
+namespace {
+
+[[maybe_unused]] constexpr double e = 2.718281828459045;
+[[maybe_unused]] constexpr double g0 = 9.80665;
+[[maybe_unused]] constexpr double pi = 3.141592653589793;
+
+// Solve residual(x) = 0 by Newton's method, starting from x.
+template <int N, class F>
+bool tbd_solve(F residual, double (&x)[N]) {
+  constexpr double kTolerance = 1e-9;
+  double y[N], x_d[N], y_d[N], jac[N][N];
+  for (int cycle = 0; cycle < 50; cycle++) {
+    residual(x, y);
+    double err = 0;
+    for (int i = 0; i < N; i++) err = std::fmax(err, std::fabs(y[i]));
+    if (err < kTolerance) return true;
+
+    // Find the Jacobian by finite differences.
+    for (int j = 0; j < N; j++) {
+      for (int i = 0; i < N; i++) x_d[i] = x[i];
+      const double h = 1e-7 * std::fmax(1.0, std::fabs(x[j]));
+      x_d[j] += h;
+      residual(x_d, y_d);
+      for (int i = 0; i < N; i++) jac[i][j] = (y_d[i] - y[i]) / h;
+    }
+
+    // Solve jac * d = y by Gaussian elimination with partial pivoting.
+    for (int k = 0; k < N; k++) {
+      int p = k;
+      for (int i = k + 1; i < N; i++) {
+        if (std::fabs(jac[i][k]) > std::fabs(jac[p][k])) p = i;
+      }
+      if (!(std::fabs(jac[p][k]) > 0)) break;
+      for (int j = 0; j < N; j++) std::swap(jac[k][j], jac[p][j]);
+      std::swap(y[k], y[p]);
+      for (int i = k + 1; i < N; i++) {
+        const double f = jac[i][k] / jac[k][k];
+        for (int j = k; j < N; j++) jac[i][j] -= f * jac[k][j];
+        y[i] -= f * y[k];
+      }
+    }
+    for (int k = N - 1; k >= 0; k--) {
+      for (int j = k + 1; j < N; j++) y[k] -= jac[k][j] * y[j];
+      y[k] /= jac[k][k];
+    }
+    for (int i = 0; i < N; i++) x[i] -= y[i];
+  }
+
+  // Leave the values as computed from the final guess.
+  residual(x, y);
+  double err = 0;
+  for (int i = 0; i < N; i++) err = std::fmax(err, std::fabs(y[i]));
+  return err < kTolerance;
+}
+
+}  // namespace
+
+bool Evaluate([[maybe_unused]] const Inputs& tbd_in,
+              [[maybe_unused]] Outputs* tbd_out) {
+  bool tbd_ok = true;
+
+  [[maybe_unused]] const double Gs = tbd_in.Gs * 6894.757293168362;
+  [[maybe_unused]] const double ID = tbd_in.ID * 0.0254;
+  [[maybe_unused]] const double L_min = tbd_in.L_min * 0.0254;
+  [[maybe_unused]] const double N = tbd_in.N;
+  [[maybe_unused]] const double WD = tbd_in.WD * 0.0254;
+  [[maybe_unused]] const double large_mass = tbd_in.large_mass * 0.45359237;
+  [[maybe_unused]] const double small_mass = tbd_in.small_mass * 0.001;
+  [[maybe_unused]] const double small_vel = tbd_in.small_vel;
+  [[maybe_unused]] const double stroke = tbd_in.stroke * 0.0254;
+  double F_max = std::numeric_limits<double>::quiet_NaN();
+  double F_min = std::numeric_limits<double>::quiet_NaN();
+  double K = std::numeric_limits<double>::quiet_NaN();
+  double L_free = std::numeric_limits<double>::quiet_NaN();
+  double L_max = std::numeric_limits<double>::quiet_NaN();
+  double L_solid = std::numeric_limits<double>::quiet_NaN();
+  double MD = std::numeric_limits<double>::quiet_NaN();
+  double OD = std::numeric_limits<double>::quiet_NaN();
+  double large_energy = std::numeric_limits<double>::quiet_NaN();
+  double large_vel = std::numeric_limits<double>::quiet_NaN();
+  double spring_index = std::numeric_limits<double>::quiet_NaN();
+
+  // Stage 0
+  large_vel = ((small_mass * small_vel) / (large_mass + small_mass));
+  MD = (WD + ID);
+  OD = (MD + WD);
+  L_max = (L_min + stroke);
+  L_solid = (WD * (N + 1.0));
+  large_energy = (((large_mass + small_mass) * std::pow(large_vel, 2.0)) / 2.0);
+  spring_index = (MD / WD);
+  K = ((std::pow(WD, 4.0) * Gs) / ((8.0 * std::pow(MD, 3.0)) * N));
+  {
+    auto tbd_residual = [&](const double (&tbd_src)[1], double (&tbd_des)[1]) {
+      F_max = tbd_src[0];
+      F_min = (((large_energy / stroke) * 2.0) - F_max);
+      L_free = ((F_max / K) - (-L_min));
+      tbd_des[0] = (F_min - ((L_free + (-L_max)) * K));
+    };
+    double tbd_x[1] = {};
+    tbd_ok = tbd_solve(tbd_residual, tbd_x) && tbd_ok;
+  }
+
+  tbd_out->F_max = F_max / 4.4482216152605;
+  tbd_out->F_min = F_min / 4.4482216152605;
+  tbd_out->K = K;
+  tbd_out->L_free = L_free / 0.0254;
+  tbd_out->L_max = L_max;
+  tbd_out->L_solid = L_solid;
+  tbd_out->MD = MD;
+  tbd_out->OD = OD;
+  tbd_out->large_energy = large_energy;
+  tbd_out->large_vel = large_vel;
+  tbd_out->spring_index = spring_index;
+  return tbd_ok;
+}
+
+}  // namespace spring
@@ -0,0 +1,43 @@
+// Generated by tbd. Do not edit.
+#ifndef SPRING_H_
+#define SPRING_H_
+
+#include <limits>
+
+namespace spring {
+
+// The defined values.
+struct Inputs {
+  double Gs = 1.185e+07;  // [lbf/in^2]
+  double ID = 0.8;  // [in]
+  double L_min = 0.95;  // [in]
+  double N = 15.0;  // []
+  double WD = 0.05;  // [in]
+  double large_mass = 1.0;  // [lb]
+  double small_mass = 4.0;  // [g]
+  double small_vel = 900.0;  // [m/s]
+  double stroke = 6.575;  // [in]
+};
+
+// The computed values. Anything that can't be found is NaN.
+struct Outputs {
+  double F_max = std::numeric_limits<double>::quiet_NaN();  // [lbf]
+  double F_min = std::numeric_limits<double>::quiet_NaN();  // [lbf]
+  double K = std::numeric_limits<double>::quiet_NaN();  // [kg,s^-2]
+  double L_free = std::numeric_limits<double>::quiet_NaN();  // [in]
+  double L_max = std::numeric_limits<double>::quiet_NaN();  // [m]
+  double L_solid = std::numeric_limits<double>::quiet_NaN();  // [m]
+  double MD = std::numeric_limits<double>::quiet_NaN();  // [m]
+  double OD = std::numeric_limits<double>::quiet_NaN();  // [m]
+  double large_energy = std::numeric_limits<double>::quiet_NaN();  // [m^2,kg,s^-2]
+  double large_vel = std::numeric_limits<double>::quiet_NaN();  // [m,s^-1]
+  double spring_index = std::numeric_limits<double>::quiet_NaN();  // []
+};
+
+// Compute the outputs from the inputs. Returns false if a system
+// of equations did not converge.
+bool Evaluate(const Inputs& tbd_in, Outputs* tbd_out);
+
+}  // namespace spring
+
+#endif  // SPRING_H_